@@ -0,0 +1,182 @@
+# The profile-guided build, run by the pgo target:
+#
+#   cmake -DSOURCE_DIR=<source> -DBINARY_DIR=<build>/pgo -DGENERATOR=<generator> -DCXX_COMPILER_ID=<id> -P cmake/pgo.cmake
+#
+# 1. Builds space_hell_headless as it is, the baseline.
+# 2. Builds both executables instrumented, in the directory the optimized build uses, and runs the training
+#    workload in assets/pgo_training.txt and any REPLAYS. The game plays replays in its window, and quits
+#    at the end of each.
+# 3. Rebuilds both executables in that directory with the profile and link time optimization.
+# 4. Benchmarks the tick time of the baseline against the optimized build, into BINARY_DIR/pgo_bench.txt.
+
+cmake_minimum_required(VERSION 3.13)
+
+foreach (variable SOURCE_DIR BINARY_DIR GENERATOR CXX_COMPILER_ID)
+    if (NOT ${variable})
+        message(FATAL_ERROR "pgo.cmake needs ${variable}")
+    endif()
+endforeach()
+
+set(baseline_dir "${BINARY_DIR}/baseline")
+set(optimized_dir "${BINARY_DIR}/optimized")
+set(profile_dir "${BINARY_DIR}/profile")
+set(training_dir "${BINARY_DIR}/training")
+
+# The bench of a tick, the worst case of a rollback. The best of a few runs, to steady the numbers.
+set(bench_args --bench 4096 8 1000)
+set(bench_runs 5)
+
+set(configure_args -G "${GENERATOR}" -DCMAKE_BUILD_TYPE=Release -DFIXED_POINT=${FIXED_POINT})
+if (CXX_COMPILER)
+    list(APPEND configure_args -DCMAKE_CXX_COMPILER=${CXX_COMPILER})
+endif()
+if (C_COMPILER)
+    list(APPEND configure_args -DCMAKE_C_COMPILER=${C_COMPILER})
+endif()
+if (TOOLCHAIN_FILE)
+    list(APPEND configure_args -DCMAKE_TOOLCHAIN_FILE=${TOOLCHAIN_FILE})
+endif()
+
+# Runs a command, stopping at the first that fails.
+function(run)
+    execute_process(COMMAND ${ARGN} RESULT_VARIABLE result)
+    if (NOT result EQUAL 0)
+        string(REPLACE ";" " " command "${ARGN}")
+        message(FATAL_ERROR "Failed: ${command}")
+    endif()
+endfunction()
+
+# Builds a target of a build, or every target without one.
+function(build dir)
+    if (ARGN)
+        run(${CMAKE_COMMAND} --build ${dir} --config Release --target ${ARGN})
+    else()
+        run(${CMAKE_COMMAND} --build ${dir} --config Release)
+    endif()
+endfunction()
+
+# Finds an executable of a build, which multi-config generators put in a directory of the config.
+function(find_executable dir name out)
+    foreach (path ${dir}/${name} ${dir}/${name}.exe ${dir}/Release/${name} ${dir}/Release/${name}.exe)
+        if (EXISTS ${path})
+            set(${out} ${path} PARENT_SCOPE)
+            return()
+        endif()
+    endforeach()
+
+    message(FATAL_ERROR "No ${name} in ${dir}")
+endfunction()
+
+# Runs the bench a few times, returning the best tick time in ms.
+function(bench headless out)
+    set(best "")
+    foreach (i RANGE 1 ${bench_runs})
+        execute_process(COMMAND ${headless} ${bench_args} WORKING_DIRECTORY ${SOURCE_DIR} OUTPUT_VARIABLE output)
+        if (NOT output MATCHES "\\(([0-9.]+)ms per tick\\)")
+            message(FATAL_ERROR "Unexpected bench output: ${output}")
+        endif()
+
+        set(ms ${CMAKE_MATCH_1})
+        if (best STREQUAL "" OR ms LESS best)
+            set(best ${ms})
+        endif()
+    endforeach()
+
+    set(${out} ${best} PARENT_SCOPE)
+endfunction()
+
+# 1. Baseline
+
+message(STATUS "PGO: building the baseline")
+run(${CMAKE_COMMAND} -S ${SOURCE_DIR} -B ${baseline_dir} ${configure_args} -DPGO=OFF)
+build(${baseline_dir} space_hell_headless)
+find_executable(${baseline_dir} space_hell_headless baseline_headless)
+
+# 2. Instrumented, trained
+
+message(STATUS "PGO: building instrumented")
+file(REMOVE_RECURSE ${profile_dir} ${training_dir})
+file(MAKE_DIRECTORY ${profile_dir} ${training_dir})
+run(${CMAKE_COMMAND} -S ${SOURCE_DIR} -B ${optimized_dir} ${configure_args} -DPGO=GENERATE -DPGO_DIR=${profile_dir})
+build(${optimized_dir} space_hell_headless)
+build(${optimized_dir} space_hell)
+find_executable(${optimized_dir} space_hell_headless instrumented_headless)
+find_executable(${optimized_dir} space_hell instrumented_game)
+
+file(STRINGS ${SOURCE_DIR}/assets/pgo_training.txt lines)
+set(runs "")
+foreach (line ${lines})
+    string(STRIP "${line}" line)
+    if (line STREQUAL "" OR line MATCHES "^;")
+        continue()
+    endif()
+    string(REPLACE "@TRAINING_DIR@" "${training_dir}" line "${line}")
+    list(APPEND runs "${line}")
+endforeach()
+
+if (REPLAYS)
+    string(REPLACE "|" ";" replays "${REPLAYS}")
+    foreach (replay ${replays})
+        list(APPEND runs "--verify ${replay}" "game --replay ${replay}")
+    endforeach()
+endif()
+
+set(game_trained FALSE)
+foreach (line ${runs})
+    message(STATUS "PGO: training on ${line}")
+    separate_arguments(args UNIX_COMMAND "${line}")
+
+    # Lines that start with game run the game, the rest the headless tool.
+    set(executable ${instrumented_headless})
+    list(GET args 0 first)
+    if (first STREQUAL "game")
+        set(executable ${instrumented_game})
+        list(REMOVE_AT args 0)
+    endif()
+
+    execute_process(COMMAND ${executable} ${args} WORKING_DIRECTORY ${SOURCE_DIR} RESULT_VARIABLE result OUTPUT_QUIET)
+
+    # The profile is written either way. An instrumented build can miss a bench's budget, which is no reason to stop.
+    if (NOT result EQUAL 0)
+        message(STATUS "PGO: ${line} exited with ${result}")
+    elseif (executable STREQUAL instrumented_game)
+        set(game_trained TRUE)
+    endif()
+endforeach()
+
+# The game needs a window. Without one its own code goes untrained, and is optimized as if it hadn't been profiled.
+if (NOT game_trained)
+    message(WARNING "PGO: the game didn't play a replay to its end, it's built without a profile of its own code")
+endif()
+
+if (CXX_COMPILER_ID MATCHES "Clang")
+    # Clang writes a raw profile per process, merged into the one the build reads.
+    get_filename_component(compiler_dir "${CXX_COMPILER}" DIRECTORY)
+    find_program(LLVM_PROFDATA NAMES llvm-profdata HINTS ${compiler_dir})
+    if (NOT LLVM_PROFDATA)
+        message(FATAL_ERROR "Clang's profiles need llvm-profdata to merge")
+    endif()
+
+    file(GLOB raw_profiles ${profile_dir}/*.profraw)
+    run(${LLVM_PROFDATA} merge -output=${profile_dir}/space_hell.profdata ${raw_profiles})
+endif()
+
+# GCC keeps a profile per object file, each executable's objects their own, which the rebuild below reads
+# from the objects it just instrumented.
+
+# 3. Optimized
+
+message(STATUS "PGO: building with the profile")
+run(${CMAKE_COMMAND} -S ${SOURCE_DIR} -B ${optimized_dir} ${configure_args} -DPGO=USE -DPGO_DIR=${profile_dir})
+build(${optimized_dir})
+find_executable(${optimized_dir} space_hell_headless optimized_headless)
+
+# 4. Before and after
+
+bench(${baseline_headless} baseline_ms)
+bench(${optimized_headless} optimized_ms)
+
+string(REPLACE ";" " " bench_command "${bench_args}")
+set(report "space_hell_headless ${bench_command}, best of ${bench_runs}\nbaseline:  ${baseline_ms}ms per tick\noptimized: ${optimized_ms}ms per tick\n")
+file(WRITE ${BINARY_DIR}/pgo_bench.txt "${report}")
+message(STATUS "PGO: done, executables in ${optimized_dir}\n${report}")
@@ -0,0 +1,141 @@
+#include "asset_loader.h"
+
+#pragma warning(push, 0)
+#include <cassert>
+#include <cstring>
+
+#include <engine/log.h>
+#pragma warning(pop)
+
+namespace game {
+
+AssetLoader::AssetLoader()
+: jobs()
+, job_count(0) {
+}
+
+AssetLoader::~AssetLoader() {
+    asset_loader::reset(*this);
+}
+
+static void run_job(AssetJob *job) {
+    job->status.store(AssetJobStatus::Running, std::memory_order_relaxed);
+
+    bool ok = job->run(*job);
+
+    if (ok) {
+        job->progress.store(AssetJobProgressMax, std::memory_order_relaxed);
+    }
+
+    // Publishes the result to the main thread.
+    job->status.store(ok ? AssetJobStatus::Done : AssetJobStatus::Failed, std::memory_order_release);
+}
+
+namespace asset_loader {
+
+AssetJob &add(AssetLoader &loader, const char *name, const char *filename, bool (*run)(AssetJob &job), void (*release)(AssetJob &job)) {
+    if (loader.job_count >= AssetJobMax) {
+        log_fatal("Too many asset jobs, max is %u", AssetJobMax);
+    }
+
+    assert(run != nullptr);
+
+    AssetJob &job = loader.jobs[loader.job_count++];
+    job.name = name;
+    job.filename = filename;
+    job.run = run;
+    job.release = release;
+    job.status.store(AssetJobStatus::Pending, std::memory_order_relaxed);
+    job.progress.store(0, std::memory_order_relaxed);
+    job.width = 0;
+    job.height = 0;
+    job.data = nullptr;
+
+    return job;
+}
+
+void start(AssetLoader &loader) {
+    for (uint32_t i = 0; i < loader.job_count; ++i) {
+        AssetJob &job = loader.jobs[i];
+        if (job.status.load(std::memory_order_relaxed) != AssetJobStatus::Pending || job.thread.joinable()) {
+            continue;
+        }
+
+        log_debug("Loading %s from %s", job.name, job.filename);
+        job.thread = std::thread(run_job, &job);
+    }
+}
+
+bool poll(AssetLoader &loader) {
+    bool finished = true;
+
+    for (uint32_t i = 0; i < loader.job_count; ++i) {
+        AssetJob &job = loader.jobs[i];
+        AssetJobStatus status = job.status.load(std::memory_order_acquire);
+
+        if (status == AssetJobStatus::Done || status == AssetJobStatus::Failed) {
+            if (job.thread.joinable()) {
+                job.thread.join();
+            }
+        } else {
+            finished = false;
+        }
+    }
+
+    return finished;
+}
+
+const AssetJob *find(const AssetLoader &loader, const char *name) {
+    for (uint32_t i = 0; i < loader.job_count; ++i) {
+        if (strcmp(loader.jobs[i].name, name) == 0) {
+            return &loader.jobs[i];
+        }
+    }
+
+    return nullptr;
+}
+
+const AssetJob *failed(const AssetLoader &loader) {
+    for (uint32_t i = 0; i < loader.job_count; ++i) {
+        if (loader.jobs[i].status.load(std::memory_order_acquire) == AssetJobStatus::Failed) {
+            return &loader.jobs[i];
+        }
+    }
+
+    return nullptr;
+}
+
+float progress(const AssetLoader &loader) {
+    if (loader.job_count == 0) {
+        return 1.0f;
+    }
+
+    uint32_t total = 0;
+    for (uint32_t i = 0; i < loader.job_count; ++i) {
+        total += loader.jobs[i].progress.load(std::memory_order_relaxed);
+    }
+
+    return (float)total / (float)(loader.job_count * AssetJobProgressMax);
+}
+
+void reset(AssetLoader &loader) {
+    for (uint32_t i = 0; i < loader.job_count; ++i) {
+        AssetJob &job = loader.jobs[i];
+
+        if (job.thread.joinable()) {
+            job.thread.join();
+        }
+
+        if (job.release && job.data) {
+            job.release(job);
+        }
+
+        job.data = nullptr;
+    }
+
+    loader.job_count = 0;
+}
+
+} // namespace asset_loader
+
+} // namespace game
@@ -0,0 +1,103 @@
+#pragma once
+
+#include "util.h"
+
+#pragma warning(push, 0)
+#include <atomic>
+#include <stdint.h>
+#include <thread>
+#pragma warning(pop)
+
+namespace game {
+
+/// The most jobs an AssetLoader runs at once.
+constexpr uint32_t AssetJobMax = 8;
+
+/// The progress of a finished job.
+constexpr uint32_t AssetJobProgressMax = 1000;
+
+enum class AssetJobStatus : uint32_t {
+    Pending,
+    Running,
+    Done,
+    Failed,
+};
+
+/**
+ * @brief Loads one asset on a worker thread.
+ *
+ * The foundation allocators aren't thread safe, so a job may only use memory it
+ * allocates with malloc or a library like stb_image. The result is handed to the
+ * main thread, which copies it into the game's allocators and releases it.
+ */
+struct AssetJob {
+    const char *name = nullptr;
+    const char *filename = nullptr;
+
+    // Runs on the worker thread. Returns false on failure.
+    bool (*run)(AssetJob &job) = nullptr;
+
+    // Frees the result, on the main thread.
+    void (*release)(AssetJob &job) = nullptr;
+
+    std::atomic<AssetJobStatus> status = {AssetJobStatus::Pending};
+
+    // Set by the job as it goes, from 0 to AssetJobProgressMax.
+    std::atomic<uint32_t> progress = {0};
+
+    // The result, only read once status is Done.
+    int32_t width = 0;
+    int32_t height = 0;
+    uint8_t *data = nullptr;
+
+    std::thread thread;
+};
+
+/**
+ * @brief Runs a batch of AssetJobs, each on its own worker thread.
+ *
+ */
+struct AssetLoader {
+    AssetLoader();
+    ~AssetLoader();
+    DELETE_COPY_AND_MOVE(AssetLoader)
+
+    AssetJob jobs[AssetJobMax];
+    uint32_t job_count;
+};
+
+namespace asset_loader {
+
+/**
+ * @brief Adds a job to the loader. Jobs are started with start.
+ *
+ * @param loader The loader to add to.
+ * @param name The name of the job, for logging.
+ * @param filename The file the job loads.
+ * @param run The function that loads the file on the worker thread.
+ * @param release The function that frees the job's result.
+ * @return AssetJob& The job, valid until the loader is reset.
+ */
+AssetJob &add(AssetLoader &loader, const char *name, const char *filename, bool (*run)(AssetJob &job), void (*release)(AssetJob &job));
+
+/// Starts a worker thread for each pending job.
+void start(AssetLoader &loader);
+
+/// Returns true when every job is done or failed. Joins the finished workers.
+bool poll(AssetLoader &loader);
+
+/// Returns the job with a name, or nullptr.
+const AssetJob *find(const AssetLoader &loader, const char *name);
+
+/// Returns the first failed job, or nullptr.
+const AssetJob *failed(const AssetLoader &loader);
+
+/// Returns the progress of all jobs, from 0 to 1.
+float progress(const AssetLoader &loader);
+
+/// Waits for the workers, releases the results and removes all jobs.
+void reset(AssetLoader &loader);
+
+} // namespace asset_loader
+
+} // namespace game
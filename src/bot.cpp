@@ -0,0 +1,209 @@
+#include "bot.h"
+#include "motion.h"
+
+#pragma warning(push, 0)
+#include <cassert>
+#pragma warning(pop)
+
+namespace game {
+
+// The buttons a bot tries, no direction first so it stays put when nothing is better.
+static const TickInput candidates[] = {
+    0,
+    (TickInput)Button::Up,
+    (TickInput)Button::Down,
+    (TickInput)Button::Left,
+    (TickInput)Button::Right,
+    (TickInput)((uint8_t)Button::Up | (uint8_t)Button::Left),
+    (TickInput)((uint8_t)Button::Up | (uint8_t)Button::Right),
+    (TickInput)((uint8_t)Button::Down | (uint8_t)Button::Left),
+    (TickInput)((uint8_t)Button::Down | (uint8_t)Button::Right),
+};
+
+constexpr uint32_t CandidateCount = sizeof(candidates) / sizeof(candidates[0]);
+
+// How close a bullet or an enemy can come, in pixels, before the bot starts to mind.
+constexpr float BulletMargin = 6.0f;
+constexpr float EnemyMargin = 12.0f;
+
+// The cost of a bullet inside the player at a tick, against at most 1 for a bullet in the margin.
+constexpr float HitCost = 64.0f;
+
+// The cost of each pixel between the player and the food, or the middle of the playfield while there is no food.
+constexpr float FoodWeight = 0.5f;
+constexpr float CenterWeight = 0.05f;
+
+// The bullets near enough to matter, in float and moving per tick.
+struct NearBullets {
+    uint32_t count;
+    float x[BotBulletMax];
+    float y[BotBulletMax];
+    float vx[BotBulletMax];
+    float vy[BotBulletMax];
+};
+
+// Returns the squared distance from a point to a box, 0 inside it.
+static float distance_squared(float x, float y, float x0, float y0, float x1, float y1) {
+    float dx = x < x0 ? x0 - x : (x > x1 ? x - x1 : 0.0f);
+    float dy = y < y0 ? y0 - y : (y > y1 ? y - y1 : 0.0f);
+    return dx * dx + dy * dy;
+}
+
+// Collects the bullets that can reach the player within a number of ticks, oldest first.
+static void gather(NearBullets &nearby, const World &world, const Player &player, uint32_t horizon) {
+    const float dt = TickDt;
+    const float px = (float)player.pos.x;
+    const float py = (float)player.pos.y;
+
+    float reach = (float)player.max_speed * (float)horizon + BulletMargin + 8.0f;
+
+    nearby.count = 0;
+    for (uint32_t i = 0; i < world.bullets.count && nearby.count < BotBulletMax; ++i) {
+        const Bullet &bullet = bullet_pool::at(world.bullets, i);
+        const float vx = (float)bullet.vel.x * dt;
+        const float vy = (float)bullet.vel.y * dt;
+        const float dx = (float)bullet.pos.x - px;
+        const float dy = (float)bullet.pos.y - py;
+
+        // The bullet's own travel adds to the reach, its speed along any axis bounds it.
+        const float travel = ((vx < 0 ? -vx : vx) + (vy < 0 ? -vy : vy)) * (float)horizon;
+        const float limit = reach + travel;
+
+        if (dx * dx + dy * dy > limit * limit) {
+            continue;
+        }
+
+        nearby.x[nearby.count] = (float)bullet.pos.x;
+        nearby.y[nearby.count] = (float)bullet.pos.y;
+        nearby.vx[nearby.count] = vx;
+        nearby.vy[nearby.count] = vy;
+        ++nearby.count;
+    }
+}
+
+// The cost of holding some buttons for a number of ticks: the danger along the way and the distance to the goal at the end.
+static float cost(const World &world, const Player &start, const NearBullets &nearby, TickInput input, uint32_t horizon) {
+    Player player = start;
+
+    float enemy_x[EnemyMax];
+    float enemy_y[EnemyMax];
+    for (uint32_t i = 0; i < world.enemy_count; ++i) {
+        const Enemy &enemy = world.enemies[i];
+        enemy_x[i] = (float)enemy.pos.x + (float)enemy.bounds.origin.x + (float)enemy.bounds.size.x / 2;
+        enemy_y[i] = (float)enemy.pos.y + (float)enemy.bounds.origin.y + (float)enemy.bounds.size.y / 2;
+    }
+
+    const float margin_squared = BulletMargin * BulletMargin;
+
+    float danger = 0.0f;
+
+    for (uint32_t k = 1; k <= horizon; ++k) {
+        motion::move_player(player, input, world.width, world.height);
+
+        const float x0 = (float)player.pos.x + (float)player.bounds.origin.x;
+        const float y0 = (float)player.pos.y + (float)player.bounds.origin.y;
+        const float x1 = x0 + (float)player.bounds.size.x;
+        const float y1 = y0 + (float)player.bounds.size.y;
+
+        // Sooner is more certain, and harder to get out of.
+        const float weight = (float)(horizon + 1 - k);
+        const float t = (float)k;
+
+        for (uint32_t i = 0; i < nearby.count; ++i) {
+            float d2 = distance_squared(nearby.x[i] + nearby.vx[i] * t, nearby.y[i] + nearby.vy[i] * t, x0, y0, x1, y1);
+            if (d2 == 0.0f) {
+                danger += HitCost * weight;
+            } else if (d2 < margin_squared) {
+                danger += (margin_squared - d2) / margin_squared * weight;
+            }
+        }
+
+        // Enemies fire from their middle, so keep away from them.
+        for (uint32_t i = 0; i < world.enemy_count; ++i) {
+            float enemy_d2 = distance_squared(enemy_x[i], enemy_y[i], x0, y0, x1, y1);
+            if (enemy_d2 < EnemyMargin * EnemyMargin) {
+                danger += (EnemyMargin * EnemyMargin - enemy_d2) / (EnemyMargin * EnemyMargin) * weight;
+            }
+        }
+    }
+
+    const float cx = (float)player.pos.x + (float)player.bounds.origin.x + (float)player.bounds.size.x / 2;
+    const float cy = (float)player.pos.y + (float)player.bounds.origin.y + (float)player.bounds.size.y / 2;
+
+    float goal_x, goal_y, goal_weight;
+    if (world.food.spawned) {
+        goal_x = (float)world.food.pos.x + (float)world.food.bounds.origin.x + (float)world.food.bounds.size.x / 2;
+        goal_y = (float)world.food.pos.y + (float)world.food.bounds.origin.y + (float)world.food.bounds.size.y / 2;
+        goal_weight = FoodWeight;
+    } else {
+        goal_x = (float)world.width / 2;
+        goal_y = (float)world.height / 2;
+        goal_weight = CenterWeight;
+    }
+
+    // Manhattan distance, the bot steers one axis at a time as often as both.
+    float gx = goal_x - cx;
+    float gy = goal_y - cy;
+    float distance = (gx < 0 ? -gx : gx) + (gy < 0 ? -gy : gy);
+
+    return danger + distance * goal_weight;
+}
+
+namespace bot {
+
+void init(Bot &bot, uint32_t player, float skill, uint32_t seed) {
+    assert(player < PlayerMax);
+
+    bot = Bot();
+    bot.player = player;
+    bot.skill = skill < 0.0f ? 0.0f : (skill > 1.0f ? 1.0f : skill);
+    rnd_pcg_seed(&bot.random, seed);
+}
+
+TickInput think(Bot &bot, const World &world) {
+    if (bot.wait > 0) {
+        --bot.wait;
+        return bot.buttons;
+    }
+
+    const float clumsiness = 1.0f - bot.skill;
+
+    // A skilled bot decides every tick and looks 40 ticks ahead, an unskilled one every 12 and 8 ahead.
+    bot.wait = (uint32_t)(clumsiness * 11.0f);
+    const uint32_t horizon = 8 + (uint32_t)(bot.skill * 32.0f);
+
+    ++bot.decisions;
+
+    // Draw every decision, so the random numbers don't depend on the world.
+    const float roll = rnd_pcg_nextf(&bot.random);
+    const int32_t pick = rnd_pcg_range(&bot.random, 0, CandidateCount - 1);
+
+    if (roll < clumsiness * 0.25f) {
+        ++bot.mistakes;
+        bot.buttons = candidates[pick];
+        return bot.buttons;
+    }
+
+    const Player &player = world.players[bot.player];
+
+    NearBullets nearby;
+    gather(nearby, world, player, horizon);
+
+    float best_cost = cost(world, player, nearby, candidates[0], horizon);
+    TickInput best = candidates[0];
+
+    for (uint32_t i = 1; i < CandidateCount; ++i) {
+        float c = cost(world, player, nearby, candidates[i], horizon);
+        if (c < best_cost) {
+            best_cost = c;
+            best = candidates[i];
+        }
+    }
+
+    bot.buttons = best;
+    return bot.buttons;
+}
+
+} // namespace bot
+
+} // namespace game
@@ -0,0 +1,66 @@
+#pragma once
+
+#include "world.h"
+
+#pragma warning(push, 0)
+#include "rnd.h"
+
+#include <stdint.h>
+#pragma warning(pop)
+
+namespace game {
+
+/// The most bullets a bot looks at when it decides, the ones nearest in spawn order.
+constexpr uint32_t BotBulletMax = 256;
+
+/**
+ * @brief A player that plays by itself, dodging the bullets and going for the food.
+ *
+ * Every few ticks the bot tries holding each direction for a while, moving a
+ * copy of its player with the same motion the world uses and the bullets in
+ * straight lines, and holds the one that stays furthest from the bullets and
+ * ends nearest the food. Skill, from 0 to 1, sets how often it decides, how far
+ * ahead it looks and how often it picks a direction at random instead.
+ *
+ * The bot only reads the world and its own random numbers, so the same seed
+ * and skill on the same world gives the same buttons.
+ */
+struct Bot {
+    // The player the bot plays.
+    uint32_t player = 0;
+
+    float skill = 1.0f;
+    rnd_pcg_t random = {};
+
+    // The buttons the bot holds, and the ticks until it decides again.
+    TickInput buttons = 0;
+    uint32_t wait = 0;
+
+    // The decisions made, and how many of them were picked at random.
+    uint32_t decisions = 0;
+    uint32_t mistakes = 0;
+};
+
+namespace bot {
+
+/**
+ * @brief Resets a bot.
+ *
+ * @param bot The bot.
+ * @param player The index of the player it plays.
+ * @param skill How well it plays, from 0 to 1.
+ * @param seed The seed of its mistakes.
+ */
+void init(Bot &bot, uint32_t player, float skill, uint32_t seed);
+
+/**
+ * @brief Returns the buttons the bot holds this tick.
+ *
+ * @param bot The bot.
+ * @param world The world before the tick.
+ */
+TickInput think(Bot &bot, const World &world);
+
+} // namespace bot
+
+} // namespace game
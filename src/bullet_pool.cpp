@@ -0,0 +1,142 @@
+#include "bullet_pool.h"
+
+#pragma warning(push, 0)
+#include <cstring>
+
+#include <memory.h>
+#pragma warning(pop)
+
+namespace game {
+
+using namespace foundation;
+
+static uint32_t next_power_of_two(uint32_t n) {
+    assert(n <= BulletCapacityMax);
+
+    uint32_t p = 1;
+    while (p < n) {
+        p <<= 1;
+    }
+    return p;
+}
+
+BulletPool::BulletPool(Allocator &allocator)
+: allocator(allocator)
+, bullets(nullptr)
+, capacity(0)
+, max_capacity(0)
+, head(0)
+, count(0)
+, overflow(BulletOverflow::DropNewest)
+, grow_pending(false)
+, padding()
+, peak(0)
+, dropped(0)
+, recycled(0)
+, grown(0) {
+}
+
+BulletPool::~BulletPool() {
+    if (bullets) {
+        allocator.deallocate(bullets);
+    }
+}
+
+namespace bullet_pool {
+
+void init(BulletPool &pool, uint32_t capacity, uint32_t max_capacity, BulletOverflow overflow) {
+    if (pool.bullets) {
+        pool.allocator.deallocate(pool.bullets);
+    }
+
+    capacity = capacity < BulletCapacityMax ? capacity : BulletCapacityMax;
+    max_capacity = max_capacity < BulletCapacityMax ? max_capacity : BulletCapacityMax;
+
+    pool.capacity = next_power_of_two(capacity > 0 ? capacity : 1);
+    pool.max_capacity = max_capacity > pool.capacity ? next_power_of_two(max_capacity) : pool.capacity;
+    pool.bullets = (Bullet *)pool.allocator.allocate(pool.max_capacity * sizeof(Bullet), alignof(Bullet));
+    pool.overflow = overflow;
+    pool.head = 0;
+    pool.count = 0;
+    pool.grow_pending = false;
+    pool.peak = 0;
+    pool.dropped = 0;
+    pool.recycled = 0;
+    pool.grown = 0;
+}
+
+Bullet *spawn(BulletPool &pool) {
+    assert(pool.bullets != nullptr);
+
+    if (pool.count == pool.capacity) {
+        if (pool.overflow == BulletOverflow::RecycleOldest) {
+            pool.head = (pool.head + 1) & (pool.capacity - 1);
+            --pool.count;
+            ++pool.recycled;
+        } else {
+            ++pool.dropped;
+            return nullptr;
+        }
+    }
+
+    Bullet *bullet = &pool.bullets[(pool.head + pool.count) & (pool.capacity - 1)];
+    *bullet = Bullet();
+    ++pool.count;
+
+    if (pool.count > pool.peak) {
+        pool.peak = pool.count;
+    }
+
+    // Request growth at three quarters occupancy, so the pool has headroom until the next maintain.
+    if (pool.overflow == BulletOverflow::Grow && pool.capacity < pool.max_capacity && pool.count >= pool.capacity - pool.capacity / 4) {
+        pool.grow_pending = true;
+    }
+
+    return bullet;
+}
+
+void clear(BulletPool &pool) {
+    pool.head = 0;
+    pool.count = 0;
+}
+
+void maintain(BulletPool &pool) {
+    if (!pool.grow_pending) {
+        return;
+    }
+
+    pool.grow_pending = false;
+
+    // The bullets past the end of the ring wrapped to its start. Doubling the ring puts the end where they
+    // belong, right after the old end.
+    uint32_t wrapped = pool.head + pool.count > pool.capacity ? pool.head + pool.count - pool.capacity : 0;
+    memcpy(pool.bullets + pool.capacity, pool.bullets, wrapped * sizeof(Bullet));
+
+    pool.capacity *= 2;
+    ++pool.grown;
+}
+
+void copy(const BulletPool &pool, Bullet *out) {
+    // The live bullets are at most two runs, split where the ring wraps.
+    uint32_t first = pool.capacity - pool.head;
+    if (first > pool.count) {
+        first = pool.count;
+    }
+
+    memcpy(out, pool.bullets + pool.head, first * sizeof(Bullet));
+    memcpy(out + first, pool.bullets, (pool.count - first) * sizeof(Bullet));
+}
+
+void restore(BulletPool &pool, const Bullet *bullets, uint32_t count, uint32_t capacity, bool grow_pending) {
+    assert(count <= capacity && capacity <= pool.max_capacity);
+
+    pool.capacity = capacity;
+    memcpy(pool.bullets, bullets, count * sizeof(Bullet));
+    pool.head = 0;
+    pool.count = count;
+    pool.grow_pending = grow_pending;
+}
+
+} // namespace bullet_pool
+
+} // namespace game
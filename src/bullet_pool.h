@@ -0,0 +1,157 @@
+#pragma once
+
+#include "real.h"
+#include "util.h"
+
+#pragma warning(push, 0)
+#include <memory_types.h>
+#pragma warning(pop)
+
+namespace game {
+
+template <typename T>
+struct BasicBullet {
+    Vec2<T> pos = {0, 0};
+    Vec2<T> vel = {0, 0};
+};
+
+typedef BasicBullet<Real> Bullet;
+
+/// The largest capacity of a bullet pool, which the config is clamped to.
+constexpr uint32_t BulletCapacityMax = 1 << 20;
+
+/**
+ * @brief What a BulletPool does when a bullet is spawned while it is full.
+ *
+ */
+enum class BulletOverflow {
+    // Don't spawn the new bullet.
+    DropNewest,
+
+    // Replace the oldest live bullet with the new one.
+    RecycleOldest,
+
+    // Grow the pool once it passes its high water mark, up to a max capacity allocated up front.
+    Grow,
+};
+
+/**
+ * @brief A fixed capacity pool of bullets.
+ *
+ * Bullets are stored in a ring buffer in spawn order, so the oldest bullet is
+ * always at the head and spawning is O(1). Storage for the max capacity is
+ * allocated by init, so growing only uses more of it and nothing allocates
+ * after init.
+ */
+struct BulletPool {
+    BulletPool(foundation::Allocator &allocator);
+    ~BulletPool();
+    DELETE_COPY_AND_MOVE(BulletPool)
+
+    foundation::Allocator &allocator;
+    Bullet *bullets;
+    uint32_t capacity;
+    uint32_t max_capacity;
+    uint32_t head;
+    uint32_t count;
+    BulletOverflow overflow;
+    bool grow_pending;
+    char padding[3];
+
+    // Counters
+    uint32_t peak;
+    uint32_t dropped;
+    uint32_t recycled;
+    uint32_t grown;
+};
+
+namespace bullet_pool {
+
+/**
+ * @brief Allocates the pool's storage and resets its counters.
+ *
+ * @param pool The pool to initialize.
+ * @param capacity The number of bullets, rounded up to a power of two, up to BulletCapacityMax.
+ * @param max_capacity The largest capacity the pool may grow to with BulletOverflow::Grow, up to BulletCapacityMax.
+ * @param overflow The overflow policy.
+ */
+void init(BulletPool &pool, uint32_t capacity, uint32_t max_capacity, BulletOverflow overflow);
+
+/**
+ * @brief Spawns a bullet, applying the overflow policy if the pool is full.
+ *
+ * @param pool The pool to spawn in.
+ * @return Bullet* The new bullet, or nullptr if it was dropped.
+ */
+Bullet *spawn(BulletPool &pool);
+
+/**
+ * @brief Removes all bullets.
+ *
+ * @param pool The pool to clear.
+ */
+void clear(BulletPool &pool);
+
+/**
+ * @brief Performs any pending growth. Doesn't allocate, at most it moves the bullets where the ring wraps.
+ *
+ * @param pool The pool to maintain.
+ */
+void maintain(BulletPool &pool);
+
+/**
+ * @brief Copies the live bullets out of the pool, oldest first.
+ *
+ * @param pool The pool to copy from.
+ * @param out Receives pool.count bullets.
+ */
+void copy(const BulletPool &pool, Bullet *out);
+
+/**
+ * @brief Replaces the live bullets, for restoring a snapshot. The counters are left alone.
+ *
+ * @param pool The pool to restore.
+ * @param bullets The bullets, oldest first.
+ * @param count The number of bullets.
+ * @param capacity The capacity the pool had, up to its max capacity.
+ * @param grow_pending Whether the pool had requested growth.
+ */
+void restore(BulletPool &pool, const Bullet *bullets, uint32_t count, uint32_t capacity, bool grow_pending);
+
+/**
+ * @brief Returns the bullet at index, where 0 is the oldest live bullet.
+ */
+inline Bullet &at(BulletPool &pool, uint32_t index) {
+    assert(index < pool.count);
+    return pool.bullets[(pool.head + index) & (pool.capacity - 1)];
+}
+
+inline const Bullet &at(const BulletPool &pool, uint32_t index) {
+    assert(index < pool.count);
+    return pool.bullets[(pool.head + index) & (pool.capacity - 1)];
+}
+
+/**
+ * @brief Removes all bullets for which keep returns false, retaining spawn order.
+ */
+template <typename F>
+void retain(BulletPool &pool, F keep) {
+    uint32_t mask = pool.capacity - 1;
+    uint32_t kept = 0;
+
+    for (uint32_t i = 0; i < pool.count; ++i) {
+        Bullet &bullet = pool.bullets[(pool.head + i) & mask];
+        if (keep(bullet)) {
+            if (kept != i) {
+                pool.bullets[(pool.head + kept) & mask] = bullet;
+            }
+            ++kept;
+        }
+    }
+
+    pool.count = kept;
+}
+
+} // namespace bullet_pool
+
+} // namespace game
@@ -0,0 +1,226 @@
+#include "collision.h"
+#include "world.h"
+
+#pragma warning(push, 0)
+#include <cassert>
+#include <cstring>
+
+#include <memory.h>
+#pragma warning(pop)
+
+namespace game {
+
+using namespace foundation;
+
+BulletSweep::BulletSweep(Allocator &allocator)
+: allocator(allocator)
+, capacity(0)
+, columns(0)
+, count(0)
+, column(nullptr)
+, max_span(0)
+, order(nullptr)
+, column_start(nullptr)
+, hit(nullptr) {
+}
+
+BulletSweep::~BulletSweep() {
+    allocator.deallocate(column);
+    allocator.deallocate(order);
+    allocator.deallocate(column_start);
+    allocator.deallocate(hit);
+}
+
+// The column a path starting at x is bucketed in, clamped to the playfield.
+static int32_t column(const BulletSweep &sweep, Real x) {
+    if (x < Real(0)) {
+        return 0;
+    }
+    if (x >= Real(sweep.columns - 1)) {
+        return sweep.columns - 1;
+    }
+    return (int32_t)x;
+}
+
+// Finds the column each of a contiguous run of bullets' paths starts in, like column, and returns
+// the widest path rounded up to whole columns. An int, as a float max doesn't vectorize. Written to vectorize.
+static int32_t start_columns(const Bullet *bullets, uint32_t count, Real last_column, int32_t *column) {
+    const Real dt = TickDt;
+    int32_t max_span = 0;
+
+    for (uint32_t i = 0; i < count; ++i) {
+        Real x0 = bullets[i].pos.x;
+        Real x1 = x0 + bullets[i].vel.x * dt;
+
+        Real lo = x0 < x1 ? x0 : x1;
+        Real hi = x0 < x1 ? x1 : x0;
+
+        Real c = lo < Real(0) ? Real(0) : lo;
+        c = c < last_column ? c : last_column;
+        column[i] = (int32_t)c;
+
+        int32_t span = (int32_t)(hi - lo) + 1;
+        max_span = span > max_span ? span : max_span;
+    }
+
+    return max_span;
+}
+
+// The paths of a run of candidates, copied as a struct of arrays small enough to stay in cache.
+constexpr uint32_t BatchSize = 256;
+
+struct CandidateBatch {
+    uint32_t index[BatchSize];
+    Real x0[BatchSize];
+    Real y0[BatchSize];
+    Real x1[BatchSize];
+    Real y1[BatchSize];
+    uint8_t touch[BatchSize];
+};
+
+// Copies the paths of up to BatchSize candidates from sweep.order, and marks the ones that haven't hit yet in touch.
+static void gather(CandidateBatch &batch, const BulletSweep &sweep, const BulletPool &bullets, uint32_t first, uint32_t count) {
+    const Real dt = TickDt;
+    const Bullet *ring = bullets.bullets;
+    const uint32_t head = bullets.head;
+    const uint32_t mask = bullets.capacity - 1;
+    const uint32_t *order = sweep.order + first;
+    const uint8_t *hit = sweep.hit;
+
+    for (uint32_t k = 0; k < count; ++k) {
+        const uint32_t i = order[k];
+        const Bullet &bullet = ring[(head + i) & mask];
+
+        batch.index[k] = i;
+        batch.x0[k] = bullet.pos.x;
+        batch.y0[k] = bullet.pos.y;
+        batch.x1[k] = bullet.pos.x + bullet.vel.x * dt;
+        batch.y1[k] = bullet.pos.y + bullet.vel.y * dt;
+        batch.touch[k] = hit[i] ^ 1;
+    }
+}
+
+// Tests the gathered paths against a box that moves from one position to the other during the tick,
+// and clears the ones that miss it from touch. Written to vectorize.
+static void touches(CandidateBatch &batch, uint32_t count, Vector2r from, Vector2r to, Vector2r lo, Vector2r hi) {
+    // Each path relative to the box.
+    for (uint32_t k = 0; k < count; ++k) {
+        const Vector2r p0 = {batch.x0[k] - from.x, batch.y0[k] - from.y};
+        const Vector2r p1 = {batch.x1[k] - to.x, batch.y1[k] - to.y};
+        batch.touch[k] &= (uint8_t)collision::segment_hits_box(p0, p1, lo, hi);
+    }
+}
+
+namespace collision {
+
+void reserve(BulletSweep &sweep, uint32_t capacity, int32_t width) {
+    assert(width > 0);
+
+    sweep.allocator.deallocate(sweep.column);
+    sweep.allocator.deallocate(sweep.order);
+    sweep.allocator.deallocate(sweep.column_start);
+    sweep.allocator.deallocate(sweep.hit);
+
+    sweep.capacity = capacity;
+    sweep.columns = width;
+    sweep.count = 0;
+    sweep.column = (int32_t *)sweep.allocator.allocate(capacity * sizeof(int32_t), alignof(int32_t));
+    sweep.order = (uint32_t *)sweep.allocator.allocate(capacity * sizeof(uint32_t), alignof(uint32_t));
+    sweep.column_start = (uint32_t *)sweep.allocator.allocate((uint32_t)(width + 1) * sizeof(uint32_t), alignof(uint32_t));
+    sweep.hit = (uint8_t *)sweep.allocator.allocate(capacity);
+}
+
+void build(BulletSweep &sweep, const BulletPool &bullets) {
+    assert(bullets.count <= sweep.capacity);
+
+    const uint32_t count = bullets.count;
+    sweep.count = count;
+
+    // The live bullets are a ring, at most two contiguous runs.
+    {
+        const uint32_t head = bullets.head & (bullets.capacity - 1);
+        const uint32_t first_run = head + count > bullets.capacity ? bullets.capacity - head : count;
+        const Real last_column = Real(sweep.columns - 1);
+
+        int32_t span0 = start_columns(bullets.bullets + head, first_run, last_column, sweep.column);
+        int32_t span1 = start_columns(bullets.bullets, count - first_run, last_column, sweep.column + first_run);
+        sweep.max_span = Real(span0 > span1 ? span0 : span1);
+    }
+
+    memset(sweep.hit, 0, count);
+
+    // Counting sort by column, which keeps spawn order within a column.
+    uint32_t *start = sweep.column_start;
+    const int32_t *column = sweep.column;
+    memset(start, 0, (size_t)(sweep.columns + 1) * sizeof(uint32_t));
+
+    for (uint32_t i = 0; i < count; ++i) {
+        ++start[column[i] + 1];
+    }
+
+    for (int32_t c = 0; c < sweep.columns; ++c) {
+        start[c + 1] += start[c];
+    }
+
+    // Fill each column from its start, then shift the starts back.
+    uint32_t *order = sweep.order;
+    for (uint32_t i = 0; i < count; ++i) {
+        order[start[column[i]]++] = i;
+    }
+
+    for (int32_t c = sweep.columns; c > 0; --c) {
+        start[c] = start[c - 1];
+    }
+    start[0] = 0;
+}
+
+void candidates(const BulletSweep &sweep, Real min_x, Real max_x, uint32_t &first, uint32_t &last) {
+    first = sweep.column_start[column(sweep, min_x - sweep.max_span)];
+    last = sweep.column_start[column(sweep, max_x) + 1];
+}
+
+uint32_t hit_players(World &world, const Vector2r *previous) {
+    BulletSweep &sweep = world.sweep;
+
+    build(sweep, world.bullets);
+
+    CandidateBatch batch;
+    uint32_t hits = 0;
+
+    for (uint32_t p = 0; p < world.player_count; ++p) {
+        Player &player = world.players[p];
+        const Vector2r from = previous[p];
+        const Vector2r to = player.pos;
+
+        const Vector2r lo = {Real(player.bounds.origin.x), Real(player.bounds.origin.y)};
+        const Vector2r hi = {lo.x + Real(player.bounds.size.x), lo.y + Real(player.bounds.size.y)};
+
+        // The x range the player's box covers during the tick.
+        Real min_x = (from.x < to.x ? from.x : to.x) + lo.x;
+        Real max_x = (from.x < to.x ? to.x : from.x) + hi.x;
+
+        uint32_t first, last;
+        candidates(sweep, min_x, max_x, first, last);
+
+        // The batch rejects the candidates that end short of the range itself.
+        for (uint32_t o = first; o < last; o += BatchSize) {
+            const uint32_t count = last - o < BatchSize ? last - o : BatchSize;
+            gather(batch, sweep, world.bullets, o, count);
+            touches(batch, count, from, to, lo, hi);
+
+            for (uint32_t k = 0; k < count; ++k) {
+                if (batch.touch[k]) {
+                    sweep.hit[batch.index[k]] = 1;
+                    player.hits += 1;
+                    ++hits;
+                }
+            }
+        }
+    }
+
+    return hits;
+}
+
+} // namespace collision
+
+} // namespace game
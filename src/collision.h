@@ -0,0 +1,129 @@
+#pragma once
+
+#include "bullet_pool.h"
+#include "real.h"
+#include "util.h"
+
+#pragma warning(push, 0)
+#include <memory_types.h>
+#include <stdint.h>
+#pragma warning(pop)
+
+namespace game {
+
+struct World;
+
+/**
+ * @brief The paths of a tick's bullets, sorted on x for sweep and prune.
+ *
+ * Bullets are bucketed by the pixel column their path starts in, which sorts
+ * them in linear time. A box then only has to look at the columns its x range
+ * can reach, rather than at every bullet, and tests those as a batch. Sized
+ * with the bullet pool, so sweeping never allocates.
+ */
+struct BulletSweep {
+    BulletSweep(foundation::Allocator &allocator);
+    ~BulletSweep();
+    DELETE_COPY_AND_MOVE(BulletSweep)
+
+    foundation::Allocator &allocator;
+    uint32_t capacity;
+    int32_t columns;
+    uint32_t count;
+
+    // The column each bullet's path starts in, indexed from the oldest bullet.
+    int32_t *column;
+
+    // The widest path rounded up, how far left of a box a path can start and still reach it.
+    Real max_span;
+
+    // Bullet indices sorted by column, and the start of each column in it, columns + 1 of them.
+    uint32_t *order;
+    uint32_t *column_start;
+
+    // Whether each bullet has hit something this tick.
+    uint8_t *hit;
+};
+
+namespace collision {
+
+/**
+ * @brief Allocates a sweep's storage.
+ *
+ * @param sweep The sweep.
+ * @param capacity The most bullets it sorts, the bullet pool's largest capacity.
+ * @param width The width of the playfield, in columns.
+ */
+void reserve(BulletSweep &sweep, uint32_t capacity, int32_t width);
+
+/**
+ * @brief Finds the path of every bullet through the next tick, and sorts them on x.
+ *
+ * @param sweep The sweep, reserved for at least the pool's capacity.
+ * @param bullets The bullets, before they move.
+ */
+void build(BulletSweep &sweep, const BulletPool &bullets);
+
+/**
+ * @brief Returns the range of sweep.order whose paths may overlap an x range.
+ * Paths in it may still end short of it.
+ *
+ * @param sweep The built sweep.
+ * @param min_x The left of the range.
+ * @param max_x The right of the range.
+ * @param first Receives the first index into sweep.order.
+ * @param last Receives the index past the last.
+ */
+void candidates(const BulletSweep &sweep, Real min_x, Real max_x, uint32_t &first, uint32_t &last);
+
+/**
+ * @brief Tests the path of every bullet through a tick against the path of every
+ * player, so a bullet can't pass through a player however fast it is. Call after
+ * the players have moved and before the bullets do.
+ *
+ * Marks the bullets that hit in world.sweep.hit and counts them in the players'
+ * hits. A bullet that hits two players hits the first.
+ *
+ * @param world The world.
+ * @param previous The position of each player at the start of the tick.
+ * @return uint32_t The number of bullets that hit.
+ */
+uint32_t hit_players(World &world, const Vector2r *previous);
+
+template <typename T>
+T abs(T x) {
+    return x < T(0) ? -x : x;
+}
+
+/**
+ * @brief Returns whether a segment touches a box, edges included.
+ *
+ * A separating axis test, with the box's axes and the segment's normal, so it
+ * has no division and is exact for segments of any length. It doesn't branch,
+ * so a loop of it vectorizes.
+ *
+ * @param p0 The start of the segment.
+ * @param p1 The end of the segment.
+ * @param lo The top left corner of the box.
+ * @param hi The bottom right corner of the box.
+ */
+template <typename T>
+bool segment_hits_box(Vec2<T> p0, Vec2<T> p1, Vec2<T> lo, Vec2<T> hi) {
+    const T half = T(0.5f);
+
+    // The segment's half length, and its middle relative to the box's center.
+    const Vec2<T> h = {(p1.x - p0.x) * half, (p1.y - p0.y) * half};
+    const Vec2<T> e = {(hi.x - lo.x) * half, (hi.y - lo.y) * half};
+    const Vec2<T> t = {p0.x + h.x - (lo.x + e.x), p0.y + h.y - (lo.y + e.y)};
+
+    const T ahx = abs(h.x);
+    const T ahy = abs(h.y);
+
+    return (abs(t.x) <= e.x + ahx)
+         & (abs(t.y) <= e.y + ahy)
+         & (abs(t.x * h.y - t.y * h.x) <= e.x * ahy + e.y * ahx);
+}
+
+} // namespace collision
+
+} // namespace game
@@ -0,0 +1,38 @@
+#include "config.h"
+
+#pragma warning(push, 0)
+#include <cassert>
+#include <cstdlib>
+
+#include <engine/ini.h>
+#pragma warning(pop)
+
+namespace game {
+
+const char *config_string(const ini_t *config, const char *section, const char *property, const char *default_value) {
+    assert(config != nullptr);
+
+    int section_index = ini_find_section(config, section, 0);
+    if (section_index == INI_NOT_FOUND) {
+        return default_value;
+    }
+
+    int property_index = ini_find_property(config, section_index, property, 0);
+    if (property_index == INI_NOT_FOUND) {
+        return default_value;
+    }
+
+    return ini_property_value(config, section_index, property_index);
+}
+
+int32_t config_int(const ini_t *config, const char *section, const char *property, int32_t default_value) {
+    const char *value = config_string(config, section, property, nullptr);
+    return value ? (int32_t)strtol(value, nullptr, 10) : default_value;
+}
+
+float config_float(const ini_t *config, const char *section, const char *property, float default_value) {
+    const char *value = config_string(config, section, property, nullptr);
+    return value ? strtof(value, nullptr) : default_value;
+}
+
+} // namespace game
@@ -0,0 +1,44 @@
+#pragma once
+
+#pragma warning(push, 0)
+#include <stdint.h>
+#pragma warning(pop)
+
+typedef struct ini_t ini_t;
+
+namespace game {
+
+/**
+ * @brief Reads a string property from the config.
+ *
+ * @param config The config to read from.
+ * @param section The section of the property.
+ * @param property The name of the property.
+ * @param default_value The value returned if the property is missing.
+ * @return const char* The value of the property.
+ */
+const char *config_string(const ini_t *config, const char *section, const char *property, const char *default_value);
+
+/**
+ * @brief Reads an integer property from the config.
+ *
+ * @param config The config to read from.
+ * @param section The section of the property.
+ * @param property The name of the property.
+ * @param default_value The value returned if the property is missing.
+ * @return int32_t The value of the property.
+ */
+int32_t config_int(const ini_t *config, const char *section, const char *property, int32_t default_value);
+
+/**
+ * @brief Reads a float property from the config.
+ *
+ * @param config The config to read from.
+ * @param section The section of the property.
+ * @param property The name of the property.
+ * @param default_value The value returned if the property is missing.
+ * @return float The value of the property.
+ */
+float config_float(const ini_t *config, const char *section, const char *property, float default_value);
+
+} // namespace game
@@ -0,0 +1,99 @@
+#include "fixed.h"
+
+namespace game {
+
+namespace fixed {
+
+// 2 pi in Q16.16.
+constexpr int64_t TwoPiRaw = 411775;
+
+// pi / 2 and 1 in Q4.28, the precision the table is built at.
+constexpr int64_t HalfPiQ28 = 421657428;
+constexpr int64_t OneQ28 = (int64_t)1 << 28;
+
+struct SineTable {
+    int32_t values[SineTableSize + 1];
+};
+
+// Taylor series of the sine of x in [0, pi / 2], in Q4.28. The terms fit in 64 bits at that range.
+constexpr int64_t sine_q28(int64_t x) {
+    int64_t sum = x;
+    int64_t term = x;
+    for (int64_t k = 1; k < 10; ++k) {
+        term = -(term * x / OneQ28) * x / OneQ28 / ((2 * k) * (2 * k + 1));
+        sum += term;
+    }
+    return sum;
+}
+
+// A full turn of sines from a quarter, with one extra entry so interpolation doesn't wrap.
+constexpr SineTable make_sine_table() {
+    SineTable table = {};
+    constexpr int32_t quarter = SineTableSize / 4;
+
+    for (int32_t i = 0; i <= quarter; ++i) {
+        int64_t s = sine_q28(HalfPiQ28 * i / quarter);
+        int32_t value = (int32_t)((s + (1 << 11)) >> 12);
+
+        table.values[i] = value;
+        table.values[SineTableSize / 2 - i] = value;
+        table.values[SineTableSize / 2 + i] = -value;
+        table.values[(SineTableSize - i) % SineTableSize] = -value;
+    }
+
+    table.values[SineTableSize] = table.values[0];
+    return table;
+}
+
+static constexpr SineTable sine_table = make_sine_table();
+
+static_assert(sine_table.values[SineTableSize / 4] == Fixed::One, "The sine table must peak at 1");
+
+// Looks up a position in the table, in 1/65536ths of a step.
+static Fixed lookup(int64_t position) {
+    int32_t index = (int32_t)(position >> 16) & (SineTableSize - 1);
+    int32_t fraction = (int32_t)(position & 0xffff);
+
+    int32_t a = sine_table.values[index];
+    int32_t b = sine_table.values[index + 1];
+    return Fixed::from_raw(a + (int32_t)(((int64_t)(b - a) * fraction) >> 16));
+}
+
+Fixed sin(Fixed angle) {
+    return lookup((int64_t)angle.raw * ((int64_t)SineTableSize << 16) / TwoPiRaw);
+}
+
+Fixed cos(Fixed angle) {
+    return lookup((int64_t)angle.raw * ((int64_t)SineTableSize << 16) / TwoPiRaw + ((int64_t)(SineTableSize / 4) << 16));
+}
+
+Fixed sqrt(Fixed value) {
+    if (value.raw <= 0) {
+        return Fixed();
+    }
+
+    // The square root of raw * 65536 is the raw square root, found a bit at a time.
+    uint64_t n = (uint64_t)value.raw << Fixed::FractionBits;
+    uint64_t root = 0;
+    uint64_t bit = (uint64_t)1 << 62;
+
+    while (bit > n) {
+        bit >>= 2;
+    }
+
+    while (bit != 0) {
+        if (n >= root + bit) {
+            n -= root + bit;
+            root = (root >> 1) + bit;
+        } else {
+            root >>= 1;
+        }
+        bit >>= 2;
+    }
+
+    return Fixed::from_raw((int32_t)root);
+}
+
+} // namespace fixed
+
+} // namespace game
@@ -0,0 +1,121 @@
+#pragma once
+
+#pragma warning(push, 0)
+#include <cassert>
+#include <stdint.h>
+#pragma warning(pop)
+
+namespace game {
+
+/**
+ * @brief A Q16.16 fixed point number.
+ *
+ * Integer arithmetic gives the same results with every compiler, flag and CPU,
+ * unlike float where contraction, excess precision and the C library's sinf and
+ * cosf can differ between builds. Converting from a float is exact up to the
+ * rounding of the last bit, so values read from the config are safe to convert.
+ *
+ * Implicitly constructs from numbers so the simulation can be written once for
+ * float and Fixed, but only converts back explicitly.
+ */
+struct Fixed {
+    static constexpr int32_t FractionBits = 16;
+    static constexpr int32_t One = 1 << FractionBits;
+
+    int32_t raw;
+
+    constexpr Fixed()
+    : raw(0) {}
+
+    constexpr Fixed(int32_t value)
+    : raw((int32_t)((uint32_t)value << FractionBits)) {}
+
+    constexpr Fixed(float value)
+    : raw(round_raw((double)value)) {}
+
+    constexpr Fixed(double value)
+    : raw(round_raw(value)) {}
+
+    static constexpr Fixed from_raw(int32_t raw) {
+        Fixed f;
+        f.raw = raw;
+        return f;
+    }
+
+    // Rounds to the nearest raw value, half away from zero. Scaling by a power of two is exact in a double.
+    static constexpr int32_t round_raw(double value) {
+        double scaled = value * One;
+        return scaled >= 0.0 ? (int32_t)(scaled + 0.5) : -(int32_t)(-scaled + 0.5);
+    }
+
+    explicit constexpr operator float() const {
+        return (float)raw / One;
+    }
+
+    // Truncates toward zero, like a float to int cast.
+    explicit constexpr operator int32_t() const {
+        return raw / One;
+    }
+
+    friend constexpr Fixed operator+(Fixed a, Fixed b) {
+        return from_raw((int32_t)((uint32_t)a.raw + (uint32_t)b.raw));
+    }
+
+    friend constexpr Fixed operator-(Fixed a, Fixed b) {
+        return from_raw((int32_t)((uint32_t)a.raw - (uint32_t)b.raw));
+    }
+
+    friend constexpr Fixed operator-(Fixed a) {
+        return from_raw((int32_t)(0u - (uint32_t)a.raw));
+    }
+
+    friend constexpr Fixed operator*(Fixed a, Fixed b) {
+        return from_raw((int32_t)(((int64_t)a.raw * b.raw) >> FractionBits));
+    }
+
+    friend constexpr Fixed operator/(Fixed a, Fixed b) {
+        assert(b.raw != 0);
+        return from_raw((int32_t)(((int64_t)a.raw * One) / b.raw));
+    }
+
+    constexpr Fixed &operator+=(Fixed other) {
+        return *this = *this + other;
+    }
+
+    constexpr Fixed &operator-=(Fixed other) {
+        return *this = *this - other;
+    }
+
+    constexpr Fixed &operator*=(Fixed other) {
+        return *this = *this * other;
+    }
+
+    constexpr Fixed &operator/=(Fixed other) {
+        return *this = *this / other;
+    }
+
+    friend constexpr bool operator==(Fixed a, Fixed b) { return a.raw == b.raw; }
+    friend constexpr bool operator!=(Fixed a, Fixed b) { return a.raw != b.raw; }
+    friend constexpr bool operator<(Fixed a, Fixed b) { return a.raw < b.raw; }
+    friend constexpr bool operator<=(Fixed a, Fixed b) { return a.raw <= b.raw; }
+    friend constexpr bool operator>(Fixed a, Fixed b) { return a.raw > b.raw; }
+    friend constexpr bool operator>=(Fixed a, Fixed b) { return a.raw >= b.raw; }
+};
+
+namespace fixed {
+
+/// The number of steps in a full turn of the sine table.
+constexpr int32_t SineTableSize = 1024;
+
+/// Returns the sine of an angle in radians, interpolated from a table built with integer math.
+Fixed sin(Fixed angle);
+
+/// Returns the cosine of an angle in radians, interpolated from a table built with integer math.
+Fixed cos(Fixed angle);
+
+/// Returns the square root, or 0 for negative numbers.
+Fixed sqrt(Fixed value);
+
+} // namespace fixed
+
+} // namespace game
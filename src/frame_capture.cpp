@@ -0,0 +1,297 @@
+#include "frame_capture.h"
+
+#pragma warning(push, 0)
+#include <cassert>
+#include <chrono>
+#include <cstring>
+
+#include <memory.h>
+
+#include <engine/log.h>
+#pragma warning(pop)
+
+namespace game {
+
+using namespace foundation;
+
+static_assert((FrameCaptureSlots & (FrameCaptureSlots - 1)) == 0, "FrameCaptureSlots must be a power of two");
+
+// The frame rate written to Y4M headers, before dividing by every.
+constexpr uint32_t CaptureFrameRate = 60;
+
+FrameCapture::FrameCapture(Allocator &allocator)
+: allocator(allocator)
+, file(nullptr)
+, format(CaptureFormat::Raw)
+, wait_when_full(false)
+, padding()
+, width(0)
+, height(0)
+, every(1)
+, submitted(0)
+, slots()
+, repeats()
+, encoded(nullptr)
+, written(0)
+, encoded_count(0)
+, running(false)
+, encoder()
+, captured(0)
+, repeated(0)
+, dropped(0) {
+}
+
+FrameCapture::~FrameCapture() {
+    frame_capture::close(*this);
+}
+
+// Converts an RGBA frame to 4:2:0 YCbCr planes with full range BT.601 coefficients, averaging each 2x2 block for chroma.
+static void rgba_to_y4m(const uint8_t *rgba, int32_t width, int32_t height, uint8_t *out) {
+    const int32_t chroma_width = (width + 1) / 2;
+    const int32_t chroma_height = (height + 1) / 2;
+
+    uint8_t *y_plane = out;
+    uint8_t *u_plane = y_plane + width * height;
+    uint8_t *v_plane = u_plane + chroma_width * chroma_height;
+
+    for (int32_t i = 0; i < width * height; ++i) {
+        const uint8_t *p = rgba + i * 4;
+        y_plane[i] = (uint8_t)((77 * p[0] + 150 * p[1] + 29 * p[2] + 128) >> 8);
+    }
+
+    for (int32_t cy = 0; cy < chroma_height; ++cy) {
+        for (int32_t cx = 0; cx < chroma_width; ++cx) {
+            int32_t r = 0, g = 0, b = 0, n = 0;
+
+            for (int32_t y = cy * 2; y < cy * 2 + 2 && y < height; ++y) {
+                for (int32_t x = cx * 2; x < cx * 2 + 2 && x < width; ++x) {
+                    const uint8_t *p = rgba + (y * width + x) * 4;
+                    r += p[0];
+                    g += p[1];
+                    b += p[2];
+                    ++n;
+                }
+            }
+
+            r /= n;
+            g /= n;
+            b /= n;
+
+            // Offset by 128 << 8 before shifting, so the sums stay positive.
+            u_plane[cy * chroma_width + cx] = (uint8_t)((-43 * r - 85 * g + 128 * b + 32768 + 128) >> 8);
+            v_plane[cy * chroma_width + cx] = (uint8_t)((128 * r - 107 * g - 21 * b + 32768 + 128) >> 8);
+        }
+    }
+}
+
+// Writes the frame in capture.encoded, the last one encode converted.
+static void write_encoded(FrameCapture &capture) {
+    const int32_t pixel_count = capture.width * capture.height;
+
+    switch (capture.format) {
+    case CaptureFormat::Raw: {
+        fwrite(capture.encoded, 4, (size_t)pixel_count, capture.file);
+        break;
+    }
+    case CaptureFormat::Ppm: {
+        fprintf(capture.file, "P6\n%d %d\n255\n", capture.width, capture.height);
+        fwrite(capture.encoded, 3, (size_t)pixel_count, capture.file);
+        break;
+    }
+    case CaptureFormat::Y4m: {
+        const int32_t chroma_size = ((capture.width + 1) / 2) * ((capture.height + 1) / 2);
+        fputs("FRAME\n", capture.file);
+        fwrite(capture.encoded, 1, (size_t)(pixel_count + chroma_size * 2), capture.file);
+        break;
+    }
+    }
+}
+
+static void encode(FrameCapture &capture, const uint8_t *rgba) {
+    const int32_t pixel_count = capture.width * capture.height;
+
+    switch (capture.format) {
+    case CaptureFormat::Raw: {
+        memcpy(capture.encoded, rgba, (size_t)pixel_count * 4);
+        break;
+    }
+    case CaptureFormat::Ppm: {
+        for (int32_t i = 0; i < pixel_count; ++i) {
+            memcpy(capture.encoded + i * 3, rgba + i * 4, 3);
+        }
+        break;
+    }
+    case CaptureFormat::Y4m: {
+        rgba_to_y4m(rgba, capture.width, capture.height, capture.encoded);
+        break;
+    }
+    }
+
+    write_encoded(capture);
+}
+
+// The encoder thread. Encodes slots in order until the capture closes and the ring is empty.
+static void run_encoder(FrameCapture *capture) {
+    while (true) {
+        uint32_t done = capture->encoded_count.load(std::memory_order_relaxed);
+
+        if (done == capture->written.load(std::memory_order_acquire)) {
+            // Check the ring again after seeing the capture close, in case the last frames came in between.
+            if (!capture->running.load(std::memory_order_acquire)) {
+                if (done == capture->written.load(std::memory_order_acquire)) {
+                    break;
+                }
+                continue;
+            }
+
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            continue;
+        }
+
+        const uint32_t slot = done & (FrameCaptureSlots - 1);
+        if (capture->repeats[slot]) {
+            write_encoded(*capture);
+        } else {
+            encode(*capture, capture->slots[slot]);
+        }
+        capture->encoded_count.store(done + 1, std::memory_order_release);
+    }
+
+    fflush(capture->file);
+}
+
+namespace frame_capture {
+
+CaptureFormat format_for(const char *path) {
+    const char *extension = strrchr(path, '.');
+    if (extension && strcmp(extension, ".ppm") == 0) {
+        return CaptureFormat::Ppm;
+    }
+    if (extension && strcmp(extension, ".y4m") == 0) {
+        return CaptureFormat::Y4m;
+    }
+    return CaptureFormat::Raw;
+}
+
+bool open(FrameCapture &capture, const char *path, CaptureFormat format, int32_t width, int32_t height, uint32_t every, bool wait_when_full) {
+    assert(width > 0 && height > 0);
+
+    close(capture);
+
+    capture.file = fopen(path, "wb");
+    if (!capture.file) {
+        log_error("Could not create capture %s", path);
+        return false;
+    }
+
+    capture.format = format;
+    capture.wait_when_full = wait_when_full;
+    capture.width = width;
+    capture.height = height;
+    capture.every = every > 0 ? every : 1;
+    capture.submitted = 0;
+    capture.captured = 0;
+    capture.repeated = 0;
+    capture.dropped = 0;
+
+    const uint32_t frame_size = (uint32_t)(width * height * 4);
+    for (uint8_t *&slot : capture.slots) {
+        slot = (uint8_t *)capture.allocator.allocate(frame_size);
+    }
+
+    // Raw is kept as is, the largest of the encodings.
+    capture.encoded = (uint8_t *)capture.allocator.allocate((uint32_t)(width * height * 4));
+
+    if (format == CaptureFormat::Y4m) {
+        fprintf(capture.file, "YUV4MPEG2 W%d H%d F%u:%u Ip A1:1 C420jpeg\n", width, height, CaptureFrameRate, capture.every);
+    }
+
+    capture.written.store(0, std::memory_order_relaxed);
+    capture.encoded_count.store(0, std::memory_order_relaxed);
+    capture.running.store(true, std::memory_order_release);
+    capture.encoder = std::thread(run_encoder, &capture);
+
+    log_info("Capturing every %u frames to %s", capture.every, path);
+
+    return true;
+}
+
+// Takes the next slot of the ring, or returns false if the frame is skipped or dropped.
+static bool take_slot(FrameCapture &capture, uint32_t &written) {
+    if (!capture.file) {
+        return false;
+    }
+
+    if (capture.submitted++ % capture.every != 0) {
+        return false;
+    }
+
+    written = capture.written.load(std::memory_order_relaxed);
+
+    // The ring is full while the encoder is a whole ring behind.
+    while (written - capture.encoded_count.load(std::memory_order_acquire) == FrameCaptureSlots) {
+        if (!capture.wait_when_full) {
+            capture.dropped++;
+            return false;
+        }
+
+        std::this_thread::yield();
+    }
+
+    return true;
+}
+
+void submit(FrameCapture &capture, const uint8_t *rgba) {
+    uint32_t written;
+    if (!take_slot(capture, written)) {
+        return;
+    }
+
+    const uint32_t slot = written & (FrameCaptureSlots - 1);
+    memcpy(capture.slots[slot], rgba, (size_t)(capture.width * capture.height * 4));
+    capture.repeats[slot] = false;
+    capture.written.store(written + 1, std::memory_order_release);
+    capture.captured++;
+}
+
+void repeat(FrameCapture &capture) {
+    uint32_t written;
+    if (!take_slot(capture, written)) {
+        return;
+    }
+
+    // Until a frame is taken there's nothing to write again, the capture just starts a frame later.
+    if (capture.captured == 0) {
+        return;
+    }
+
+    capture.repeats[written & (FrameCaptureSlots - 1)] = true;
+    capture.written.store(written + 1, std::memory_order_release);
+    capture.repeated++;
+}
+
+void close(FrameCapture &capture) {
+    if (!capture.file) {
+        return;
+    }
+
+    capture.running.store(false, std::memory_order_release);
+    capture.encoder.join();
+
+    fclose(capture.file);
+    capture.file = nullptr;
+
+    for (uint8_t *&slot : capture.slots) {
+        capture.allocator.deallocate(slot);
+        slot = nullptr;
+    }
+
+    capture.allocator.deallocate(capture.encoded);
+    capture.encoded = nullptr;
+
+    log_info("Captured %u frames, repeated %u, dropped %u", capture.captured, capture.repeated, capture.dropped);
+}
+
+} // namespace frame_capture
+
+} // namespace game
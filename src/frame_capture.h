@@ -0,0 +1,127 @@
+#pragma once
+
+#include "util.h"
+
+#pragma warning(push, 0)
+#include <atomic>
+#include <cstdio>
+#include <memory_types.h>
+#include <stdint.h>
+#include <thread>
+#pragma warning(pop)
+
+namespace game {
+
+/// The number of frames a FrameCapture buffers for its encoder, must be a power of two.
+constexpr uint32_t FrameCaptureSlots = 8;
+
+enum class CaptureFormat : uint8_t {
+    // RGBA frames back to back.
+    Raw,
+
+    // A stream of binary PPM images, one per frame.
+    Ppm,
+
+    // A YUV4MPEG2 stream in 4:2:0, which ffmpeg and most players read as video.
+    Y4m,
+};
+
+/**
+ * @brief Captures rendered frames to a file on a background thread.
+ *
+ * The main thread copies each captured frame into a free slot of a single
+ * producer, single consumer ring, and an encoder thread converts and writes the
+ * slots in order. Neither side waits on a lock. When the encoder falls behind
+ * and the ring is full, a frame is dropped and counted, unless the capture was
+ * opened to wait instead.
+ *
+ * The foundation allocators aren't thread safe, so everything the encoder
+ * touches is allocated on the main thread when the capture opens.
+ */
+struct FrameCapture {
+    FrameCapture(foundation::Allocator &allocator);
+    ~FrameCapture();
+    DELETE_COPY_AND_MOVE(FrameCapture)
+
+    foundation::Allocator &allocator;
+    FILE *file;
+    CaptureFormat format;
+    bool wait_when_full;
+    char padding[2];
+
+    int32_t width;
+    int32_t height;
+
+    // Capture every nth submitted frame.
+    uint32_t every;
+    uint32_t submitted;
+
+    // RGBA frames, indexed by a frame's number % FrameCaptureSlots.
+    uint8_t *slots[FrameCaptureSlots];
+
+    // Whether each slot writes the frame before it again rather than its own.
+    bool repeats[FrameCaptureSlots];
+
+    // The encoder's output for one frame, kept until the next one in case that repeats it.
+    uint8_t *encoded;
+
+    // Frames written by the main thread, and frames the encoder is done with.
+    std::atomic<uint32_t> written;
+    std::atomic<uint32_t> encoded_count;
+    std::atomic<bool> running;
+
+    std::thread encoder;
+
+    // Counters
+    uint32_t captured;
+    uint32_t repeated;
+    uint32_t dropped;
+};
+
+namespace frame_capture {
+
+/// Returns the format a file name's extension asks for: .ppm, .y4m, or anything else for raw.
+CaptureFormat format_for(const char *path);
+
+/**
+ * @brief Opens the file and starts the encoder thread.
+ *
+ * @param capture The capture.
+ * @param path The file to write.
+ * @param format The format to write.
+ * @param width The width of the frames.
+ * @param height The height of the frames.
+ * @param every Capture every nth frame, 1 for every frame.
+ * @param wait_when_full Wait for the encoder instead of dropping frames, for offline capture.
+ * @return true If the file could be created.
+ */
+bool open(FrameCapture &capture, const char *path, CaptureFormat format, int32_t width, int32_t height, uint32_t every, bool wait_when_full);
+
+/**
+ * @brief Submits a rendered frame. Copies it, unless it's skipped or dropped.
+ *
+ * @param capture The capture.
+ * @param rgba The frame, width * height RGBA pixels.
+ */
+void submit(FrameCapture &capture, const uint8_t *rgba);
+
+/**
+ * @brief Counts a frame that wasn't submitted, so the capture keeps its frame
+ * rate. If the frame would have been taken, the last frame taken is written
+ * again in its place.
+ *
+ * @param capture The capture.
+ */
+void repeat(FrameCapture &capture);
+
+/// Returns whether the next frame submitted will be taken rather than skipped, so it's only drawn when it will be.
+inline bool wants(const FrameCapture &capture) {
+    return capture.file && capture.submitted % capture.every == 0;
+}
+
+/// Writes the frames still in the ring, stops the encoder and closes the file.
+void close(FrameCapture &capture);
+
+} // namespace frame_capture
+
+} // namespace game
@@ -0,0 +1,117 @@
+#include "frame_governor.h"
+#include "config.h"
+#include "input_log.h"
+
+#pragma warning(push, 0)
+#include <chrono>
+#include <thread>
+
+#include <engine/log.h>
+#pragma warning(pop)
+
+namespace game {
+
+// How much of each frame goes into the estimate, about the last 8 frames.
+constexpr float EstimateWeight = 0.125f;
+
+// Sleeping can overshoot by a scheduler tick, so stop sleeping this far from the present and yield the rest.
+constexpr uint64_t PaceSpinNs = 2000000;
+
+static const char *level_names[(int)QualityLevel::COUNT] = {"full", "no debug overlay", "thin far field", "half capture"};
+
+namespace frame_governor {
+
+void init(FrameGovernor &governor, const ini_t *config) {
+    governor = FrameGovernor();
+    governor.enabled = config_int(config, "governor", "enabled", 1) != 0;
+    governor.pace = config_int(config, "governor", "pace", 1) != 0;
+    governor.budget_ns = (uint32_t)(config_float(config, "governor", "budget_ms", 1000.0f / 60.0f) * 1000000.0f);
+    governor.shed_above = config_float(config, "governor", "shed_above", governor.shed_above);
+    governor.restore_below = config_float(config, "governor", "restore_below", governor.restore_below);
+    governor.shed_after = (uint32_t)config_int(config, "governor", "shed_after", (int32_t)governor.shed_after);
+    governor.restore_after = (uint32_t)config_int(config, "governor", "restore_after", (int32_t)governor.restore_after);
+}
+
+void begin_frame(FrameGovernor &governor) {
+    governor.frame_start = time_now_ns();
+}
+
+void record(FrameGovernor &governor, uint64_t work_ns) {
+    ++governor.frames;
+    ++governor.frames_at_level[(int)governor.level];
+
+    if (work_ns > governor.budget_ns) {
+        ++governor.frames_over_budget;
+    }
+
+    governor.estimate_ns += ((float)work_ns - governor.estimate_ns) * EstimateWeight;
+
+    if (!governor.enabled) {
+        return;
+    }
+
+    const float budget = (float)governor.budget_ns;
+    governor.frames_above = governor.estimate_ns > budget * governor.shed_above ? governor.frames_above + 1 : 0;
+    governor.frames_below = governor.estimate_ns < budget * governor.restore_below ? governor.frames_below + 1 : 0;
+
+    if (governor.frames_above >= governor.shed_after && (int)governor.level + 1 < (int)QualityLevel::COUNT) {
+        governor.level = QualityLevel((int)governor.level + 1);
+        governor.frames_above = 0;
+        ++governor.sheds;
+        log_info("Frame governor: %.2fms against %.2fms, shedding to %s", governor.estimate_ns / 1000000.0f, budget / 1000000.0f,
+                 level_names[(int)governor.level]);
+    } else if (governor.frames_below >= governor.restore_after && governor.level != QualityLevel::Full) {
+        governor.level = QualityLevel((int)governor.level - 1);
+        governor.frames_below = 0;
+        ++governor.restores;
+        log_info("Frame governor: %.2fms against %.2fms, restoring to %s", governor.estimate_ns / 1000000.0f, budget / 1000000.0f,
+                 level_names[(int)governor.level]);
+    }
+}
+
+void end_frame(FrameGovernor &governor) {
+    uint64_t now = time_now_ns();
+
+    // A frame without an update, like the first one, has no work to record.
+    if (governor.frame_start != 0) {
+        record(governor, now - governor.frame_start);
+        governor.frame_start = 0;
+    }
+
+    if (!governor.pace) {
+        return;
+    }
+
+    // Start over from now when a frame ran a whole budget late, rather than rushing to catch up.
+    if (governor.next_present == 0 || now > governor.next_present + governor.budget_ns) {
+        if (governor.next_present != 0) {
+            ++governor.late_presents;
+        }
+        governor.next_present = now + governor.budget_ns;
+        return;
+    }
+
+    if (now < governor.next_present) {
+        uint64_t start = now;
+
+        if (governor.next_present - now > PaceSpinNs) {
+            std::this_thread::sleep_for(std::chrono::nanoseconds(governor.next_present - now - PaceSpinNs));
+        }
+
+        while (time_now_ns() < governor.next_present) {
+            std::this_thread::yield();
+        }
+
+        governor.paced_ns += time_now_ns() - start;
+    }
+
+    governor.next_present += governor.budget_ns;
+}
+
+const char *level_name(QualityLevel level) {
+    return level_names[(int)level];
+}
+
+} // namespace frame_governor
+
+} // namespace game
@@ -0,0 +1,110 @@
+#pragma once
+
+#pragma warning(push, 0)
+#include <stdint.h>
+#pragma warning(pop)
+
+typedef struct ini_t ini_t;
+
+namespace game {
+
+/// How much optional work a FrameGovernor has shed. Each level also sheds what the levels before it do.
+enum class QualityLevel : uint8_t {
+    // Everything is drawn.
+    Full,
+
+    // No hitboxes and only the governor's section of the debug window, even when the Debug overlay is on.
+    NoDebugOverlay,
+
+    // Bullets far from every player are drawn every other frame.
+    ThinFarField,
+
+    // Every other frame that would be captured repeats the one before, so the capture keeps its rate.
+    HalfCapture,
+
+    COUNT,
+};
+
+/**
+ * @brief Keeps frames within their budget by shedding optional work, and paces presentation.
+ *
+ * The governor keeps a rolling estimate of the time a frame spends on the
+ * game's own work, from the start of its update to the end of its render. When
+ * the estimate stays above the budget for a while it sheds a quality level, and
+ * when it stays well under for longer it restores one. The gap between the two
+ * keeps it from flickering between levels.
+ *
+ * Pacing holds each present back until a budget after the one before, so a
+ * frame that finishes early waits rather than showing up early and making the
+ * next one look late.
+ */
+struct FrameGovernor {
+    // From the [governor] section of the config.
+    bool enabled = true;
+    bool pace = true;
+    char padding[2] = {};
+
+    // The time a frame has, in nanoseconds.
+    uint32_t budget_ns = 16666667;
+
+    // Fractions of the budget the estimate has to stay above to shed, and below to restore.
+    float shed_above = 0.9f;
+    float restore_below = 0.5f;
+
+    // The frames in a row the estimate has to stay above or below before the level changes.
+    uint32_t shed_after = 10;
+    uint32_t restore_after = 120;
+
+    QualityLevel level = QualityLevel::Full;
+
+    // The rolling estimate of a frame's work, in nanoseconds.
+    float estimate_ns = 0.0f;
+
+    // When this frame's update started, and when the next frame should be presented.
+    uint64_t frame_start = 0;
+    uint64_t next_present = 0;
+
+    // Frames in a row with the estimate above the shed mark, and below the restore mark.
+    uint32_t frames_above = 0;
+    uint32_t frames_below = 0;
+
+    // Counters
+    uint64_t frames = 0;
+    uint64_t frames_at_level[(int)QualityLevel::COUNT] = {};
+    uint32_t frames_over_budget = 0;
+    uint32_t sheds = 0;
+    uint32_t restores = 0;
+    uint32_t late_presents = 0;
+    uint64_t paced_ns = 0;
+};
+
+namespace frame_governor {
+
+/// Reads a governor's settings from the [governor] section of the config.
+void init(FrameGovernor &governor, const ini_t *config);
+
+/// Marks the start of a frame's work. Call at the start of the update.
+void begin_frame(FrameGovernor &governor);
+
+/**
+ * @brief Adds a frame's work to the estimate, and sheds or restores a level if it has stayed high or low.
+ *
+ * @param governor The governor.
+ * @param work_ns The time the frame's work took, in nanoseconds.
+ */
+void record(FrameGovernor &governor, uint64_t work_ns);
+
+/// Records the work since begin_frame, then waits until the frame is due if pacing. Call right before presenting.
+void end_frame(FrameGovernor &governor);
+
+/// Returns whether the governor has shed a level's work.
+inline bool sheds(const FrameGovernor &governor, QualityLevel level) {
+    return governor.enabled && governor.level >= level;
+}
+
+/// Returns the name of a level.
+const char *level_name(QualityLevel level);
+
+} // namespace frame_governor
+
+} // namespace game
@@ -1,10 +1,26 @@
 #include "game.h"
+#include "asset_loader.h"
+#include "frame_capture.h"
+#include "indexed_canvas.h"
+#include "input_log.h"
+#include "lockstep.h"
+#include "particles.h"
+#include "replay.h"
+#include "rollback.h"
+#include "tracking_allocator.h"
+#include "upscale.h"
 
 #pragma warning(push, 0)
+#include <array.h>
+#include <hash.h>
 #include <memory.h>
+#include <murmur_hash.h>
 #include <string_stream.h>
 #include <temp_allocator.h>
 
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
 #include <functional>
 
 #include <engine/action_binds.h>
@@ -20,25 +36,108 @@
 namespace game {
 using namespace foundation;
 
+void game_state_initializing_enter(engine::Engine &engine, Game &game);
+void game_state_initializing_update(engine::Engine &engine, Game &game, float t, float dt);
+void game_state_initializing_render(engine::Engine &engine, Game &game);
+
 void game_state_playing_enter(engine::Engine &engine, Game &game);
 void game_state_playing_leave(engine::Engine &engine, Game &game);
 void game_state_playing_on_input(engine::Engine &engine, Game &game, engine::InputCommand &input_command);
 void game_state_playing_update(engine::Engine &engine, Game &game, float t, float dt);
 void game_state_playing_render(engine::Engine &engine, Game &game);
-void game_state_playing_render_imgui(engine::Engine &engine, Game &game);
 
-Game::Game(Allocator &allocator, const char *config_path)
-: allocator(allocator)
+void game_state_paused_enter(engine::Engine &engine, Game &game);
+void game_state_paused_on_input(engine::Engine &engine, Game &game, engine::InputCommand &input_command);
+void game_state_paused_render(engine::Engine &engine, Game &game);
+
+void game_state_debug_on_input(engine::Engine &engine, Game &game, engine::InputCommand &input_command);
+void game_state_debug_update(engine::Engine &engine, Game &game, float t, float dt);
+void game_state_debug_render(engine::Engine &engine, Game &game);
+void game_state_debug_render_imgui(engine::Engine &engine, Game &game);
+
+static void no_op(engine::Engine &, Game &) {
+}
+
+static void no_update(engine::Engine &, Game &, float, float) {
+}
+
+static void no_input(engine::Engine &, Game &, engine::InputCommand &) {
+}
+
+static void game_state_none_update(engine::Engine &engine, Game &game, float, float) {
+    transition(engine, game, GameState::Initializing);
+}
+
+static void game_state_quitting_update(engine::Engine &engine, Game &game, float, float) {
+    transition(engine, game, GameState::Terminate);
+}
+
+static void game_state_terminate_enter(engine::Engine &engine, Game &) {
+    engine::terminate(engine);
+}
+
+/// The table of each game state, indexed by GameState.
+constexpr GameStateTable game_state_tables[(int)GameState::COUNT] = {
+    {GameState::None, "None", no_op, no_op, game_state_none_update, no_input, no_op, no_op},
+    {GameState::Initializing, "Initializing", game_state_initializing_enter, no_op, game_state_initializing_update, no_input, game_state_initializing_render, no_op},
+    {GameState::Playing, "Playing", game_state_playing_enter, game_state_playing_leave, game_state_playing_update, game_state_playing_on_input, game_state_playing_render, no_op},
+    {GameState::Quitting, "Quitting", no_op, no_op, game_state_quitting_update, no_input, no_op, no_op},
+    {GameState::Terminate, "Terminating", game_state_terminate_enter, no_op, no_update, no_input, no_op, no_op},
+    {GameState::Paused, "Paused", game_state_paused_enter, no_op, no_update, game_state_paused_on_input, game_state_paused_render, no_op},
+    {GameState::Debug, "Debug", no_op, no_op, game_state_debug_update, game_state_debug_on_input, game_state_debug_render, game_state_debug_render_imgui},
+};
+
+constexpr bool game_state_tables_in_order() {
+    for (int i = 0; i < (int)GameState::COUNT; ++i) {
+        if (game_state_tables[i].game_state != GameState(i)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static_assert(game_state_tables_in_order(), "game_state_tables must be indexed by GameState");
+
+Game::Game(MemoryTracker &memory, const char *config_path)
+: memory(memory)
+, allocator(memory_tracker::allocator(memory, MemoryTag::Game))
 , config(nullptr)
+, config_hash(0)
 , action_binds(nullptr)
 , canvas(nullptr)
-, show_debug(false)
-, padding()
+, indexed_canvas(nullptr)
+, asset_loader(nullptr)
+, input_log(nullptr)
+, keycode_actions()
 , game_state(GameState::None)
-, player()
-, enemy()
-, food()
-, bullets(allocator) {
+, state(&game_state_tables[(int)GameState::None])
+, state_stack()
+, state_stack_count(1)
+, world(memory_tracker::allocator(memory, MemoryTag::World))
+, hud()
+, waves()
+, governor()
+, particles(nullptr)
+, pickup_particles(0)
+, hit_particles(0)
+, burst_scores()
+, burst_hits()
+, buttons(0)
+, tick_accumulator(0.0f)
+, net()
+, lockstep(nullptr)
+, rollback(nullptr)
+, record_path(nullptr)
+, replay_path(nullptr)
+, replay_writer(nullptr)
+, replay_reader(nullptr)
+, capture_path(nullptr)
+, capture_every(1)
+, frame_capture(nullptr)
+, capture_staging(nullptr)
+, bot_skill(-1.0f)
+, bot() {
     using namespace string_stream;
     TempAllocator1024 ta;
 
@@ -51,19 +150,92 @@ Game::Game(Allocator &allocator, const char *config_path)
         }
 
         config = ini_load(string_stream::c_str(buffer), nullptr);
+        config_hash = murmur_hash_64(array::begin(buffer), array::size(buffer), 0);
 
         if (!config) {
             log_fatal("Could not parse config file %s", config_path);
         }
+
+        config_hash = waves::hash(config, config_hash);
+
+        memory_tracker::set_budgets(memory, config);
     }
 
+    // Net settings
+    {
+        const char *mode = config_string(config, "net", "mode", "local");
+        if (strcmp(mode, "host") == 0) {
+            net.mode = NetMode::Host;
+        } else if (strcmp(mode, "join") == 0) {
+            net.mode = NetMode::Join;
+        } else if (strcmp(mode, "local") != 0) {
+            log_error("Unknown net mode %s", mode);
+        }
+
+        const char *address = config_string(config, "net", "address", nullptr);
+        if (address) {
+            snprintf(net.address, sizeof(net.address), "%s", address);
+        }
+
+        net.port = (uint16_t)config_int(config, "net", "port", net.port);
+        net.input_delay = (uint32_t)config_int(config, "net", "input_delay", (int32_t)net.input_delay);
+        net.timeout = config_float(config, "net", "timeout", net.timeout);
+        net.max_rollback = (uint32_t)config_int(config, "net", "max_rollback", (int32_t)net.max_rollback);
+        net.sim_latency = config_float(config, "net", "sim_latency_ms", 0.0f) / 1000.0f;
+        net.sim_jitter = config_float(config, "net", "sim_jitter_ms", 0.0f) / 1000.0f;
+        net.sim_loss = config_float(config, "net", "sim_loss", 0.0f);
+    }
+
+    frame_governor::init(governor, config);
+
+    Allocator &canvas_allocator = memory_tracker::allocator(memory, MemoryTag::Canvas);
+    Allocator &net_allocator = memory_tracker::allocator(memory, MemoryTag::Net);
+    Allocator &replay_allocator = memory_tracker::allocator(memory, MemoryTag::Replay);
+    Allocator &capture_allocator = memory_tracker::allocator(memory, MemoryTag::Capture);
+    Allocator &effects_allocator = memory_tracker::allocator(memory, MemoryTag::Effects);
+
     action_binds = MAKE_NEW(allocator, engine::ActionBinds, allocator, config_path);
-    canvas = MAKE_NEW(allocator, engine::Canvas, allocator);
+    canvas = MAKE_NEW(canvas_allocator, engine::Canvas, canvas_allocator);
+    indexed_canvas = MAKE_NEW(canvas_allocator, IndexedCanvas, canvas_allocator);
+    asset_loader = MAKE_NEW(allocator, AssetLoader);
+    lockstep = MAKE_NEW(net_allocator, Lockstep);
+    rollback = MAKE_NEW(net_allocator, Rollback, net_allocator);
+    replay_writer = MAKE_NEW(replay_allocator, ReplayWriter);
+    replay_reader = MAKE_NEW(replay_allocator, ReplayReader, replay_allocator);
+    input_log = MAKE_NEW(allocator, InputLog);
+    frame_capture = MAKE_NEW(capture_allocator, FrameCapture, capture_allocator);
+    capture_staging = MAKE_NEW(capture_allocator, StagingBuffers, capture_allocator);
+    particles = MAKE_NEW(effects_allocator, ParticlePool, effects_allocator);
+
+    // Sized up front, so bursts never allocate.
+    particles::init(*particles, (uint32_t)config_int(config, "particles", "capacity", 65536), 1);
+    pickup_particles = (uint32_t)config_int(config, "particles", "pickup", 24);
+    hit_particles = (uint32_t)config_int(config, "particles", "hit", 32);
+
+    state_stack[0] = state;
+
+    resolve_keycode_actions(*this);
 }
 
 Game::~Game() {
+    Allocator &canvas_allocator = memory_tracker::allocator(memory, MemoryTag::Canvas);
+    Allocator &net_allocator = memory_tracker::allocator(memory, MemoryTag::Net);
+    Allocator &replay_allocator = memory_tracker::allocator(memory, MemoryTag::Replay);
+    Allocator &capture_allocator = memory_tracker::allocator(memory, MemoryTag::Capture);
+    Allocator &effects_allocator = memory_tracker::allocator(memory, MemoryTag::Effects);
+
     MAKE_DELETE(allocator, ActionBinds, action_binds);
-    MAKE_DELETE(allocator, Canvas, canvas);
+    MAKE_DELETE(canvas_allocator, Canvas, canvas);
+    MAKE_DELETE(allocator, AssetLoader, asset_loader);
+    MAKE_DELETE(net_allocator, Lockstep, lockstep);
+    MAKE_DELETE(net_allocator, Rollback, rollback);
+    MAKE_DELETE(replay_allocator, ReplayWriter, replay_writer);
+    MAKE_DELETE(replay_allocator, ReplayReader, replay_reader);
+    MAKE_DELETE(canvas_allocator, IndexedCanvas, indexed_canvas);
+    MAKE_DELETE(allocator, InputLog, input_log);
+    MAKE_DELETE(capture_allocator, FrameCapture, frame_capture);
+    MAKE_DELETE(capture_allocator, StagingBuffers, capture_staging);
+    MAKE_DELETE(effects_allocator, ParticlePool, particles);
 
     if (config) {
         ini_destroy(config);
@@ -71,30 +243,13 @@ Game::~Game() {
 }
 
 void update(engine::Engine &engine, void *game_object, float t, float dt) {
-    (void)engine;
-    (void)t;
-    (void)dt;
-
     if (!game_object) {
         return;
     }
 
     Game &game = (*(Game *)game_object);
-
-    switch (game.game_state) {
-    case GameState::None: {
-        transition(engine, game, GameState::Initializing);
-        break;
-    }
-    case GameState::Playing: {
-        game_state_playing_update(engine, game, t, dt);
-        break;
-    }
-    case GameState::Quitting: {
-        transition(engine, game, GameState::Terminate);
-        break;
-    }
-    }
+    frame_governor::begin_frame(game.governor);
+    game.state->update(engine, game, t, dt);
 }
 
 void on_input(engine::Engine &engine, void *game_object, engine::InputCommand &input_command) {
@@ -103,16 +258,7 @@ void on_input(engine::Engine &engine, void *game_object, engine::InputCommand &i
     }
 
     Game &game = (*(Game *)game_object);
-
-    switch (game.game_state) {
-    case GameState::Playing: {
-        game_state_playing_on_input(engine, game, input_command);
-        break;
-    }
-    default: {
-        break;
-    }
-    }
+    game.state->on_input(engine, game, input_command);
 }
 
 void render(engine::Engine &engine, void *game_object) {
@@ -122,15 +268,37 @@ void render(engine::Engine &engine, void *game_object) {
 
     Game &game = (*(Game *)game_object);
 
-    switch (game.game_state) {
-    case GameState::Playing: {
-        game_state_playing_render(engine, game);
-        break;
-    }
-    default: {
-        break;
+    for (uint32_t i = 0; i < game.state_stack_count; ++i) {
+        game.state_stack[i]->render(engine, game);
     }
+
+    // Present once every state has drawn, if the canvas has been created. The window scales the canvas up itself.
+    IndexedCanvas &c = *game.indexed_canvas;
+    if (c.pixels) {
+        upscale::expand(c.pixels, c.width, c.height, pico8_palette, 1, (uint32_t *)game.canvas->data, game.canvas->width);
+
+        // Measures the frame's work, and holds it back if it's early.
+        frame_governor::end_frame(game.governor);
+        engine::render_canvas(engine, *game.canvas);
+
+        // Only copies the frame, the capture's thread encodes and writes it. Frames it skips aren't scaled.
+        // Frames the governor sheds repeat the last one, so the capture still plays back at its rate.
+        FrameCapture &capture = *game.frame_capture;
+        if (!frame_governor::sheds(game.governor, QualityLevel::HalfCapture) || (game.governor.frames & 1) == 0) {
+            StagingBuffers &staging = *game.capture_staging;
+            const uint32_t *rgba = frame_capture::wants(capture) ? staging_buffers::present(staging, c.pixels, pico8_palette)
+                                                                 : staging_buffers::front(staging);
+            frame_capture::submit(capture, (const uint8_t *)rgba);
+        } else {
+            frame_capture::repeat(capture);
+        }
+
+        input_log::present(*game.input_log);
     }
+
+    // Once the game has settled, a frame shouldn't allocate.
+    bool steady = game.game_state == GameState::Playing && game.world.tick > SteadyStateTicks;
+    memory_tracker::end_frame(game.memory, steady);
 }
 
 void render_imgui(engine::Engine &engine, void *game_object) {
@@ -140,14 +308,8 @@ void render_imgui(engine::Engine &engine, void *game_object) {
 
     Game &game = (*(Game *)game_object);
 
-    switch (game.game_state) {
-    case GameState::Playing: {
-        game_state_playing_render_imgui(engine, game);
-        break;
-    }
-    default: {
-        break;
-    }
+    for (uint32_t i = 0; i < game.state_stack_count; ++i) {
+        game.state_stack[i]->render_imgui(engine, game);
     }
 }
 
@@ -157,56 +319,127 @@ void on_shutdown(engine::Engine &engine, void *game_object) {
     engine::terminate(engine);
 }
 
-void transition(engine::Engine &engine, Game &game, GameState game_state) {
-    if (game.game_state == game_state) {
-        return;
+Action input_action(const Game &game, const engine::InputCommand &input_command) {
+    if (input_command.input_type != engine::InputType::Key) {
+        return Action::NONE;
+    }
+
+    int32_t keycode = input_command.key_state.keycode;
+    if (keycode < 0 || keycode >= KeycodeCount) {
+        log_error("Keycode %d out of range", keycode);
+        return Action::NONE;
     }
 
-    // When leaving a game state
-    switch (game.game_state) {
-    case GameState::Playing: {
-        game_state_playing_leave(engine, game);
-        break;
+    return game.keycode_actions[keycode];
+}
+
+void resolve_keycode_actions(Game &game) {
+    assert(game.action_binds != nullptr);
+
+    for (int32_t keycode = 0; keycode < KeycodeCount; ++keycode) {
+        game.keycode_actions[keycode] = Action::NONE;
+
+        engine::ActionBindsBind bind = engine::bind_for_keycode((int16_t)keycode);
+        if (bind == engine::ActionBindsBind::NOT_FOUND) {
+            continue;
+        }
+
+        uint64_t bind_key = static_cast<uint64_t>(bind);
+        ActionHash action_hash = ActionHash(hash::get(game.action_binds->bind_actions, bind_key, (uint64_t)0));
+
+        for (int32_t action = 0; action < (int32_t)Action::COUNT; ++action) {
+            if (action_hashes[action] == action_hash) {
+                game.keycode_actions[keycode] = Action(action);
+                break;
+            }
+        }
     }
-    case GameState::Terminate: {
+}
+
+void transition(engine::Engine &engine, Game &game, GameState game_state) {
+    if (game.game_state == game_state || game.game_state == GameState::Terminate) {
         return;
     }
-    default:
-        break;
+
+    // Pop the overlays, then leave the base state.
+    while (game.state_stack_count > 1) {
+        pop_state(engine, game);
     }
 
+    game.state_stack[0]->leave(engine, game);
+
+    const GameStateTable &table = game_state_tables[(int)game_state];
     game.game_state = game_state;
+    game.state_stack[0] = &table;
+    game.state = &table;
+
+    log_info("%s", table.name);
+    table.enter(engine, game);
+}
 
-    // When entering a new game state
-    switch (game.game_state) {
-    case GameState::None: {
-        break;
+void push_state(engine::Engine &engine, Game &game, GameState game_state) {
+    if (game.state_stack_count >= GameStateStackMax) {
+        log_error("Could not push %s, the state stack is full", game_state_tables[(int)game_state].name);
+        return;
+    }
+
+    const GameStateTable &table = game_state_tables[(int)game_state];
+    game.state_stack[game.state_stack_count++] = &table;
+    game.state = &table;
+
+    log_debug("Push %s", table.name);
+    table.enter(engine, game);
+}
+
+void pop_state(engine::Engine &engine, Game &game) {
+    if (game.state_stack_count <= 1) {
+        log_error("Could not pop %s, it is the base state", game.state->name);
+        return;
     }
-    case GameState::Initializing: {
-        log_info("Initializing");
-        // engine::init_sprites(*engine.sprites, game->params->game_atlas_filename().c_str());
 
-        // game->room_templates->read(game->params->room_templates_filename().c_str());
-        // game->mob_templates->read(game->params->mob_templates_filename().c_str());
+    const GameStateTable &table = *game.state;
+    --game.state_stack_count;
+    game.state = game.state_stack[game.state_stack_count - 1];
 
-        transition(engine, game, GameState::Playing);
-        break;
+    log_debug("Pop %s", table.name);
+    table.leave(engine, game);
+}
+
+void remove_state(engine::Engine &engine, Game &game, GameState game_state) {
+    // The topmost entry of the state, above the base state.
+    uint32_t i = game.state_stack_count - 1;
+    while (i > 0 && game.state_stack[i]->game_state != game_state) {
+        --i;
     }
-    case GameState::Playing: {
-        log_info("Playing");
-        game_state_playing_enter(engine, game);
-        break;
+
+    if (i == 0) {
+        log_error("Could not remove %s, it is not an overlay", game_state_tables[(int)game_state].name);
+        return;
     }
-    case GameState::Quitting: {
-        log_info("Quitting");
-        break;
+
+    const GameStateTable &table = *game.state_stack[i];
+    for (; i + 1 < game.state_stack_count; ++i) {
+        game.state_stack[i] = game.state_stack[i + 1];
     }
-    case GameState::Terminate: {
-        log_info("Terminating");
-        engine::terminate(engine);
-        break;
+
+    --game.state_stack_count;
+    game.state = game.state_stack[game.state_stack_count - 1];
+
+    log_debug("Remove %s", table.name);
+    table.leave(engine, game);
+}
+
+const GameStateTable &state_below(const Game &game, GameState game_state) {
+    uint32_t i = 1;
+    while (i < game.state_stack_count && game.state_stack[i]->game_state != game_state) {
+        ++i;
     }
+
+    if (i == game.state_stack_count) {
+        log_fatal("%s is not an overlay", game_state_tables[(int)game_state].name);
     }
+
+    return *game.state_stack[i - 1];
 }
 
 } // namespace game
@@ -1,6 +1,12 @@
 #pragma once
 
+#include "bot.h"
+#include "config.h"
+#include "frame_governor.h"
+#include "input_log.h"
 #include "util.h"
+#include "world.h"
+#include "world_render.h"
 
 #pragma warning(push, 0)
 #include <collection_types.h>
@@ -15,22 +21,52 @@ struct ActionBinds;
 struct Canvas;
 }; // namespace engine
 
-typedef struct ini_t ini_t;
 
 namespace game {
 
+struct AssetLoader;
+struct FrameCapture;
+struct Game;
+struct IndexedCanvas;
+struct Lockstep;
+struct MemoryTracker;
+struct ParticlePool;
+struct ReplayReader;
+struct ReplayWriter;
+struct Rollback;
+struct StagingBuffers;
+
 /// Murmur hashed actions.
 enum class ActionHash : uint64_t {
     NONE = 0x0ULL,
-    QUIT = 0x387bbb994ac3551ULL,
-    LEFT = 0xea159ebe206206adULL,
-    UP = 0x70f16e1b53096510ULL,
-    RIGHT = 0x40202ed91356d4aaULL,
-    DOWN = 0x8703d162c3a6b13eULL,
-    ACTION = 0x599a3850c84f9970ULL,
-    DEBUG = 0x44591a12d077d46ULL,
+    QUIT = foundation::murmur_hash_64_constexpr("QUIT"),
+    LEFT = foundation::murmur_hash_64_constexpr("LEFT"),
+    UP = foundation::murmur_hash_64_constexpr("UP"),
+    RIGHT = foundation::murmur_hash_64_constexpr("RIGHT"),
+    DOWN = foundation::murmur_hash_64_constexpr("DOWN"),
+    ACTION = foundation::murmur_hash_64_constexpr("ACTION"),
+    DEBUG = foundation::murmur_hash_64_constexpr("DEBUG"),
+    PAUSE = foundation::murmur_hash_64_constexpr("PAUSE"),
 };
 
+static_assert(ActionHash::QUIT == ActionHash(0x387bbb994ac3551ULL), "ActionHash must match the murmur hash used by ActionBinds");
+
+/// The ActionHash of each Action, indexed by Action.
+constexpr ActionHash action_hashes[(int)Action::COUNT] = {
+    ActionHash::NONE,
+    ActionHash::QUIT,
+    ActionHash::LEFT,
+    ActionHash::UP,
+    ActionHash::RIGHT,
+    ActionHash::DOWN,
+    ActionHash::ACTION,
+    ActionHash::DEBUG,
+    ActionHash::PAUSE,
+};
+
+/// The number of keycodes in the keycode to action table. Keycodes outside this range have no action.
+constexpr int32_t KeycodeCount = 512;
+
 /**
  * @brief An enum that describes a specific game state.
  *
@@ -50,65 +86,153 @@ enum class GameState {
 
     // Final state that signals the engine to terminate the application.
     Terminate,
-};
 
-struct Player {
-    int32_t score = 0;
-    math::Vector2f pos = {0.0f, 0.0f};
-    math::Vector2f vel = {0.0f, 0.0f};
-    bool button_up = false;
-    bool button_down = false;
-    bool button_left = false;
-    bool button_right = false;
-    bool button_action = false;
-    char padding[3];
-    float speed_incr = 2.0f;
-    float max_speed = 0.8f;
-    float drag = 0.025f;
-    math::Rect bounds = {{0, 2}, {8, 5}};
+    // Overlay on top of Playing that freezes the game.
+    Paused,
+
+    // Overlay that shows the debug window and hitboxes.
+    Debug,
+
+    COUNT,
 };
 
-struct Enemy {
-    math::Vector2f pos = {0.0f, 0.0f};
-    float speed = 0.05f;
-    float rot = 0.0f;
-    float rot_speed = 0.4f;
-    float bullet_rate = 0.8f;
-    float bullet_cooldown = 0.0f;
-    float bullet_speed = 20.0f;
-    math::Rect bounds = {{0, 0}, {8, 8}};
+/**
+ * @brief The functions of a game state, which the game's callbacks dispatch to.
+ *
+ * Every function is set, states that don't need one use a no-op, so dispatching
+ * never branches on the state.
+ */
+struct GameStateTable {
+    GameState game_state;
+    const char *name;
+
+    // Called when the state is entered, or pushed as an overlay.
+    void (*enter)(engine::Engine &engine, Game &game);
+
+    // Called when the state is left, or popped as an overlay.
+    void (*leave)(engine::Engine &engine, Game &game);
+
+    // Only called on the top state. Overlays that don't block the states below forward with state_below.
+    void (*update)(engine::Engine &engine, Game &game, float t, float dt);
+    void (*on_input)(engine::Engine &engine, Game &game, engine::InputCommand &input_command);
+
+    // Called on every state in the stack, from the bottom, so overlays draw on top.
+    void (*render)(engine::Engine &engine, Game &game);
+    void (*render_imgui)(engine::Engine &engine, Game &game);
 };
 
-struct Food {
-    bool spawned = false;
-    float grace_timer = 0.0f;
-    float grace = 1.5f;
-    math::Vector2f pos;
-    int32_t sprite = 0;
-    math::Rect bounds = {{0, 0}, {8, 8}};
+/// The most states on the stack, the base state and its overlays.
+constexpr uint32_t GameStateStackMax = 4;
+
+/// How the Playing state runs the world.
+enum class NetMode : uint8_t {
+    // One player, no network.
+    Local,
+
+    // Two players, hosting a lockstep session.
+    Host,
+
+    // Two players, joining a host's lockstep session.
+    Join,
 };
 
-struct Bullet {
-    math::Vector2f pos = {0.0f, 0.0f};
-    math::Vector2f vel = {0.0f, 0.0f};
+/// The [net] section of the config, which main can override from the command line.
+struct NetSettings {
+    NetMode mode = NetMode::Local;
+    char address[64] = "127.0.0.1";
+    uint16_t port = 27015;
+    uint32_t input_delay = 3;
+    float timeout = 5.0f;
+
+    // The most ticks the remote input is predicted for, and rolled back when wrong. 0 waits for it.
+    uint32_t max_rollback = 8;
+
+    // Simulated latency and jitter in seconds and the fraction of packets lost, for testing.
+    float sim_latency = 0.0f;
+    float sim_jitter = 0.0f;
+    float sim_loss = 0.0f;
 };
 
 struct Game {
-    Game(foundation::Allocator &allocator, const char *config_path);
+    Game(MemoryTracker &memory, const char *config_path);
     ~Game();
     DELETE_COPY_AND_MOVE(Game)
 
+    // The allocators of every subsystem, the game's own is allocator.
+    MemoryTracker &memory;
     foundation::Allocator &allocator;
     ini_t *config;
+
+    // A hash of the config file and its wave file, recorded in replays and shared with lockstep peers.
+    uint64_t config_hash;
     engine::ActionBinds *action_binds;
     engine::Canvas *canvas;
-    bool show_debug;
-    char padding[3];
+    IndexedCanvas *indexed_canvas;
+    AssetLoader *asset_loader;
+    InputLog *input_log;
+    Action keycode_actions[KeycodeCount];
+
+    // The base state, at the bottom of the state stack.
     GameState game_state;
-    Player player;
-    Enemy enemy;
-    Food food;
-    foundation::Array<Bullet> bullets;
+
+    // The table of the top state, which gets update and input.
+    const GameStateTable *state;
+
+    // The base state's table followed by the overlays pushed on top of it.
+    const GameStateTable *state_stack[GameStateStackMax];
+    uint32_t state_stack_count;
+
+    World world;
+    Hud hud;
+
+    // The config's wave file, read by the asset loader while Initializing.
+    WaveTable waves;
+
+    // Sheds optional work when frames run long, and paces their presentation.
+    FrameGovernor governor;
+
+    // Bursts where players eat and get hit, and the particles in each.
+    ParticlePool *particles;
+    uint32_t pickup_particles;
+    uint32_t hit_particles;
+
+    // Each player's score and hits when the last bursts were spawned.
+    int32_t burst_scores[PlayerMax];
+    int32_t burst_hits[PlayerMax];
+
+    // The buttons the local player holds, sampled once per tick.
+    TickInput buttons;
+
+    // Frame time not simulated yet, in seconds.
+    float tick_accumulator;
+
+    NetSettings net;
+
+    // The session with the other player, when net.mode isn't Local.
+    Lockstep *lockstep;
+
+    // Snapshots of the world to roll back to when a predicted input was wrong.
+    Rollback *rollback;
+
+    // Replay files to record local play to, or to play back instead of local input. nullptr for none.
+    const char *record_path;
+    const char *replay_path;
+
+    ReplayWriter *replay_writer;
+    ReplayReader *replay_reader;
+
+    // A file to capture every capture_every-th rendered frame to. nullptr for none.
+    const char *capture_path;
+    uint32_t capture_every;
+
+    FrameCapture *frame_capture;
+
+    // The captured frames, expanded to the window's render scale.
+    StagingBuffers *capture_staging;
+
+    // How well the bot that plays the local player in place of the keyboard plays, negative for no bot.
+    float bot_skill;
+    Bot bot;
 };
 
 /**
@@ -155,7 +279,7 @@ void render_imgui(engine::Engine &engine, void *game_object);
 void on_shutdown(engine::Engine &engine, void *game_object);
 
 /**
- * @brief Transition a Game to another game state.
+ * @brief Transition a Game to another game state. Any overlays are popped first.
  *
  * @param engine The engine which calls this function
  * @param game The game to transition
@@ -163,4 +287,57 @@ void on_shutdown(engine::Engine &engine, void *game_object);
  */
 void transition(engine::Engine &engine, Game &game, GameState game_state);
 
+/**
+ * @brief Pushes an overlay state on top of the current state, which stays entered underneath.
+ *
+ * @param engine The engine which calls this function
+ * @param game The game to push the state on
+ * @param game_state The GameState to push.
+ */
+void push_state(engine::Engine &engine, Game &game, GameState game_state);
+
+/**
+ * @brief Pops the top overlay state, returning to the state below without entering it again.
+ *
+ * @param engine The engine which calls this function
+ * @param game The game to pop the state from
+ */
+void pop_state(engine::Engine &engine, Game &game);
+
+/**
+ * @brief Removes an overlay state wherever it is in the stack, leaving the overlays above it in place.
+ *
+ * For overlays that can close while another is on top of them, which pop_state would pop instead.
+ *
+ * @param engine The engine which calls this function
+ * @param game The game to remove the state from
+ * @param game_state The overlay to remove.
+ */
+void remove_state(engine::Engine &engine, Game &game, GameState game_state);
+
+/**
+ * @brief Returns the table of the state below an overlay, for overlays that forward update or input.
+ *
+ * @param game The game whose state stack to search.
+ * @param game_state The overlay.
+ * @return const GameStateTable& The state below the overlay.
+ */
+const GameStateTable &state_below(const Game &game, GameState game_state);
+
+/**
+ * @brief Returns the action bound to the key of an input.
+ *
+ * @param game The game whose keycode_actions to look in.
+ * @param input_command The input.
+ * @return Action The action, or Action::NONE if the input isn't a key or the key isn't bound.
+ */
+Action input_action(const Game &game, const engine::InputCommand &input_command);
+
+/**
+ * @brief Resolves the action binds into the dense keycode to action table.
+ *
+ * @param game The game whose keycode_actions to fill from its action_binds.
+ */
+void resolve_keycode_actions(Game &game);
+
 } // namespace game
@@ -0,0 +1,241 @@
+#include "game.h"
+#include "indexed_canvas.h"
+#include "input_log.h"
+#include "lockstep.h"
+#include "particles.h"
+#include "rollback.h"
+#include "tracking_allocator.h"
+
+#pragma warning(push, 0)
+#include <engine/input.h>
+
+#include <imgui.h>
+#pragma warning(pop)
+
+namespace game {
+
+void game_state_debug_on_input(engine::Engine &engine, Game &game, engine::InputCommand &input_command) {
+    if (input_action(game, input_command) == Action::DEBUG) {
+        if (input_command.key_state.trigger_state == engine::TriggerState::Pressed) {
+            remove_state(engine, game, GameState::Debug);
+        }
+        return;
+    }
+
+    state_below(game, GameState::Debug).on_input(engine, game, input_command);
+}
+
+void game_state_debug_update(engine::Engine &engine, Game &game, float t, float dt) {
+    state_below(game, GameState::Debug).update(engine, game, t, dt);
+}
+
+void game_state_debug_render(engine::Engine &engine, Game &game) {
+    (void)engine;
+
+    using namespace indexed_canvas;
+    namespace color = pico8;
+
+    if (frame_governor::sheds(game.governor, QualityLevel::NoDebugOverlay)) {
+        return;
+    }
+
+    IndexedCanvas &c = *game.indexed_canvas;
+
+    const World &world = game.world;
+
+    for (uint32_t i = 0; i < world.enemy_count; ++i) {
+        math::Rect enemy_rect = world.enemies[i].bounds;
+        enemy_rect.origin.x += (int32_t)world.enemies[i].pos.x;
+        enemy_rect.origin.y += (int32_t)world.enemies[i].pos.y;
+        rectangle(c, enemy_rect.origin.x, enemy_rect.origin.y, enemy_rect.origin.x + enemy_rect.size.x, enemy_rect.origin.y + enemy_rect.size.y, color::green);
+    }
+
+    for (uint32_t i = 0; i < world.player_count; ++i) {
+        math::Rect player_rect = world.players[i].bounds;
+        player_rect.origin.x += (int32_t)world.players[i].pos.x;
+        player_rect.origin.y += (int32_t)world.players[i].pos.y;
+        rectangle(c, player_rect.origin.x, player_rect.origin.y, player_rect.origin.x + player_rect.size.x, player_rect.origin.y + player_rect.size.y, color::green);
+    }
+
+    if (world.food.spawned) {
+        math::Rect food_rect = world.food.bounds;
+        food_rect.origin.x += (int32_t)world.food.pos.x;
+        food_rect.origin.y += (int32_t)world.food.pos.y;
+        rectangle(c, food_rect.origin.x, food_rect.origin.y, food_rect.origin.x + food_rect.size.x, food_rect.origin.y + food_rect.size.y, color::green);
+    }
+}
+
+void game_state_debug_render_imgui(engine::Engine &engine, Game &game) {
+    bool open = true;
+
+    ImGui::SetNextWindowSize(ImVec2(240, 720), ImGuiCond_Once);
+    ImGui::SetNextWindowPos(ImVec2(8, 8), ImGuiCond_Once);
+    if (!ImGui::Begin("Debug", &open)) {
+        ImGui::End();
+
+        if (!open) {
+            remove_state(engine, game, GameState::Debug);
+        }
+        return;
+    }
+
+    // Always shown, so a machine running degraded can tell.
+    const FrameGovernor &governor = game.governor;
+    ImGui::Text("Frame governor: %s", frame_governor::level_name(governor.level));
+    ImGui::Text("Estimate: %.2fms of %.2fms", governor.estimate_ns / 1000000.0, governor.budget_ns / 1000000.0);
+    ImGui::Text("Over budget: %u of %llu frames", governor.frames_over_budget, (unsigned long long)governor.frames);
+    ImGui::Text("Sheds: %u, restores: %u", governor.sheds, governor.restores);
+    ImGui::Text("Degraded: %llu frames", (unsigned long long)(governor.frames - governor.frames_at_level[(int)QualityLevel::Full]));
+    if (governor.pace) {
+        ImGui::Text("Paced: %.1fms/frame, late: %u", governor.frames ? governor.paced_ns / (double)governor.frames / 1000000.0 : 0.0, governor.late_presents);
+    }
+
+    if (frame_governor::sheds(governor, QualityLevel::NoDebugOverlay)) {
+        ImGui::End();
+
+        if (!open) {
+            remove_state(engine, game, GameState::Debug);
+        }
+        return;
+    }
+
+    ImGui::Text("");
+
+    World &world = game.world;
+
+    ImGui::Text("Tick: %u", world.tick);
+
+    ImGui::Text("");
+
+    for (uint32_t i = 0; i < world.player_count; ++i) {
+        const Player &player = world.players[i];
+        ImGui::Text("Player %u", i + 1);
+        ImGui::Text("Position: %.1f, %.1f", (float)player.pos.x, (float)player.pos.y);
+        ImGui::Text("Velocity: %.1f, %.1f", (float)player.vel.x, (float)player.vel.y);
+        ImGui::Text("Score: %d", player.score);
+        ImGui::Text("Hits: %d", player.hits);
+        if (game.bot_skill >= 0.0f && game.bot.player == i) {
+            ImGui::Text("Bot: skill %.2f, mistakes %u of %u", (float)game.bot.skill, game.bot.mistakes, game.bot.decisions);
+        }
+        Real vel_mag = real::sqrt(player.vel.x * player.vel.x + player.vel.y * player.vel.y);
+        ImGui::Text("VelMag: %.2f", (float)vel_mag);
+
+        ImGui::Text("");
+    }
+
+    ImGui::Text("Enemies: %u / %u", world.enemy_count, EnemyMax);
+    for (uint32_t i = 0; i < world.enemy_count; ++i) {
+        const Enemy &enemy = world.enemies[i];
+        ImGui::Text("%s %s: %.1f, %.1f", waves::curve_name(enemy.curve), waves::pattern_name(enemy.pattern), (float)enemy.pos.x, (float)enemy.pos.y);
+    }
+    if (world.spawns.count > 0) {
+        ImGui::Text("Next spawn: tick %u, %u queued", world.spawns.items[0].tick, world.spawns.count);
+    }
+
+    ImGui::Text("Bullets: %u / %u", world.bullets.count, world.bullets.capacity);
+    ImGui::SameLine();
+    if (ImGui::Button("Clear")) {
+        bullet_pool::clear(world.bullets);
+    }
+    ImGui::Text("Peak: %u", world.bullets.peak);
+    ImGui::Text("Dropped: %u", world.bullets.dropped);
+    ImGui::Text("Recycled: %u", world.bullets.recycled);
+    ImGui::Text("Grown: %u", world.bullets.grown);
+
+    ImGui::Text("");
+
+    const ParticlePool &particles = *game.particles;
+    ImGui::Text("Particles: %u / %u", particles.count, particles.capacity);
+    ImGui::Text("Peak: %u, dropped: %u", particles.peak, particles.dropped);
+
+    ImGui::Text("");
+
+    ImGui::Text("Food");
+    ImGui::Text("Spawned: ");
+    ImGui::SameLine();
+    ImGui::Text(world.food.spawned ? "true" : "false");
+    ImGui::Text("Position: (%.1f, %.1f)", (float)world.food.pos.x, (float)world.food.pos.y);
+    ImGui::Text("Cooldown: %.1fs", (float)(world.food.grace - world.food.grace_timer));
+
+    if (game.net.mode != NetMode::Local) {
+        const Lockstep &lockstep = *game.lockstep;
+
+        ImGui::Text("");
+
+        ImGui::Text("Lockstep");
+        ImGui::Text("Player: %u, delay: %u", lockstep.local_player + 1, lockstep.input_delay);
+        ImGui::Text("Peer tick: %u", lockstep.peer_tick);
+        ImGui::Text("Advantage: %d / %d", (int32_t)(lockstep.tick - lockstep.peer_tick), lockstep.peer_advantage);
+        ImGui::Text("Stalls: %u", lockstep.stalls);
+        ImGui::Text("Sent: %u, %.1f B/tick", lockstep.packets_sent, world.tick ? (double)lockstep.bytes_sent / world.tick : 0.0);
+        ImGui::Text("Received: %u", lockstep.packets_received);
+
+        if (lockstep.max_prediction > 0) {
+            const Rollback &rollback = *game.rollback;
+            int32_t predicting = (int32_t)(lockstep.tick - lockstep.known[1 - lockstep.local_player]);
+
+            ImGui::Text("");
+
+            ImGui::Text("Rollback");
+            ImGui::Text("Predicting: %d / %u", predicting > 0 ? predicting : 0, lockstep.max_prediction);
+            ImGui::Text("Mispredictions: %u", lockstep.mispredictions);
+            ImGui::Text("Rollbacks: %u, deepest: %u", rollback.rollbacks, rollback.deepest);
+            ImGui::Text("Resimulated: %u ticks", rollback.resimulated);
+            ImGui::Text("Last: %.3fms, worst: %.3fms", rollback.last_rollback_ns / 1000000.0, rollback.worst_rollback_ns / 1000000.0);
+        }
+    }
+
+    ImGui::Text("");
+
+    const MemoryTracker &memory = game.memory;
+    ImGui::Text("Memory");
+    for (const TrackingAllocator &a : memory.allocators) {
+        ImGui::Text("%s: %.1f KB, peak %.1f KB", a.name, a.bytes / 1024.0, a.peak / 1024.0);
+        if (a.budget > 0) {
+            ImGui::SameLine();
+            ImGui::Text("/ %.0f KB%s", a.budget / 1024.0, a.over_budget ? ", over" : "");
+        }
+        ImGui::Text("  allocations: %u, live: %u", a.allocations, a.allocations - a.deallocations);
+    }
+    ImGui::Text("Steady frames allocating: %u", memory.steady_frames_allocating);
+
+    float allocations[MemoryHistorySize];
+    for (uint32_t i = 0; i < MemoryHistorySize; ++i) {
+        allocations[i] = (float)memory.history[(memory.frame + i) % MemoryHistorySize];
+    }
+    ImGui::PlotHistogram("##allocations", allocations, (int)MemoryHistorySize, 0, "allocations per frame", 0.0f, 3.4e38f, ImVec2(0, 32));
+
+    ImGui::Text("");
+
+    InputLog &input_log = *game.input_log;
+    ImGui::Text("Input latency");
+    ImGui::Text("Frame: %llu", (unsigned long long)input_log.frame);
+    ImGui::Text("Samples: %u", input_log.samples);
+    if (input_log.samples > 0) {
+        ImGui::Text("Min: %.2fms", input_log.min_latency / 1000000.0);
+        ImGui::Text("Mean: %.2fms", input_log.total_latency / (double)input_log.samples / 1000000.0);
+        ImGui::Text("Max: %.2fms", input_log.max_latency / 1000000.0);
+    }
+
+    float histogram[LatencyHistogramBuckets];
+    for (uint32_t i = 0; i < LatencyHistogramBuckets; ++i) {
+        histogram[i] = (float)input_log.histogram[i];
+    }
+    ImGui::PlotHistogram("##latency", histogram, (int)LatencyHistogramBuckets, 0, "0-32ms", 0.0f, 3.4e38f, ImVec2(0, 48));
+
+    if (ImGui::Button("Export")) {
+        input_log::export_csv(input_log, "input_latency.csv");
+    }
+    ImGui::SameLine();
+    if (ImGui::Button("Reset")) {
+        input_log::reset_histogram(input_log);
+    }
+
+    ImGui::End();
+
+    if (!open) {
+        remove_state(engine, game, GameState::Debug);
+    }
+}
+
+} // namespace game
@@ -0,0 +1,209 @@
+#include "asset_loader.h"
+#include "frame_capture.h"
+#include "game.h"
+#include "indexed_canvas.h"
+#include "upscale.h"
+
+#pragma warning(push, 0)
+#include <cassert>
+#include <cstdio>
+#include <cstdlib>
+
+#include <engine/canvas.h>
+#include <engine/log.h>
+
+#include <stb_image.h>
+#pragma warning(pop)
+
+namespace game {
+
+// The progress of a sprites job when the file is read, and when it is decoded.
+constexpr uint32_t SpritesReadProgress = 400;
+constexpr uint32_t SpritesDecodeProgress = 700;
+
+// Reads the sprite atlas, decodes it and converts it to palette indices in place. Runs on a worker thread.
+static bool load_sprites(AssetJob &job) {
+    FILE *file = fopen(job.filename, "rb");
+    if (!file) {
+        return false;
+    }
+
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+
+    if (size <= 0) {
+        fclose(file);
+        return false;
+    }
+
+    uint8_t *buffer = (uint8_t *)malloc((size_t)size);
+    if (!buffer) {
+        fclose(file);
+        return false;
+    }
+
+    // Read in chunks to report progress.
+    const long chunk_size = 64 * 1024;
+    long bytes_read = 0;
+    while (bytes_read < size) {
+        long chunk = size - bytes_read < chunk_size ? size - bytes_read : chunk_size;
+        if (fread(buffer + bytes_read, 1, (size_t)chunk, file) != (size_t)chunk) {
+            break;
+        }
+
+        bytes_read += chunk;
+        job.progress.store((uint32_t)((uint64_t)bytes_read * SpritesReadProgress / (uint64_t)size), std::memory_order_relaxed);
+    }
+
+    fclose(file);
+
+    if (bytes_read != size) {
+        free(buffer);
+        return false;
+    }
+
+    int w = 0, h = 0, channels = 0;
+    uint8_t *image = stbi_load_from_memory(buffer, (int)size, &w, &h, &channels, 4);
+    free(buffer);
+
+    if (!image) {
+        return false;
+    }
+
+    job.progress.store(SpritesDecodeProgress, std::memory_order_relaxed);
+
+    // Palettize a row at a time, so progress moves while large atlases convert.
+    for (int32_t row = 0; row < h; ++row) {
+        indexed_canvas::palettize(image + row * w * 4, image + row * w, w);
+        job.progress.store(SpritesDecodeProgress + (uint32_t)(row + 1) * (AssetJobProgressMax - SpritesDecodeProgress) / (uint32_t)h, std::memory_order_relaxed);
+    }
+
+    job.width = w;
+    job.height = h;
+    job.data = image;
+
+    return true;
+}
+
+static void release_image(AssetJob &job) {
+    stbi_image_free(job.data);
+}
+
+// Reads the wave file and parses it into a WaveTable. Runs on a worker thread. A file that can't be read leaves
+// the original game's wave, as world::init does.
+static bool load_waves(AssetJob &job) {
+    WaveTable *table = (WaveTable *)calloc(1, sizeof(WaveTable));
+    if (!table) {
+        return false;
+    }
+
+    waves::defaults(*table);
+    job.data = (uint8_t *)table;
+
+    FILE *file = fopen(job.filename, "rb");
+    if (!file) {
+        log_error("Could not open wave file %s", job.filename);
+        return true;
+    }
+
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+
+    char *text = (char *)malloc(size > 0 ? (size_t)size + 1 : 1);
+    size_t read = text && size > 0 ? fread(text, 1, (size_t)size, file) : 0;
+    fclose(file);
+
+    if (text) {
+        text[read] = '\0';
+        waves::parse(*table, text, job.filename);
+        free(text);
+    }
+
+    return true;
+}
+
+static void release_waves(AssetJob &job) {
+    free(job.data);
+}
+
+void game_state_initializing_enter(engine::Engine &engine, Game &game) {
+    // The engine's canvas reads [canvas] itself, sprites_filename included. The game draws from the IndexedCanvas,
+    // whose atlas the loader decodes on a worker below.
+    engine::init_canvas(engine, *game.canvas, game.config);
+
+    indexed_canvas::init(*game.indexed_canvas, game.config, game.canvas->width, game.canvas->height);
+
+    // Capture while playing drops frames rather than slowing the game down. It records at the window's size.
+    if (game.capture_path) {
+        const int32_t scale = upscale::render_scale(game.config);
+        staging_buffers::init(*game.capture_staging, game.canvas->width, game.canvas->height, scale);
+
+        CaptureFormat format = frame_capture::format_for(game.capture_path);
+        frame_capture::open(*game.frame_capture, game.capture_path, format, game.canvas->width * scale, game.canvas->height * scale,
+                            game.capture_every, false);
+    }
+
+    const char *sprites_filename = config_string(game.config, "canvas", "sprites_filename", nullptr);
+    if (!sprites_filename) {
+        log_fatal("Missing sprites_filename in [canvas]");
+    }
+
+    asset_loader::reset(*game.asset_loader);
+    asset_loader::add(*game.asset_loader, "sprites", sprites_filename, load_sprites, release_image);
+    asset_loader::add(*game.asset_loader, "waves", waves::filename(game.config), load_waves, release_waves);
+    asset_loader::start(*game.asset_loader);
+}
+
+void game_state_initializing_update(engine::Engine &engine, Game &game, float t, float dt) {
+    (void)t;
+    (void)dt;
+
+    AssetLoader &loader = *game.asset_loader;
+
+    if (!asset_loader::poll(loader)) {
+        return;
+    }
+
+    if (const AssetJob *job = asset_loader::failed(loader)) {
+        log_fatal("Could not load %s from %s", job->name, job->filename);
+    }
+
+    const AssetJob *sprites = asset_loader::find(loader, "sprites");
+    assert(sprites != nullptr);
+    indexed_canvas::load_sprites(*game.indexed_canvas, sprites->data, sprites->width, sprites->height);
+
+    const AssetJob *waves = asset_loader::find(loader, "waves");
+    assert(waves != nullptr);
+    game.waves = *(const WaveTable *)waves->data;
+
+    asset_loader::reset(loader);
+
+    transition(engine, game, GameState::Playing);
+}
+
+void game_state_initializing_render(engine::Engine &engine, Game &game) {
+    (void)engine;
+
+    IndexedCanvas &c = *game.indexed_canvas;
+
+    indexed_canvas::clear(c, pico8::black);
+
+    // A progress bar across the middle of the canvas.
+    {
+        int32_t x0 = c.width / 4;
+        int32_t x1 = c.width - c.width / 4;
+        int32_t y0 = c.height / 2 - 3;
+        int32_t y1 = c.height / 2 + 3;
+
+        indexed_canvas::rectangle(c, x0, y0, x1, y1, pico8::light_gray);
+
+        int32_t fill = (int32_t)((float)(x1 - x0 - 3) * asset_loader::progress(*game.asset_loader));
+        for (int32_t y = y0 + 2; fill > 0 && y <= y1 - 2; ++y) {
+            indexed_canvas::line(c, x0 + 2, y, x0 + 1 + fill, y, pico8::white);
+        }
+    }
+}
+
+} // namespace game
@@ -0,0 +1,44 @@
+#include "game.h"
+#include "indexed_canvas.h"
+
+#pragma warning(push, 0)
+#include <engine/input.h>
+#pragma warning(pop)
+
+namespace game {
+
+void game_state_paused_enter(engine::Engine &engine, Game &game) {
+    (void)engine;
+
+    // Releases aren't seen while paused, so let go of every button.
+    game.buttons = 0;
+}
+
+void game_state_paused_on_input(engine::Engine &engine, Game &game, engine::InputCommand &input_command) {
+    if (input_command.input_type != engine::InputType::Key || input_command.key_state.trigger_state != engine::TriggerState::Pressed) {
+        return;
+    }
+
+    switch (input_action(game, input_command)) {
+    case Action::PAUSE: {
+        pop_state(engine, game);
+        break;
+    }
+    case Action::QUIT: {
+        transition(engine, game, GameState::Quitting);
+        break;
+    }
+    default:
+        break;
+    }
+}
+
+void game_state_paused_render(engine::Engine &engine, Game &game) {
+    (void)engine;
+
+    IndexedCanvas &c = *game.indexed_canvas;
+    const TextRun &run = indexed_canvas::text_run(c, "paused");
+    indexed_canvas::blit_text(c, run, (c.width - run.width) / 2, (c.height - run.height) / 2, pico8::white);
+}
+
+} // namespace game
@@ -1,117 +1,196 @@
 #include "game.h"
+#include "indexed_canvas.h"
+#include "input_log.h"
+#include "lockstep.h"
+#include "particles.h"
+#include "replay.h"
+#include "rollback.h"
 #include "util.h"
+#include "world.h"
+#include "world_render.h"
 
 #pragma warning(push, 0)
-#include "rnd.h"
-
 #include <cassert>
-#include <cmath>
 #include <ctime>
 
-#include <hash.h>
-#include <queue.h>
-#include <string_stream.h>
-#include <temp_allocator.h>
-
 #include <engine/action_binds.h>
 #include <engine/canvas.h>
 #include <engine/input.h>
 #include <engine/log.h>
-
-#include <imgui.h>
 #pragma warning(pop)
 
 namespace game {
 
 using namespace foundation;
 
-rnd_pcg_t random_device;
+// The most ticks simulated in one frame, so a long frame or a stall doesn't make the game race to catch up.
+constexpr uint32_t MaxTicksPerFrame = 4;
+
+// The action of each button, indexed by the button's bit.
+constexpr Action button_actions[] = {Action::UP, Action::DOWN, Action::LEFT, Action::RIGHT, Action::ACTION};
+
+// Presses and releases what the bot wants held, logging the same actions the keys would.
+static void press_bot_buttons(Game &game, TickInput buttons) {
+    for (uint32_t i = 0; i < sizeof(button_actions) / sizeof(button_actions[0]); ++i) {
+        const Button button = Button(1 << i);
+        const bool down = held(buttons, button);
+
+        if (down != held(game.buttons, button)) {
+            input_log::record(*game.input_log, button_actions[i], down);
+            set_button(game.buttons, button, down);
+        }
+    }
+}
+
+// Bursts particles at the players that ate or were hit since the last bursts.
+static void burst_effects(Game &game) {
+    const World &world = game.world;
+
+    for (uint32_t i = 0; i < world.player_count; ++i) {
+        const Player &player = world.players[i];
+        const float x = (float)player.pos.x + (float)player.bounds.origin.x + (float)player.bounds.size.x / 2;
+        const float y = (float)player.pos.y + (float)player.bounds.origin.y + (float)player.bounds.size.y / 2;
+
+        if (player.score > game.burst_scores[i]) {
+            particles::burst(*game.particles, ParticleEffect::Pickup, x, y, game.pickup_particles);
+        }
+        if (player.hits > game.burst_hits[i]) {
+            particles::burst(*game.particles, ParticleEffect::Hit, x, y, game.hit_particles);
+        }
+
+        game.burst_scores[i] = player.score;
+        game.burst_hits[i] = player.hits;
+    }
+}
 
 void game_state_playing_enter(engine::Engine &engine, Game &game) {
-    engine::init_canvas(engine, *game.canvas, game.config);
+    (void)engine;
+
+    game.buttons = 0;
+    game.particles->count = 0;
+    for (uint32_t i = 0; i < PlayerMax; ++i) {
+        game.burst_scores[i] = 0;
+        game.burst_hits[i] = 0;
+    }
+    game.tick_accumulator = 0.0f;
+    game.world.player_count = 0;
+
+    uint32_t seed = (uint32_t)time(nullptr);
+
+    if (game.net.mode == NetMode::Local) {
+        if (game.replay_path) {
+            if (!replay::open(*game.replay_reader, game.replay_path)) {
+                log_fatal("Could not play replay %s", game.replay_path);
+            }
 
-    rnd_pcg_seed(&random_device, (unsigned int)time(nullptr));
+            if (game.replay_reader->header.config_hash != game.config_hash) {
+                log_error("Replay %s was recorded with a different config, it may not play back the same", game.replay_path);
+            }
+
+            replay::start(*game.replay_reader, game.world, game.config, game.waves);
+            return;
+        }
+
+        world::init(game.world, game.config, game.waves, game.canvas->width, game.canvas->height, seed, 1);
+        bot::init(game.bot, 0, game.bot_skill, seed);
+
+        if (game.record_path) {
+            uint32_t keyframe_interval = (uint32_t)config_int(game.config, "replay", "keyframe_interval", (int32_t)ReplayKeyframeInterval);
+            replay::open(*game.replay_writer, game.record_path, game.world, seed, game.config_hash, keyframe_interval);
+        }
+        return;
+    }
 
-    game.player = Player();
-    game.player.pos = {24, 24};
+    if (game.record_path || game.replay_path) {
+        log_error("Replays only record and play local games");
+    }
 
-    game.enemy = Enemy();
-    game.enemy.pos = {game.canvas->width / 2.0f - game.enemy.bounds.size.x / 2.0f, game.canvas->height / 2.0f - game.enemy.bounds.size.y / 2.0f};
+    // The world starts once the peer has connected and the seed is agreed.
+    LockstepRole role = game.net.mode == NetMode::Host ? LockstepRole::Host : LockstepRole::Join;
+    if (!lockstep::open(*game.lockstep, role, game.net.address, game.net.port, game.net.input_delay, seed, game.config_hash, game.net.timeout)) {
+        log_fatal("Could not open the lockstep session");
+    }
 
-    game.food = Food();
+    // A tick can only be predicted as long as its snapshot is still kept.
+    uint32_t max_prediction = game.net.max_rollback < RollbackWindow ? game.net.max_rollback : RollbackWindow - 1;
+    lockstep::set_prediction(*game.lockstep, max_prediction);
+    lockstep::simulate_conditions(*game.lockstep, game.net.sim_latency, game.net.sim_jitter, game.net.sim_loss);
 }
 
 void game_state_playing_leave(engine::Engine &engine, Game &game) {
     (void)engine;
-    (void)game;
+
+    lockstep::close(*game.lockstep);
+    replay::close(*game.replay_writer);
+    replay::close(*game.replay_reader);
 }
 
 void game_state_playing_on_input(engine::Engine &engine, Game &game, engine::InputCommand &input_command) {
-    assert(game.action_binds != nullptr);
-
     if (input_command.input_type == engine::InputType::Key) {
         bool pressed = input_command.key_state.trigger_state == engine::TriggerState::Pressed;
         bool released = input_command.key_state.trigger_state == engine::TriggerState::Released;
 
-        engine::ActionBindsBind bind = engine::bind_for_keycode(input_command.key_state.keycode);
-        if (bind == engine::ActionBindsBind::NOT_FOUND) {
-            log_error("ActionBind not found for keycode %d", input_command.key_state.keycode);
-            return;
+        Action action = input_action(game, input_command);
+        if (action != Action::NONE && (pressed || released)) {
+            input_log::record(*game.input_log, action, pressed);
         }
 
-        uint64_t bind_key = static_cast<uint64_t>(bind);
-        ActionHash action_hash = ActionHash(hash::get(game.action_binds->bind_actions, bind_key, (uint64_t)0));
-
-        switch (action_hash) {
-        case ActionHash::QUIT: {
+        switch (action) {
+        case Action::QUIT: {
             if (pressed) {
                 transition(engine, game, GameState::Quitting);
             }
             break;
         }
-        case ActionHash::UP: {
+        case Action::UP: {
             if (pressed) {
-                game.player.button_up = true;
+                set_button(game.buttons, Button::Up, true);
             } else if (released) {
-                game.player.button_up = false;
+                set_button(game.buttons, Button::Up, false);
             }
             break;
         }
-        case ActionHash::LEFT: {
+        case Action::LEFT: {
             if (pressed) {
-                game.player.button_left = true;
+                set_button(game.buttons, Button::Left, true);
             } else if (released) {
-                game.player.button_left = false;
+                set_button(game.buttons, Button::Left, false);
             }
             break;
         }
-        case ActionHash::RIGHT: {
+        case Action::RIGHT: {
             if (pressed) {
-                game.player.button_right = true;
+                set_button(game.buttons, Button::Right, true);
             } else if (released) {
-                game.player.button_right = false;
+                set_button(game.buttons, Button::Right, false);
             }
             break;
         }
-        case ActionHash::DOWN: {
+        case Action::DOWN: {
             if (pressed) {
-                game.player.button_down = true;
+                set_button(game.buttons, Button::Down, true);
             } else if (released) {
-                game.player.button_down = false;
+                set_button(game.buttons, Button::Down, false);
             }
             break;
         }
-        case ActionHash::ACTION: {
+        case Action::ACTION: {
             if (pressed) {
-                game.player.button_action = true;
+                set_button(game.buttons, Button::Action, true);
             } else if (released) {
-                game.player.button_action = false;
+                set_button(game.buttons, Button::Action, false);
+            }
+            break;
+        }
+        case Action::DEBUG: {
+            if (pressed) {
+                push_state(engine, game, GameState::Debug);
             }
             break;
         }
-        case ActionHash::DEBUG: {
+        case Action::PAUSE: {
             if (pressed) {
-                game.show_debug = !game.show_debug;
+                push_state(engine, game, GameState::Paused);
             }
             break;
         }
@@ -122,275 +201,102 @@ void game_state_playing_on_input(engine::Engine &engine, Game &game, engine::Inp
 }
 
 void game_state_playing_update(engine::Engine &engine, Game &game, float t, float dt) {
-    (void)engine;
+    (void)t;
 
-    using namespace foundation;
+    input_log::consume(*game.input_log);
 
-    // Update player
-    {
-        float steer_x = 0.0f;
-        float steer_y = 0.0f;
+    World &world = game.world;
+    Lockstep &lockstep = *game.lockstep;
+    const bool networked = game.net.mode != NetMode::Local;
 
-        if (game.player.button_up) {
-            steer_y -= game.player.speed_incr;
-        }
-        if (game.player.button_down) {
-            steer_y += game.player.speed_incr;
+    if (networked) {
+        lockstep::poll(lockstep, dt);
+
+        if (lockstep.status == LockstepStatus::Disconnected) {
+            transition(engine, game, GameState::Quitting);
+            return;
         }
-        if (game.player.button_left) {
-            steer_x -= game.player.speed_incr;
+
+        if (lockstep.status == LockstepStatus::Connecting) {
+            return;
         }
-        if (game.player.button_right) {
-            steer_x += game.player.speed_incr;
+
+        if (world.player_count == 0) {
+            world::init(world, game.config, game.waves, game.canvas->width, game.canvas->height, lockstep.seed, PlayerMax);
+            rollback::init(*game.rollback, world.bullets.max_capacity);
+            bot::init(game.bot, lockstep.local_player, game.bot_skill, lockstep.seed + lockstep.local_player);
         }
 
-        game.player.vel.x += steer_x * dt;
-        game.player.vel.y += steer_y * dt;
-
-        // velocity magnitude
-        float vel_mag = sqrtf(game.player.vel.x * game.player.vel.x + game.player.vel.y * game.player.vel.y);
-
-        // check if faster than max
-        if (vel_mag > game.player.max_speed) {
-            float norm_vel_x = game.player.vel.x / vel_mag;
-            float norm_vel_y = game.player.vel.y / vel_mag;
-            game.player.vel.x = norm_vel_x * game.player.max_speed;
-            game.player.vel.y = norm_vel_y * game.player.max_speed;
-            vel_mag = game.player.max_speed;
-        } else if (vel_mag < 0.01f) {
-            // check if almost stopped
-            game.player.vel.x = 0.0f;
-            game.player.vel.y = 0.0f;
-        } else {
-            // apply a little bit of drag
-            game.player.vel.x = game.player.vel.x * (1.0f - game.player.drag);
-            game.player.vel.y = game.player.vel.y * (1.0f - game.player.drag);
+        // Inputs that arrived since the last frame may show that a guess was wrong.
+        uint32_t rollback_tick;
+        if (lockstep::take_rollback(lockstep, rollback_tick) && !rollback::resimulate(*game.rollback, world, lockstep, rollback_tick)) {
+            log_error("Can't roll back to tick %u, the worlds have diverged", rollback_tick);
+            transition(engine, game, GameState::Quitting);
+            return;
         }
+    }
 
-        // update position
-        game.player.pos.x += game.player.vel.x;
-        game.player.pos.y += game.player.vel.y;
+    // Simulate in fixed ticks, whatever the frame rate.
+    game.tick_accumulator += dt;
+    if (game.tick_accumulator > MaxTicksPerFrame * TickDt) {
+        game.tick_accumulator = MaxTicksPerFrame * TickDt;
+    }
 
-        // check for out of bounds
-        // account for player size
-        {
-            if (game.player.pos.x + game.player.bounds.origin.x + game.player.bounds.size.x > game.canvas->width - 1) {
-                game.player.pos.x = (float)game.canvas->width - game.player.bounds.size.x - 1;
-                game.player.vel.x = 0.0f;
+    while (game.tick_accumulator >= TickDt) {
+        if (networked) {
+            // Spend a tick's time without simulating when we are ahead of the peer.
+            if (lockstep::should_yield(lockstep, world.tick)) {
+                game.tick_accumulator -= TickDt;
+                continue;
             }
 
-            if (game.player.pos.x + game.player.bounds.origin.x < 1) {
-                game.player.pos.x = -(float)game.player.bounds.origin.x + 1;
-                game.player.vel.x = 0.0f;
+            if (game.bot_skill >= 0.0f) {
+                press_bot_buttons(game, bot::think(game.bot, world));
             }
 
-            if (game.player.pos.y + game.player.bounds.origin.y + game.player.bounds.size.y > game.canvas->height - 1) {
-                game.player.pos.y = (float)game.canvas->height - game.player.bounds.origin.y - game.player.bounds.size.y - 1;
-                game.player.vel.y = 0.0f;
-            }
+            lockstep::schedule(lockstep, world.tick, game.buttons);
 
-            if (game.player.pos.y + game.player.bounds.origin.y < 10) {
-                game.player.pos.y = -(float)game.player.bounds.origin.y + 10;
-                game.player.vel.y = 0.0f;
+            TickInput inputs[PlayerMax];
+            if (!lockstep::inputs_for(lockstep, world.tick, inputs)) {
+                break;
             }
-        }
-    }
 
-    // update enemy
-    {
-        // rotate bullet spawner
-        game.enemy.rot += game.enemy.rot_speed * dt;
-
-        // update enemy position
-        float tt = t * game.enemy.speed + 20.0f;
-        float scale = 2.0f / (3.0f - cosf(2.0f * tt));
-        float x = scale * cosf(tt);
-        float y = scale * sinf(2.0f * tt) / 2.0f;
-        float x2 = game.canvas->width / 2.0f + x * 48.0f;
-        float y2 = game.canvas->height / 2.0f + y * 64.0f;
-
-        game.enemy.pos.x = x2;
-        game.enemy.pos.y = y2;
-
-        // spawn 4 bullets every few frames
-        if (game.enemy.bullet_cooldown >= game.enemy.bullet_rate) {
-            for (int i = 0; i < 4; ++i) {
-                Bullet b;
-                b.pos.x = game.enemy.pos.x + game.enemy.bounds.origin.x + game.enemy.bounds.size.x / 2.0f;
-                b.pos.y = game.enemy.pos.y + game.enemy.bounds.origin.y + game.enemy.bounds.size.y / 2.0f;
-
-                float angle = i * (float)M_PI_2 + game.enemy.rot;
-                b.vel.x = game.enemy.bullet_speed * cosf(angle);
-                b.vel.y = game.enemy.bullet_speed * sinf(angle);
-
-                array::push_back(game.bullets, b);
+            rollback::advance(*game.rollback, world, inputs);
+        } else if (game.replay_reader->file) {
+            TickInput inputs[PlayerMax];
+            if (!replay::next(*game.replay_reader, inputs)) {
+                log_info("Replay ended at tick %u, score %d", world.tick, world::score(world));
+                transition(engine, game, GameState::Quitting);
+                return;
             }
 
-            game.enemy.bullet_cooldown = dt;
+            world::tick(world, inputs);
         } else {
-            game.enemy.bullet_cooldown += dt;
-        }
-    }
-
-    // update bullets
-    {
-        for (Bullet *bullet_iter = array::begin(game.bullets); bullet_iter != array::end(game.bullets); ++bullet_iter) {
-            bullet_iter->pos.x += bullet_iter->vel.x * dt;
-            bullet_iter->pos.y += bullet_iter->vel.y * dt;
-        }
-
-        // check for out of bounds bullets
-        const math::Rect game_rect = {{0, 10}, {game.canvas->width, game.canvas->height - 10}};
-        for (uint32_t i = 0; i < array::size(game.bullets); ++i) {
-            if (!math::is_inside(game_rect, game.bullets[i].pos)) {
-                swap_pop(game.bullets, i);
+            if (game.bot_skill >= 0.0f) {
+                press_bot_buttons(game, bot::think(game.bot, world));
             }
-        }
-    }
 
-    // update food
-    {
-        math::Rect player_rect = game.player.bounds;
-        player_rect.origin.x += (int32_t)game.player.pos.x;
-        player_rect.origin.y += (int32_t)game.player.pos.y;
-
-        if (game.food.spawned) {
-            math::Rect food_rect = game.food.bounds;
-            food_rect.origin.x += (int32_t)game.food.pos.x;
-            food_rect.origin.y += (int32_t)game.food.pos.y;
-
-            if (math::is_inside(player_rect, food_rect)) {
-                game.player.score += 1;
-                if (game.player.score >= 10) {
-                    game.enemy.bullet_rate = 0.75f;
-                }
-                game.food.grace_timer = 0.0f;
-                game.food.spawned = false;
-            }
-        } else {
-            if (game.food.grace_timer >= game.food.grace) {
-                // retry until we find a position outside of enemy and player
-                while (true) {
-                    math::Vector2 pos = {
-                        rnd_pcg_range(&random_device, 2, game.canvas->width - game.food.bounds.size.x - 2),
-                        rnd_pcg_range(&random_device, 11, game.canvas->height - game.food.bounds.size.y - 2)};
-
-                    math::Rect enemy_rect = game.enemy.bounds;
-                    enemy_rect.origin.x += (int32_t)game.enemy.pos.x;
-                    enemy_rect.origin.y += (int32_t)game.enemy.pos.y;
-
-                    if (!math::is_inside(player_rect, pos) && !math::is_inside(enemy_rect, pos)) {
-                        game.food.spawned = true;
-                        game.food.pos.x = (float)pos.x;
-                        game.food.pos.y = (float)pos.y;
-                        int32_t sprite = rnd_pcg_range(&random_device, 859, 862);
-                        game.food.sprite = sprite;
-                        break;
-                    }
-                }
-            } else {
-                game.food.grace_timer += dt;
-            }
+            replay::record(*game.replay_writer, world, &game.buttons);
+            world::tick(world, &game.buttons);
         }
-    }
-}
 
-void game_state_playing_render(engine::Engine &engine, Game &game) {
-    using namespace engine::canvas;
-    namespace ss = foundation::string_stream;
-    namespace color = engine::color::pico8;
-
-    TempAllocator128 ta;
-
-    engine::Canvas &c = *game.canvas;
-    clear(c, engine::color::black);
-
-    // draw food
-    if (game.food.spawned) {
-        sprite(c, game.food.sprite, (int32_t)game.food.pos.x, (int32_t)game.food.pos.y);
+        game.tick_accumulator -= TickDt;
     }
 
-    // draw bullets
-    for (Bullet *bullet_iter = array::begin(game.bullets); bullet_iter != array::end(game.bullets); ++bullet_iter) {
-        pset(c, (int32_t)bullet_iter->pos.x, (int32_t)bullet_iter->pos.y, color::red);
-    }
-
-    // draw player
-    sprite(c, 856, (int32_t)game.player.pos.x, (int32_t)game.player.pos.y);
-
-    // draw enemy
-    sprite(c, 857, (int32_t)game.enemy.pos.x, (int32_t)game.enemy.pos.y);
-
-    // draw ui
-    rectangle(c, 0, 0, c.width - 1, c.height - 1, color::dark_blue);
-    ss::Buffer score_buffer(ta);
-    ss::printf(score_buffer, "score:%u", game.player.score);
-    print(c, ss::c_str(score_buffer), 1, 1, color::white);
-    line(c, 0, 9, c.width - 1, 9, color::dark_blue);
-
-    if (game.show_debug) {
-        math::Rect enemy_rect = game.enemy.bounds;
-        enemy_rect.origin.x += (int32_t)game.enemy.pos.x;
-        enemy_rect.origin.y += (int32_t)game.enemy.pos.y;
-
-        math::Rect player_rect = game.player.bounds;
-        player_rect.origin.x += (int32_t)game.player.pos.x;
-        player_rect.origin.y += (int32_t)game.player.pos.y;
-
-        math::Rect food_rect = game.food.bounds;
-        food_rect.origin.x += (int32_t)game.food.pos.x;
-        food_rect.origin.y += (int32_t)game.food.pos.y;
-
-        rectangle(c, enemy_rect.origin.x, enemy_rect.origin.y, enemy_rect.origin.x + enemy_rect.size.x, enemy_rect.origin.y + enemy_rect.size.y, color::green);
-        rectangle(c, player_rect.origin.x, player_rect.origin.y, player_rect.origin.x + player_rect.size.x, player_rect.origin.y + player_rect.size.y, color::green);
-
-        if (game.food.spawned) {
-            rectangle(c, food_rect.origin.x, food_rect.origin.y, food_rect.origin.x + food_rect.size.x, food_rect.origin.y + food_rect.size.y, color::green);
-        }
+    if (networked) {
+        lockstep::flush(lockstep);
     }
 
-    engine::render_canvas(engine, *game.canvas);
+    burst_effects(game);
+    particles::update(*game.particles, dt, game.indexed_canvas->width, game.indexed_canvas->height);
 }
 
-void game_state_playing_render_imgui(engine::Engine &engine, Game &game) {
+void game_state_playing_render(engine::Engine &engine, Game &game) {
     (void)engine;
 
-    if (game.show_debug) {
-        ImGui::SetNextWindowSize(ImVec2(200, 300), ImGuiCond_Once);
-        ImGui::SetNextWindowPos(ImVec2(8, 8), ImGuiCond_Once);
-        if (!ImGui::Begin("Debug", &game.show_debug)) {
-            ImGui::End();
-            return;
-        }
-
-        ImGui::Text("Player");
-        ImGui::Text("Position: %.1f, %.1f", game.player.pos.x, game.player.pos.y);
-        ImGui::Text("Velocity: %.1f, %.1f", game.player.vel.x, game.player.vel.y);
-        ImGui::Text("Score: %d", game.player.score);
-        float vel_mag = sqrtf(game.player.vel.x * game.player.vel.x + game.player.vel.y * game.player.vel.y);
-        ImGui::Text("VelMag: %.2f", vel_mag);
-
-        ImGui::Text("");
-
-        ImGui::Text("Enemy");
-        ImGui::Text("Position: %.1f, %.1f", game.enemy.pos.x, game.enemy.pos.y);
-        ImGui::Text("Bullets: %d", array::size(game.bullets));
-        ImGui::SameLine();
-        if (ImGui::Button("Clear")) {
-            array::clear(game.bullets);
-        }
-
-        ImGui::Text("");
-
-        ImGui::Text("Food");
-        ImGui::Text("Spawned: ");
-        ImGui::SameLine();
-        ImGui::Text(game.food.spawned ? "true" : "false");
-        ImGui::Text("Position: (%.1f, %.1f)", game.food.pos.x, game.food.pos.y);
-        ImGui::Text("Cooldown: %.1fs", game.food.grace - game.food.grace_timer);
-
-        ImGui::End();
-    }
+    bool thin = frame_governor::sheds(game.governor, QualityLevel::ThinFarField);
+    world_render::draw(*game.indexed_canvas, game.world, game.hud, thin, game.governor.frames);
+    particles::draw(*game.particles, *game.indexed_canvas, thin, game.governor.frames);
 }
 
 } // namespace game
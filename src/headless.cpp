@@ -0,0 +1,2011 @@
+#include "bot.h"
+#include "bullet_pool.h"
+#include "collision.h"
+#include "config.h"
+#include "frame_capture.h"
+#include "frame_governor.h"
+#include "indexed_canvas.h"
+#include "input_log.h"
+#include "lockstep.h"
+#include "motion.h"
+#include "particles.h"
+#include "replay.h"
+#include "rollback.h"
+#include "tracking_allocator.h"
+#include "upscale.h"
+#include "world.h"
+#include "world_render.h"
+
+#pragma warning(push, 0)
+#define RND_IMPLEMENTATION
+#include "rnd.h"
+
+#include <engine/ini.h>
+#include <engine/log.h>
+
+#include <array.h>
+#include <memory.h>
+#include <murmur_hash.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+
+#include <stb_image.h>
+#pragma warning(pop)
+
+using namespace game;
+using namespace foundation;
+
+// The playfield of the game's canvas.
+constexpr int32_t PlayfieldWidth = 128;
+constexpr int32_t PlayfieldHeight = 128;
+
+// The golden list checked in with the assets.
+constexpr const char *GoldenListPath = "assets/golden_frames.txt";
+
+// The sweep of gameplay parameters checked in with the assets.
+constexpr const char *TuneSweepPath = "assets/tune.ini";
+
+// The time a frame has at 60 Hz.
+constexpr double FrameBudgetNs = 1000000000.0 / 60.0;
+
+static ini_t *load_config(const char *path, uint64_t &hash) {
+    FILE *file = fopen(path, "rb");
+    if (!file) {
+        log_fatal("Could not open config file %s", path);
+    }
+
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+
+    char *text = (char *)malloc((size_t)size + 1);
+    size_t read = fread(text, 1, (size_t)size, file);
+    text[read] = '\0';
+    fclose(file);
+
+    ini_t *config = ini_load(text, nullptr);
+    hash = murmur_hash_64(text, (uint32_t)read, 0);
+    free(text);
+
+    if (!config) {
+        log_fatal("Could not parse config file %s", path);
+    }
+
+    hash = waves::hash(config, hash);
+
+    return config;
+}
+
+// Buttons held at random, changed every few ticks so a prediction is wrong now and then.
+struct RandomBot {
+    rnd_pcg_t random;
+    TickInput input;
+    uint32_t hold;
+};
+
+static TickInput random_input(RandomBot &bot) {
+    if (bot.hold == 0) {
+        bot.input = (TickInput)rnd_pcg_range(&bot.random, 0, 31);
+        bot.hold = (uint32_t)rnd_pcg_range(&bot.random, 1, 30);
+    }
+
+    --bot.hold;
+    return bot.input;
+}
+
+/**
+ * @brief Measures the worst case of a rollback: restoring the oldest snapshot
+ * with a full bullet pool and simulating every tick since again.
+ */
+static int bench(Allocator &allocator, const ini_t *config, uint32_t bullets, uint32_t depth, uint32_t iterations) {
+    if (depth == 0 || depth >= RollbackWindow) {
+        log_error("Depth must be between 1 and %u", RollbackWindow - 1);
+        return 1;
+    }
+
+    World world(allocator);
+    world::init(world, config, PlayfieldWidth, PlayfieldHeight, 1, PlayerMax);
+    bullet_pool::init(world.bullets, bullets, bullets, BulletOverflow::RecycleOldest);
+
+    // Fill the pool with slow bullets that stay on the playfield while the ticks are simulated again.
+    for (uint32_t i = 0; i < world.bullets.capacity; ++i) {
+        Bullet *bullet = bullet_pool::spawn(world.bullets);
+        bullet->pos.x = (float)rnd_pcg_range(&world.random, 8, PlayfieldWidth - 8);
+        bullet->pos.y = (float)rnd_pcg_range(&world.random, 18, PlayfieldHeight - 8);
+        bullet->vel.x = rnd_pcg_nextf(&world.random) * 2.0f - 1.0f;
+        bullet->vel.y = rnd_pcg_nextf(&world.random) * 2.0f - 1.0f;
+    }
+
+    Rollback *rollback = MAKE_NEW(allocator, Rollback, allocator);
+    rollback::init(*rollback, world.bullets.capacity);
+
+    // A session that already knows every input, so it only hands them out.
+    Lockstep *lockstep = MAKE_NEW(allocator, Lockstep);
+    lockstep->known[0] = UINT32_MAX / 2;
+    lockstep->known[1] = UINT32_MAX / 2;
+
+    RandomBot bot = {};
+    rnd_pcg_seed(&bot.random, 2);
+
+    TickInput inputs[PlayerMax] = {};
+    for (uint32_t i = 0; i < depth; ++i) {
+        inputs[0] = random_input(bot);
+        rollback::advance(*rollback, world, inputs);
+    }
+
+    uint64_t total_ns = 0;
+    for (uint32_t i = 0; i < iterations; ++i) {
+        if (!rollback::resimulate(*rollback, world, *lockstep, world.tick - depth)) {
+            log_fatal("Lost the snapshot of tick %u", world.tick - depth);
+        }
+        total_ns += rollback->last_rollback_ns;
+    }
+
+    double average_ns = (double)total_ns / iterations;
+    double worst_ns = (double)rollback->worst_rollback_ns;
+
+    printf("bullets: %u, depth: %u, iterations: %u\n", world.bullets.count, depth, iterations);
+    printf("average: %.3fms (%.3fms per tick), worst: %.3fms\n", average_ns / 1000000.0, average_ns / depth / 1000000.0, worst_ns / 1000000.0);
+    printf("worst is %.1f%% of a 60 Hz frame\n", worst_ns / FrameBudgetNs * 100.0);
+
+    MAKE_DELETE(allocator, Lockstep, lockstep);
+    MAKE_DELETE(allocator, Rollback, rollback);
+
+    return worst_ns <= FrameBudgetNs ? 0 : 1;
+}
+
+// Times the motion of a tick on a scalar, in nanoseconds per tick.
+template <typename T>
+static double time_motion(Allocator &allocator, uint32_t bullets, uint32_t ticks, float &sum) {
+    Array<BasicBullet<T>> pool(allocator);
+    array::resize(pool, bullets);
+
+    rnd_pcg_t random;
+    rnd_pcg_seed(&random, 3);
+
+    for (uint32_t i = 0; i < bullets; ++i) {
+        BasicBullet<T> &bullet = pool[i];
+        bullet.pos = {T(rnd_pcg_nextf(&random) * PlayfieldWidth), T(10 + rnd_pcg_nextf(&random) * (PlayfieldHeight - 10))};
+        bullet.vel = {T(rnd_pcg_nextf(&random) * 40.0f - 20.0f), T(rnd_pcg_nextf(&random) * 40.0f - 20.0f)};
+    }
+
+    BasicPlayer<T> players[PlayerMax];
+    BasicEnemy<T> enemy;
+    BasicPathLut<T> paths;
+    motion::build_paths(paths);
+    const math::Rect bounds = {{0, 10}, {PlayfieldWidth, PlayfieldHeight - 10}};
+
+    RandomBot bot = {};
+    rnd_pcg_seed(&bot.random, 4);
+
+    uint64_t start = time_now_ns();
+
+    for (uint32_t tick = 0; tick < ticks; ++tick) {
+        for (BasicPlayer<T> &player : players) {
+            motion::move_player(player, random_input(bot), PlayfieldWidth, PlayfieldHeight);
+        }
+
+        motion::move_enemy(enemy, paths, PlayfieldWidth, PlayfieldHeight);
+
+        // Bounce the bullets that leave, so the count stays the same.
+        for (uint32_t i = 0; i < bullets; ++i) {
+            BasicBullet<T> &bullet = pool[i];
+            if (!motion::move_bullet(bullet, bounds)) {
+                bullet.vel.x = -bullet.vel.x;
+                bullet.vel.y = -bullet.vel.y;
+            }
+        }
+    }
+
+    uint64_t elapsed = time_now_ns() - start;
+
+    // Use the results, so the work isn't optimized away.
+    for (uint32_t i = 0; i < bullets; ++i) {
+        sum += (float)pool[i].pos.x + (float)pool[i].pos.y;
+    }
+    sum += (float)enemy.pos.x + (float)players[0].pos.x;
+
+    return (double)elapsed / ticks;
+}
+
+/**
+ * @brief Compares the cost of the motion of a tick on float and on Fixed.
+ *
+ * The scalars take turns over a few rounds and each keeps its best, so a burst of
+ * load on the machine doesn't land on one of them only.
+ */
+static int bench_math(Allocator &allocator, uint32_t bullets, uint32_t ticks) {
+    const uint32_t Rounds = 5;
+
+    float sum = 0.0f;
+    double float_ns = 0.0;
+    double fixed_ns = 0.0;
+    for (uint32_t round = 0; round < Rounds; ++round) {
+        double float_round = time_motion<float>(allocator, bullets, ticks, sum);
+        double fixed_round = time_motion<Fixed>(allocator, bullets, ticks, sum);
+        float_ns = round == 0 || float_round < float_ns ? float_round : float_ns;
+        fixed_ns = round == 0 || fixed_round < fixed_ns ? fixed_round : fixed_ns;
+    }
+
+    printf("bullets: %u, ticks: %u, best of %u (%.0f)\n", bullets, ticks, Rounds, (double)sum);
+    printf("float: %.3fus per tick, %.2fns per bullet\n", float_ns / 1000.0, float_ns / bullets);
+    printf("fixed: %.3fus per tick, %.2fns per bullet\n", fixed_ns / 1000.0, fixed_ns / bullets);
+    printf("fixed takes %.2fx the time of float\n", fixed_ns / float_ns);
+
+    return 0;
+}
+
+// Counts the bullets that end a tick inside a player, the discrete test swept collision replaces.
+static uint32_t discrete_hits(const World &world) {
+    const Real dt = TickDt;
+    uint32_t hits = 0;
+
+    for (uint32_t i = 0; i < world.bullets.count; ++i) {
+        const Bullet &bullet = bullet_pool::at(world.bullets, i);
+        const Vector2r end = {bullet.pos.x + bullet.vel.x * dt, bullet.pos.y + bullet.vel.y * dt};
+
+        for (uint32_t p = 0; p < world.player_count; ++p) {
+            const Player &player = world.players[p];
+            math::Rect rect = player.bounds;
+            rect.origin.x += (int32_t)player.pos.x;
+            rect.origin.y += (int32_t)player.pos.y;
+
+            if (real::is_inside(rect, end)) {
+                ++hits;
+                break;
+            }
+        }
+    }
+
+    return hits;
+}
+
+// Counts the bullets that touch a still player at any of many points along their path, to check swept collision against.
+// The path ends where the tick moves the bullet, and is sampled in float so the reference doesn't round like Fixed.
+// Marks the bullets that hit in hit, indexed from the oldest bullet.
+static uint32_t sampled_hits(const World &world, uint32_t samples, uint8_t *hit_by_bullet) {
+    const Real dt = TickDt;
+    uint32_t hits = 0;
+
+    for (uint32_t i = 0; i < world.bullets.count; ++i) {
+        const Bullet &bullet = bullet_pool::at(world.bullets, i);
+        const float x0 = (float)bullet.pos.x;
+        const float y0 = (float)bullet.pos.y;
+        const float x1 = (float)(bullet.pos.x + bullet.vel.x * dt);
+        const float y1 = (float)(bullet.pos.y + bullet.vel.y * dt);
+        bool hit = false;
+
+        for (uint32_t s = 0; s <= samples && !hit; ++s) {
+            const float t = (float)s / (float)samples;
+            const float px = x0 + (x1 - x0) * t;
+            const float py = y0 + (y1 - y0) * t;
+
+            for (uint32_t p = 0; p < world.player_count && !hit; ++p) {
+                const Player &player = world.players[p];
+                const float x = (float)player.pos.x + (float)player.bounds.origin.x;
+                const float y = (float)player.pos.y + (float)player.bounds.origin.y;
+                hit = px >= x && py >= y && px <= x + (float)player.bounds.size.x && py <= y + (float)player.bounds.size.y;
+            }
+        }
+
+        hit_by_bullet[i] = hit ? 1 : 0;
+        hits += hit ? 1 : 0;
+    }
+
+    return hits;
+}
+
+/**
+ * @brief Times swept collision against the discrete end of tick test, with
+ * bullets fast enough to pass through a player in a tick, and checks its hits
+ * bullet by bullet against sampling every path finely.
+ *
+ * The tests take turns over a few rounds and each keeps its best, like bench_math.
+ */
+static int bench_collision(Allocator &allocator, const ini_t *config, uint32_t bullets, float speed, uint32_t iterations) {
+    World world(allocator);
+    world::init(world, config, PlayfieldWidth, PlayfieldHeight, 1, PlayerMax);
+    bullet_pool::init(world.bullets, bullets, bullets, BulletOverflow::RecycleOldest);
+    collision::reserve(world.sweep, world.bullets.capacity, PlayfieldWidth);
+
+    for (uint32_t i = 0; i < world.bullets.capacity; ++i) {
+        Bullet *bullet = bullet_pool::spawn(world.bullets);
+        float angle = rnd_pcg_nextf(&world.random) * 6.2831853f;
+        // Off the pixel grid, so no path starts exactly on a corner, where Fixed rounds either way.
+        bullet->pos.x = rnd_pcg_nextf(&world.random) * PlayfieldWidth;
+        bullet->pos.y = 10 + rnd_pcg_nextf(&world.random) * (PlayfieldHeight - 10);
+        bullet->vel.x = speed * cosf(angle);
+        bullet->vel.y = speed * sinf(angle);
+    }
+
+    world.players[1].pos = {Real(PlayfieldWidth / 2), Real(PlayfieldHeight / 2)};
+
+    // The players stand still, so the sampled reference is exact up to its step.
+    Vector2r previous[PlayerMax];
+    for (uint32_t p = 0; p < PlayerMax; ++p) {
+        previous[p] = world.players[p].pos;
+    }
+
+    const uint32_t Rounds = 5;
+    uint32_t discrete = 0;
+    uint32_t swept = 0;
+    double discrete_ns = 0;
+    double swept_ns = 0;
+
+    for (uint32_t round = 0; round < Rounds; ++round) {
+        uint64_t start = time_now_ns();
+        for (uint32_t i = 0; i < iterations; ++i) {
+            discrete = discrete_hits(world);
+        }
+        double discrete_round = (double)(time_now_ns() - start) / iterations;
+
+        start = time_now_ns();
+        for (uint32_t i = 0; i < iterations; ++i) {
+            swept = collision::hit_players(world, previous);
+        }
+        double swept_round = (double)(time_now_ns() - start) / iterations;
+
+        discrete_ns = round == 0 || discrete_round < discrete_ns ? discrete_round : discrete_ns;
+        swept_ns = round == 0 || swept_round < swept_ns ? swept_round : swept_ns;
+    }
+
+    // Every pass counted its hits on the players, they don't mean anything here.
+    for (uint32_t p = 0; p < PlayerMax; ++p) {
+        world.players[p].hits = 0;
+    }
+
+    // Hits have to be exact, the same bullets as the reference and not just as many.
+    uint8_t *sampled_hit = (uint8_t *)allocator.allocate(world.bullets.count);
+    uint32_t sampled = sampled_hits(world, 1024, sampled_hit);
+
+    uint32_t mismatched = 0;
+    for (uint32_t i = 0; i < world.bullets.count; ++i) {
+        mismatched += (world.sweep.hit[i] != 0) != (sampled_hit[i] != 0) ? 1 : 0;
+    }
+    allocator.deallocate(sampled_hit);
+
+    printf("bullets: %u, speed: %.0f px/s (%.1f px per tick), best of %u\n", world.bullets.count, (double)speed, (double)speed / TickRate, Rounds);
+    printf("discrete: %.2fus, %u hits\n", discrete_ns / 1000.0, discrete);
+    printf("swept: %.2fus, %u hits, %.2fx discrete\n", swept_ns / 1000.0, swept, swept_ns / discrete_ns);
+    printf("sampled 1024 times per path: %u hits, %u bullets differ from swept\n", sampled, mismatched);
+
+    return swept == sampled && mismatched == 0 ? 0 : 1;
+}
+
+/**
+ * @brief Runs a world with bots and prints its checksum. With FIXED_POINT, every build prints the same.
+ */
+static int checksum(Allocator &allocator, const ini_t *config, uint32_t ticks) {
+    World world(allocator);
+    world::init(world, config, PlayfieldWidth, PlayfieldHeight, 1, PlayerMax);
+
+    RandomBot bots[PlayerMax] = {};
+    for (uint32_t i = 0; i < PlayerMax; ++i) {
+        rnd_pcg_seed(&bots[i].random, i + 1);
+    }
+
+    TickInput inputs[PlayerMax];
+    while (world.tick < ticks) {
+        for (uint32_t i = 0; i < PlayerMax; ++i) {
+            inputs[i] = random_input(bots[i]);
+        }
+        world::tick(world, inputs);
+
+        if (world.tick % 600 == 0 || world.tick == ticks) {
+            printf("tick %u: %016llx\n", world.tick, (unsigned long long)world::checksum(world));
+        }
+    }
+
+#if defined(FIXED_POINT)
+    printf("fixed point, score %d, bullets %u\n", world::score(world), world.bullets.count);
+#else
+    printf("float, score %d, bullets %u\n", world::score(world), world.bullets.count);
+#endif
+
+    return 0;
+}
+
+/**
+ * @brief Records a long run of bots to a replay, like an overnight soak test.
+ */
+static int soak(Allocator &allocator, const ini_t *config, uint64_t config_hash, uint32_t ticks, const char *path, uint32_t keyframe_interval) {
+    const uint32_t seed = 1;
+
+    World world(allocator);
+    world::init(world, config, PlayfieldWidth, PlayfieldHeight, seed, PlayerMax);
+
+    ReplayWriter *writer = MAKE_NEW(allocator, ReplayWriter);
+    if (!replay::open(*writer, path, world, seed, config_hash, keyframe_interval)) {
+        MAKE_DELETE(allocator, ReplayWriter, writer);
+        return 1;
+    }
+
+    RandomBot bots[PlayerMax] = {};
+    for (uint32_t i = 0; i < PlayerMax; ++i) {
+        rnd_pcg_seed(&bots[i].random, i + 1);
+    }
+
+    TickInput inputs[PlayerMax];
+    while (world.tick < ticks) {
+        for (uint32_t i = 0; i < PlayerMax; ++i) {
+            inputs[i] = random_input(bots[i]);
+        }
+
+        replay::record(*writer, world, inputs);
+        world::tick(world, inputs);
+    }
+
+    replay::close(*writer);
+
+    printf("ticks: %u, keyframes: %u, bytes: %llu (%.2f per tick)\n", ticks, writer->keyframes, (unsigned long long)writer->bytes_written, (double)writer->bytes_written / ticks);
+    printf("raw inputs would be %u bytes\n", ticks * PlayerMax);
+    printf("final checksum: %016llx\n", (unsigned long long)world::checksum(world));
+
+    MAKE_DELETE(allocator, ReplayWriter, writer);
+
+    return 0;
+}
+
+/**
+ * @brief Plays a replay back and checks the world against the checksum of every
+ * keyframe, then checks that seeking lands on the same world as playing.
+ */
+static int verify(Allocator &allocator, const ini_t *config, uint64_t config_hash, const char *path) {
+    ReplayReader *reader = MAKE_NEW(allocator, ReplayReader, allocator);
+    World *world = MAKE_NEW(allocator, World, allocator);
+
+    int status = 1;
+
+    if (replay::open(*reader, path)) {
+        if (reader->header.config_hash != config_hash) {
+            printf("warning: recorded with a different config\n");
+        }
+
+        replay::start(*reader, *world, config);
+
+        // Seek back to a tick between keyframes afterwards.
+        const uint32_t seek_tick = reader->end_tick / 2 + reader->header.keyframe_interval / 3;
+        uint64_t seek_checksum = 0;
+
+        uint32_t keyframes = 0;
+        uint32_t mismatches = 0;
+        uint64_t start = time_now_ns();
+
+        TickInput inputs[PlayerMax];
+        while (true) {
+            if (world->tick == seek_tick) {
+                seek_checksum = world::checksum(*world);
+            }
+
+            if (!replay::next(*reader, inputs)) {
+                break;
+            }
+
+            if (reader->at_keyframe) {
+                if (reader->keyframe_checksum != world::checksum(*world)) {
+                    if (mismatches == 0) {
+                        printf("first mismatch at tick %u\n", world->tick);
+                    }
+                    ++mismatches;
+                }
+                ++keyframes;
+            }
+
+            world::tick(*world, inputs);
+        }
+
+        double played_ms = (time_now_ns() - start) / 1000000.0;
+
+        start = time_now_ns();
+        bool sought = replay::seek(*reader, *world, seek_tick) && world::checksum(*world) == seek_checksum;
+        double seek_ms = (time_now_ns() - start) / 1000000.0;
+
+        printf("ticks: %u, keyframes checked: %u, mismatches: %u, played in %.1fms\n", reader->end_tick, keyframes, mismatches, played_ms);
+        printf("seek to tick %u: %s in %.2fms\n", seek_tick, sought ? "matches" : "differs", seek_ms);
+
+        status = mismatches == 0 && sought && reader->end_tick > 0 ? 0 : 1;
+    }
+
+    MAKE_DELETE(allocator, World, world);
+    MAKE_DELETE(allocator, ReplayReader, reader);
+
+    return status;
+}
+
+// Loads the sprite atlas into a canvas, as the Initializing state does.
+static bool load_atlas(IndexedCanvas &canvas, const ini_t *config) {
+    const char *filename = config_string(config, "canvas", "sprites_filename", nullptr);
+    if (!filename) {
+        log_error("Missing sprites_filename in [canvas]");
+        return false;
+    }
+
+    int w = 0, h = 0, channels = 0;
+    uint8_t *image = stbi_load(filename, &w, &h, &channels, 4);
+    if (!image) {
+        log_error("Could not load %s", filename);
+        return false;
+    }
+
+    indexed_canvas::palettize(image, image, w * h);
+    indexed_canvas::load_sprites(canvas, image, w, h);
+    stbi_image_free(image);
+
+    return true;
+}
+
+// Draws a world as the game presents it, to width * height RGBA pixels.
+static void draw_frame(IndexedCanvas &canvas, const World &world, Hud &hud, uint32_t *rgba) {
+    world_render::draw(canvas, world, hud, false, 0);
+    upscale::expand(canvas.pixels, canvas.width, canvas.height, pico8_palette, 1, rgba, canvas.width);
+}
+
+/**
+ * @brief Plays a replay back and captures a frame every tick, drawn as the game
+ * draws it and scaled to the window's render scale. Waits for the encoder rather
+ * than dropping frames, since nothing is on screen to keep up with.
+ */
+static int capture(Allocator &allocator, const ini_t *config, const char *replay_path, const char *path, uint32_t every) {
+    ReplayReader *reader = MAKE_NEW(allocator, ReplayReader, allocator);
+    World *world = MAKE_NEW(allocator, World, allocator);
+    IndexedCanvas *canvas = MAKE_NEW(allocator, IndexedCanvas, allocator);
+    FrameCapture *frames = MAKE_NEW(allocator, FrameCapture, allocator);
+    StagingBuffers *staging = MAKE_NEW(allocator, StagingBuffers, allocator);
+
+    int status = 1;
+
+    if (replay::open(*reader, replay_path)) {
+        const int32_t width = reader->header.width;
+        const int32_t height = reader->header.height;
+        const int32_t scale = upscale::render_scale(config);
+
+        replay::start(*reader, *world, config);
+        indexed_canvas::init(*canvas, config, width, height);
+        staging_buffers::init(*staging, width, height, scale);
+
+        if (load_atlas(*canvas, config) &&
+            frame_capture::open(*frames, path, frame_capture::format_for(path), width * scale, height * scale, every, true)) {
+            Hud hud;
+            uint64_t present_ns = 0;
+            uint64_t submit_ns = 0;
+            uint64_t start = time_now_ns();
+
+            TickInput inputs[PlayerMax];
+            while (replay::next(*reader, inputs)) {
+                world_render::draw(*canvas, *world, hud, false, 0);
+
+                uint64_t present_start = time_now_ns();
+                const uint32_t *rgba = staging_buffers::present(*staging, canvas->pixels, pico8_palette);
+                uint64_t submit_start = time_now_ns();
+                frame_capture::submit(*frames, (const uint8_t *)rgba);
+                present_ns += submit_start - present_start;
+                submit_ns += time_now_ns() - submit_start;
+
+                world::tick(*world, inputs);
+            }
+
+            uint32_t captured = frames->captured;
+            uint32_t submitted = frames->submitted;
+            frame_capture::close(*frames);
+
+            double total_ms = (time_now_ns() - start) / 1000000.0;
+
+            printf("ticks: %u, frames captured: %u, dropped: %u, in %.1fms\n", reader->end_tick, captured, frames->dropped, total_ms);
+            printf("size: %dx%d, scale %d with the %s kernel: %.2fus per frame\n", width * scale, height * scale, scale, upscale::kernel_name(),
+                   reader->end_tick > 0 ? present_ns / 1000.0 / reader->end_tick : 0.0);
+            printf("submit: %.2fus per frame, including waits for the encoder\n", submitted > 0 ? submit_ns / 1000.0 / submitted : 0.0);
+
+            status = captured > 0 ? 0 : 1;
+        }
+    }
+
+    MAKE_DELETE(allocator, StagingBuffers, staging);
+    MAKE_DELETE(allocator, FrameCapture, frames);
+    MAKE_DELETE(allocator, IndexedCanvas, canvas);
+    MAKE_DELETE(allocator, World, world);
+    MAKE_DELETE(allocator, ReplayReader, reader);
+
+    return status;
+}
+
+// The hashes of a frame in a golden list.
+struct GoldenFrame {
+    uint32_t tick;
+    uint32_t padding;
+    uint64_t frame_hash;
+    uint64_t world_checksum;
+};
+
+/**
+ * @brief A run of bots, and the hashes of its frames every few ticks.
+ *
+ * Stored as text: settings as "name value" lines, then a "tick frame_hash
+ * world_checksum" line per frame. Lines starting with ; are comments.
+ */
+struct GoldenList {
+    GoldenList(Allocator &allocator)
+    : seed(1)
+    , ticks(3600)
+    , every(60)
+    , fixed_point(0)
+    , frames(allocator) {
+    }
+
+    uint32_t seed;
+    uint32_t ticks;
+    uint32_t every;
+    uint32_t fixed_point;
+    Array<GoldenFrame> frames;
+};
+
+static bool read_golden(GoldenList &list, const char *path) {
+    FILE *file = fopen(path, "r");
+    if (!file) {
+        log_error("Could not open golden list %s", path);
+        return false;
+    }
+
+    char line[128];
+    while (fgets(line, sizeof(line), file)) {
+        GoldenFrame frame = {};
+        unsigned long long frame_hash = 0, world_checksum = 0;
+
+        if (line[0] == ';' || line[0] == '\n' || line[0] == '\r') {
+            continue;
+        } else if (sscanf(line, "seed %u", &list.seed) == 1 ||
+                   sscanf(line, "ticks %u", &list.ticks) == 1 ||
+                   sscanf(line, "every %u", &list.every) == 1 ||
+                   sscanf(line, "fixed_point %u", &list.fixed_point) == 1) {
+            continue;
+        } else if (sscanf(line, "%u %llx %llx", &frame.tick, &frame_hash, &world_checksum) == 3) {
+            frame.frame_hash = frame_hash;
+            frame.world_checksum = world_checksum;
+            array::push_back(list.frames, frame);
+        } else {
+            log_error("Could not parse golden list line: %s", line);
+            fclose(file);
+            return false;
+        }
+    }
+
+    fclose(file);
+
+    if (list.every == 0) {
+        log_error("Golden list %s has no frame interval", path);
+        return false;
+    }
+
+    return true;
+}
+
+static bool write_golden(const GoldenList &list, const char *path) {
+    FILE *file = fopen(path, "w");
+    if (!file) {
+        log_error("Could not create golden list %s", path);
+        return false;
+    }
+
+    fprintf(file, "; Frame hashes and world checksums of bots playing, for space_hell_headless --golden.\n");
+    fprintf(file, "; Recorded with space_hell_headless --golden-record. Only a build with the same fixed_point matches.\n");
+    fprintf(file, "seed %u\n", list.seed);
+    fprintf(file, "ticks %u\n", list.ticks);
+    fprintf(file, "every %u\n", list.every);
+    fprintf(file, "fixed_point %u\n", list.fixed_point);
+
+    for (uint32_t i = 0; i < array::size(list.frames); ++i) {
+        const GoldenFrame &frame = list.frames[i];
+        fprintf(file, "%u %016llx %016llx\n", frame.tick, (unsigned long long)frame.frame_hash, (unsigned long long)frame.world_checksum);
+    }
+
+    fclose(file);
+    return true;
+}
+
+// Writes a frame to a PPM image.
+static void dump_frame(Allocator &allocator, const char *path, const uint32_t *rgba, int32_t width, int32_t height) {
+    FrameCapture *dump = MAKE_NEW(allocator, FrameCapture, allocator);
+
+    if (frame_capture::open(*dump, path, CaptureFormat::Ppm, width, height, 1, true)) {
+        frame_capture::submit(*dump, (const uint8_t *)rgba);
+        frame_capture::close(*dump);
+    }
+
+    MAKE_DELETE(allocator, FrameCapture, dump);
+}
+
+/**
+ * @brief Runs bots from a seed through the simulation and the render path, and
+ * hashes the presented frame every few ticks. Records the hashes to a golden
+ * list, or compares them with one and dumps the first frame that differs.
+ *
+ * A frame whose world checksum still matches points at the drawing code rather
+ * than the simulation. The frame is dumped into dump_dir, as golden_<tick>.ppm.
+ */
+static int golden(Allocator &allocator, const ini_t *config, const char *path, const char *dump_dir, bool record) {
+    GoldenList *list = MAKE_NEW(allocator, GoldenList, allocator);
+
+#if defined(FIXED_POINT)
+    const uint32_t fixed_point = 1;
+#else
+    const uint32_t fixed_point = 0;
+#endif
+
+    if (record) {
+        list->fixed_point = fixed_point;
+    } else if (!read_golden(*list, path)) {
+        MAKE_DELETE(allocator, GoldenList, list);
+        return 1;
+    } else if (list->fixed_point != fixed_point) {
+        printf("warning: recorded with fixed_point %u, this build has %u, frames will differ\n", list->fixed_point, fixed_point);
+    }
+
+    World *world = MAKE_NEW(allocator, World, allocator);
+    IndexedCanvas *canvas = MAKE_NEW(allocator, IndexedCanvas, allocator);
+    uint32_t *rgba = (uint32_t *)allocator.allocate(PlayfieldWidth * PlayfieldHeight * 4);
+
+    world::init(*world, config, PlayfieldWidth, PlayfieldHeight, list->seed, PlayerMax);
+    indexed_canvas::init(*canvas, config, PlayfieldWidth, PlayfieldHeight);
+
+    int status = 1;
+
+    if (load_atlas(*canvas, config)) {
+        RandomBot bots[PlayerMax] = {};
+        for (uint32_t i = 0; i < PlayerMax; ++i) {
+            rnd_pcg_seed(&bots[i].random, list->seed + i);
+        }
+
+        Hud hud;
+        uint32_t checked = 0;
+        uint32_t mismatches = 0;
+
+        TickInput inputs[PlayerMax];
+        while (true) {
+            if (world->tick % list->every == 0) {
+                draw_frame(*canvas, *world, hud, rgba);
+
+                GoldenFrame frame = {};
+                frame.tick = world->tick;
+                frame.frame_hash = murmur_hash_64(rgba, PlayfieldWidth * PlayfieldHeight * 4, 0);
+                frame.world_checksum = world::checksum(*world);
+
+                if (record) {
+                    array::push_back(list->frames, frame);
+                } else if (checked < array::size(list->frames)) {
+                    const GoldenFrame &expected = list->frames[checked];
+
+                    if (expected.tick != frame.tick || expected.frame_hash != frame.frame_hash) {
+                        if (mismatches == 0) {
+                            char dump_path[512];
+                            snprintf(dump_path, sizeof(dump_path), "%s/golden_%u.ppm", dump_dir, frame.tick);
+                            dump_frame(allocator, dump_path, rgba, PlayfieldWidth, PlayfieldHeight);
+
+                            printf("first divergent frame at tick %u, after tick %u matched\n", frame.tick, frame.tick >= list->every ? frame.tick - list->every : 0);
+                            printf("frame %016llx, expected %016llx\n", (unsigned long long)frame.frame_hash, (unsigned long long)expected.frame_hash);
+                            printf("world %016llx, expected %016llx, %s\n", (unsigned long long)frame.world_checksum, (unsigned long long)expected.world_checksum,
+                                   frame.world_checksum == expected.world_checksum ? "the simulation matches, the drawing differs" : "the simulation differs");
+                            printf("dumped the frame to %s\n", dump_path);
+                        }
+                        ++mismatches;
+                    }
+                    ++checked;
+                }
+            }
+
+            if (world->tick == list->ticks) {
+                break;
+            }
+
+            for (uint32_t i = 0; i < PlayerMax; ++i) {
+                inputs[i] = random_input(bots[i]);
+            }
+            world::tick(*world, inputs);
+        }
+
+        if (record) {
+            if (write_golden(*list, path)) {
+                printf("recorded %u frames over %u ticks to %s\n", array::size(list->frames), list->ticks, path);
+                status = 0;
+            }
+        } else {
+            printf("frames checked: %u of %u, mismatches: %u\n", checked, array::size(list->frames), mismatches);
+            status = mismatches == 0 && checked == array::size(list->frames) && checked > 0 ? 0 : 1;
+        }
+    }
+
+    allocator.deallocate(rgba);
+    MAKE_DELETE(allocator, IndexedCanvas, canvas);
+    MAKE_DELETE(allocator, World, world);
+    MAKE_DELETE(allocator, GoldenList, list);
+
+    return status;
+}
+
+/**
+ * @brief Runs bots through the simulation, the rollback snapshots and the render
+ * path with each subsystem on a tracking allocator. Fails if a frame allocates
+ * once the game has settled.
+ */
+static int alloc_check(Allocator &allocator, const ini_t *config, uint32_t ticks) {
+    MemoryTracker *memory = MAKE_NEW(allocator, MemoryTracker, allocator);
+    memory_tracker::set_budgets(*memory, config);
+
+    Allocator &world_allocator = memory_tracker::allocator(*memory, MemoryTag::World);
+    Allocator &canvas_allocator = memory_tracker::allocator(*memory, MemoryTag::Canvas);
+    Allocator &net_allocator = memory_tracker::allocator(*memory, MemoryTag::Net);
+
+    int status = 1;
+
+    {
+        World world(world_allocator);
+        IndexedCanvas canvas(canvas_allocator);
+        Rollback rollback(net_allocator);
+        uint32_t *rgba = (uint32_t *)canvas_allocator.allocate(PlayfieldWidth * PlayfieldHeight * 4);
+
+        world::init(world, config, PlayfieldWidth, PlayfieldHeight, 1, PlayerMax);
+        rollback::init(rollback, world.bullets.max_capacity);
+        indexed_canvas::init(canvas, config, PlayfieldWidth, PlayfieldHeight);
+
+        if (load_atlas(canvas, config)) {
+            RandomBot bots[PlayerMax] = {};
+            for (uint32_t i = 0; i < PlayerMax; ++i) {
+                rnd_pcg_seed(&bots[i].random, i + 1);
+            }
+
+            Hud hud;
+            memory_tracker::end_frame(*memory, false);
+
+            TickInput inputs[PlayerMax];
+            while (world.tick < ticks) {
+                for (uint32_t i = 0; i < PlayerMax; ++i) {
+                    inputs[i] = random_input(bots[i]);
+                }
+
+                rollback::advance(rollback, world, inputs);
+                draw_frame(canvas, world, hud, rgba);
+
+                memory_tracker::end_frame(*memory, world.tick > SteadyStateTicks);
+            }
+
+            for (const TrackingAllocator &a : memory->allocators) {
+                printf("%-8s allocations: %5u, live: %4u, %8.1f KB, peak %8.1f KB, budget %6.0f KB%s\n", a.name, a.allocations, a.allocations - a.deallocations,
+                       a.bytes / 1024.0, a.peak / 1024.0, a.budget / 1024.0, a.over_budget ? ", over" : "");
+            }
+            printf("ticks: %u, steady frames allocating: %u\n", ticks, memory->steady_frames_allocating);
+
+            status = memory->steady_frames_allocating == 0 ? 0 : 1;
+        }
+
+        canvas_allocator.deallocate(rgba);
+    }
+
+    MAKE_DELETE(allocator, MemoryTracker, memory);
+
+    return status;
+}
+
+/**
+ * @brief Plays a world with a bot for a long time, drawing every tick, and
+ * reports the tick and draw times and the memory of each game minute, to catch
+ * the growth and drift that a few minutes of replay don't show.
+ */
+static int bot_soak(Allocator &allocator, const ini_t *config, float skill, uint32_t minutes, uint32_t seed) {
+    MemoryTracker *memory = MAKE_NEW(allocator, MemoryTracker, allocator);
+    memory_tracker::set_budgets(*memory, config);
+
+    Allocator &world_allocator = memory_tracker::allocator(*memory, MemoryTag::World);
+    Allocator &canvas_allocator = memory_tracker::allocator(*memory, MemoryTag::Canvas);
+
+    const uint32_t minute_ticks = 60 * TickRate;
+    int status = 1;
+
+    {
+        World world(world_allocator);
+        IndexedCanvas canvas(canvas_allocator);
+        uint32_t *rgba = (uint32_t *)canvas_allocator.allocate(PlayfieldWidth * PlayfieldHeight * 4);
+
+        world::init(world, config, PlayfieldWidth, PlayfieldHeight, seed, 1);
+        indexed_canvas::init(canvas, config, PlayfieldWidth, PlayfieldHeight);
+
+        if (load_atlas(canvas, config)) {
+            Bot bot;
+            bot::init(bot, 0, skill, seed);
+
+            Hud hud;
+            memory_tracker::end_frame(*memory, false);
+
+            double first_tick_ns = 0.0;
+            double last_tick_ns = 0.0;
+            uint32_t first_live = 0;
+            uint32_t live = 0;
+            int32_t hits = 0;
+
+            printf("minute  tick us  worst us  draw us  score  hits  bullets  live KB  allocations\n");
+
+            for (uint32_t minute = 1; minute <= minutes; ++minute) {
+                uint64_t tick_ns = 0;
+                uint64_t worst_ns = 0;
+                uint64_t draw_ns = 0;
+                uint32_t allocations = 0;
+
+                for (uint32_t i = 0; i < minute_ticks; ++i) {
+                    TickInput input = bot::think(bot, world);
+
+                    uint64_t start = time_now_ns();
+                    world::tick(world, &input);
+                    uint64_t ticked = time_now_ns();
+                    draw_frame(canvas, world, hud, rgba);
+                    uint64_t drawn = time_now_ns();
+
+                    tick_ns += ticked - start;
+                    worst_ns = ticked - start > worst_ns ? ticked - start : worst_ns;
+                    draw_ns += drawn - ticked;
+
+                    allocations += memory_tracker::end_frame(*memory, world.tick > SteadyStateTicks);
+                }
+
+                live = 0;
+                for (const TrackingAllocator &a : memory->allocators) {
+                    live += a.bytes;
+                }
+
+                last_tick_ns = (double)tick_ns / minute_ticks;
+                if (minute == 1) {
+                    first_tick_ns = last_tick_ns;
+                    first_live = live;
+                }
+
+                printf("%6u  %7.2f  %8.2f  %7.2f  %5d  %4d  %7u  %7.1f  %11u\n", minute, last_tick_ns / 1000.0, worst_ns / 1000.0,
+                       (double)draw_ns / minute_ticks / 1000.0, world.players[0].score, world.players[0].hits - hits, world.bullets.count,
+                       live / 1024.0, allocations);
+
+                hits = world.players[0].hits;
+                fflush(stdout);
+            }
+
+            printf("skill %.2f, decisions %u, mistakes %u, score %d, hits %d\n", (double)bot.skill, bot.decisions, bot.mistakes, world.players[0].score,
+                   world.players[0].hits);
+            printf("tick time drift: %.2fx, live memory growth since the first minute: %d bytes, steady frames allocating: %u\n",
+                   first_tick_ns > 0.0 ? last_tick_ns / first_tick_ns : 0.0, (int32_t)(live - first_live), memory->steady_frames_allocating);
+
+            status = memory->steady_frames_allocating == 0 && live <= first_live ? 0 : 1;
+        }
+
+        canvas_allocator.deallocate(rgba);
+    }
+
+    MAKE_DELETE(allocator, MemoryTracker, memory);
+
+    return status;
+}
+
+/**
+ * @brief Keeps a particle pool full and times updating and drawing it each frame,
+ * against the 1 ms a frame can spare for effects.
+ *
+ * Every frame has to fit, so it fails on the 99th percentile frame rather than
+ * the mean. The first frames are left out, as they fault the pool's pages in.
+ * The worst frame is printed but not held to the budget: on a busy or virtual
+ * machine it is the one the thread was descheduled in, while it spent no more
+ * time running than any other.
+ */
+static int bench_particles(Allocator &allocator, const ini_t *config, uint32_t count, uint32_t frames) {
+    const double BudgetNs = 1000000.0;
+    const uint32_t WarmupFrames = 10;
+    const float dt = 1.0f / 60.0f;
+
+    if (frames <= WarmupFrames) {
+        log_error("The particle bench needs more than %u frames, the first %u only warm up", WarmupFrames, WarmupFrames);
+        return 1;
+    }
+
+    IndexedCanvas *canvas = MAKE_NEW(allocator, IndexedCanvas, allocator);
+    ParticlePool *pool = MAKE_NEW(allocator, ParticlePool, allocator);
+
+    indexed_canvas::init(*canvas, config, PlayfieldWidth, PlayfieldHeight);
+    particles::init(*pool, count, 1);
+
+    rnd_pcg_t random;
+    rnd_pcg_seed(&random, 1);
+
+    const uint32_t timed = frames - WarmupFrames;
+    uint64_t *frame_ns = (uint64_t *)allocator.allocate(timed * sizeof(uint64_t), alignof(uint64_t));
+    uint64_t update_ns = 0;
+    uint64_t draw_ns = 0;
+    uint64_t drawn = 0;
+
+    for (uint32_t frame = 0; frame < frames; ++frame) {
+        // Top the pool up with bursts all over the canvas, as many as died last frame.
+        while (pool->count < pool->capacity) {
+            ParticleEffect effect = rnd_pcg_range(&random, 0, 1) == 0 ? ParticleEffect::Pickup : ParticleEffect::Hit;
+            particles::burst(*pool, effect, rnd_pcg_nextf(&random) * PlayfieldWidth, rnd_pcg_nextf(&random) * PlayfieldHeight, 32);
+        }
+
+        uint64_t start = time_now_ns();
+        particles::update(*pool, dt, PlayfieldWidth, PlayfieldHeight);
+        uint64_t updated = time_now_ns();
+        particles::draw(*pool, *canvas, false, frame);
+        uint64_t end = time_now_ns();
+
+        if (frame >= WarmupFrames) {
+            update_ns += updated - start;
+            draw_ns += end - updated;
+            frame_ns[frame - WarmupFrames] = end - start;
+            drawn += pool->count;
+        }
+    }
+
+    std::sort(frame_ns, frame_ns + timed);
+
+    double update_mean = (double)update_ns / timed;
+    double draw_mean = (double)draw_ns / timed;
+    double p99 = (double)frame_ns[timed - 1 - timed / 100];
+    double worst = (double)frame_ns[timed - 1];
+
+    printf("particles: %u, frames: %u after %u to warm up, drawn per frame: %.0f\n", count, timed, WarmupFrames, (double)drawn / timed);
+    printf("update: %.3fms, draw: %.3fms, total: %.3fms, p99: %.3fms, worst: %.3fms, budget: %.3fms\n", update_mean / 1000000.0,
+           draw_mean / 1000000.0, (update_mean + draw_mean) / 1000000.0, p99 / 1000000.0, worst / 1000000.0, BudgetNs / 1000000.0);
+
+    allocator.deallocate(frame_ns);
+    MAKE_DELETE(allocator, ParticlePool, pool);
+    MAKE_DELETE(allocator, IndexedCanvas, canvas);
+
+    return p99 <= BudgetNs ? 0 : 1;
+}
+
+/**
+ * @brief Checks every kernel the CPU runs against the scalar one at each scale,
+ * on canvases whose width leaves a tail for the scalar loop, and times them.
+ */
+static int bench_upscale(Allocator &allocator, uint32_t frames) {
+    const int32_t widths[] = {PlayfieldWidth, PlayfieldWidth + 13};
+    const int32_t height = PlayfieldHeight;
+    const int32_t max_width = PlayfieldWidth + 13;
+    const int32_t padding = 7;
+
+    uint32_t size = (uint32_t)((max_width * MaxUpscale + padding) * height * MaxUpscale) * sizeof(uint32_t);
+    uint8_t *indices = (uint8_t *)allocator.allocate((uint32_t)(max_width * height));
+    uint32_t *expected = (uint32_t *)allocator.allocate(size, 32);
+    uint32_t *actual = (uint32_t *)allocator.allocate(size, 32);
+
+    // Random indices with the high nibble set too, which every kernel has to ignore.
+    rnd_pcg_t random;
+    rnd_pcg_seed(&random, 1);
+    for (int32_t i = 0; i < max_width * height; ++i) {
+        indices[i] = (uint8_t)rnd_pcg_range(&random, 0, 255);
+    }
+
+    uint32_t mismatches = 0;
+
+    for (int kernel = 0; kernel < (int)UpscaleKernel::COUNT; ++kernel) {
+        if (!upscale::supported((UpscaleKernel)kernel)) {
+            printf("%-6s not supported\n", upscale::kernel_name((UpscaleKernel)kernel));
+            continue;
+        }
+
+        printf("%-6s", upscale::kernel_name((UpscaleKernel)kernel));
+
+        for (int32_t scale = 1; scale <= MaxUpscale; ++scale) {
+            // Against the scalar kernel, with a stride wider than the rows so nothing writes past them.
+            for (int32_t width : widths) {
+                const int32_t stride = width * scale + padding;
+                const uint32_t pixels = (uint32_t)(stride * height * scale);
+                memset(expected, 0xcd, pixels * sizeof(uint32_t));
+                memset(actual, 0xcd, pixels * sizeof(uint32_t));
+
+                upscale::expand_with(UpscaleKernel::Scalar, indices, width, height, pico8_palette, scale, expected, stride);
+                upscale::expand_with((UpscaleKernel)kernel, indices, width, height, pico8_palette, scale, actual, stride);
+
+                if (memcmp(expected, actual, pixels * sizeof(uint32_t)) != 0) {
+                    printf(" [scale %d, width %d differs]", scale, width);
+                    ++mismatches;
+                }
+            }
+
+            const int32_t width = PlayfieldWidth;
+            uint64_t start = time_now_ns();
+            for (uint32_t frame = 0; frame < frames; ++frame) {
+                upscale::expand_with((UpscaleKernel)kernel, indices, width, height, pico8_palette, scale, actual, width * scale);
+            }
+            printf(" %dx: %.1fus", scale, (time_now_ns() - start) / 1000.0 / frames);
+        }
+
+        printf("\n");
+    }
+
+    printf("%dx%d canvas, %u frames, expand uses %s, mismatches: %u\n", PlayfieldWidth, PlayfieldHeight, frames, upscale::kernel_name(), mismatches);
+
+    allocator.deallocate(actual);
+    allocator.deallocate(expected);
+    allocator.deallocate(indices);
+
+    return mismatches == 0 ? 0 : 1;
+}
+
+// The generators of rnd.h behind one interface, so the checks of the range functions run on each.
+struct PcgGenerator {
+    rnd_pcg_t state;
+    static constexpr const char *name = "pcg";
+    void seed(uint32_t seed) { rnd_pcg_seed(&state, seed); }
+    float nextf() { return rnd_pcg_nextf(&state); }
+    RND_U32 next() { return rnd_pcg_next(&state); }
+    int range(int min, int max) { return rnd_pcg_range(&state, min, max); }
+    void fill(RND_U32 *out, int count) { rnd_pcg_fill_u32(&state, out, count); }
+    void fill_range(int *out, int count, int min, int max) { rnd_pcg_fill_range(&state, out, count, min, max); }
+};
+
+struct WellGenerator {
+    rnd_well_t state;
+    static constexpr const char *name = "well";
+    void seed(uint32_t seed) { rnd_well_seed(&state, seed); }
+    float nextf() { return rnd_well_nextf(&state); }
+    RND_U32 next() { return rnd_well_next(&state); }
+    int range(int min, int max) { return rnd_well_range(&state, min, max); }
+    void fill(RND_U32 *out, int count) { rnd_well_fill_u32(&state, out, count); }
+    void fill_range(int *out, int count, int min, int max) { rnd_well_fill_range(&state, out, count, min, max); }
+};
+
+struct GamerandGenerator {
+    rnd_gamerand_t state;
+    static constexpr const char *name = "gamerand";
+    void seed(uint32_t seed) { rnd_gamerand_seed(&state, seed); }
+    float nextf() { return rnd_gamerand_nextf(&state); }
+    RND_U32 next() { return rnd_gamerand_next(&state); }
+    int range(int min, int max) { return rnd_gamerand_range(&state, min, max); }
+    void fill(RND_U32 *out, int count) { rnd_gamerand_fill_u32(&state, out, count); }
+    void fill_range(int *out, int count, int min, int max) { rnd_gamerand_fill_range(&state, out, count, min, max); }
+};
+
+struct XorshiftGenerator {
+    rnd_xorshift_t state;
+    static constexpr const char *name = "xorshift";
+    void seed(uint32_t seed) { rnd_xorshift_seed(&state, seed); }
+    float nextf() { return rnd_xorshift_nextf(&state); }
+    RND_U64 next() { return rnd_xorshift_next(&state); }
+    int range(int min, int max) { return rnd_xorshift_range(&state, min, max); }
+    void fill(RND_U64 *out, int count) { rnd_xorshift_fill_u64(&state, out, count); }
+    void fill_range(int *out, int count, int min, int max) { rnd_xorshift_fill_range(&state, out, count, min, max); }
+};
+
+// A range the uniformity check draws from. Wide ranges are counted in bins of equal size.
+struct RndRange {
+    int min;
+    int max;
+    uint32_t bins;
+};
+
+static const RndRange rnd_ranges[] = {
+    {1, 6, 6},
+    {0, 99, 100},
+    {-500, 499, 1000},
+    // 3 * 2^30 values, in 48 bins of 2^26: the widest non power of two, where the float path was biased.
+    {INT32_MIN, 0x3fffffff, 48},
+    // Every int, in 64 bins of 2^26.
+    {INT32_MIN, INT32_MAX, 64},
+};
+
+// The chi-square a uniform generator stays under 999 times in 1000, by the Wilson-Hilferty approximation.
+static double chi_square_limit(uint32_t degrees) {
+    const double z = 3.090;
+    double k = 2.0 / (9.0 * degrees);
+    double root = 1.0 - k + z * sqrt(k);
+    return degrees * root * root * root;
+}
+
+// Checks the range function of a generator is uniform over each of the ranges, returning the ranges that fail.
+template <typename G>
+static uint32_t check_uniform(uint32_t draws, uint32_t seed) {
+    uint32_t failed = 0;
+    uint64_t counts[1000];
+
+    for (const RndRange &range : rnd_ranges) {
+        const uint64_t size = (uint64_t)((int64_t)range.max - range.min + 1);
+        const uint64_t bin_size = size / range.bins;
+
+        G generator;
+        generator.seed(seed);
+        memset(counts, 0, sizeof(counts));
+
+        for (uint32_t i = 0; i < draws; ++i) {
+            int value = generator.range(range.min, range.max);
+            ++counts[(uint64_t)((int64_t)value - range.min) / bin_size];
+        }
+
+        double expected = (double)draws / range.bins;
+        double chi_square = 0.0;
+        for (uint32_t bin = 0; bin < range.bins; ++bin) {
+            double difference = (double)counts[bin] - expected;
+            chi_square += difference * difference / expected;
+        }
+
+        double limit = chi_square_limit(range.bins - 1);
+        bool ok = chi_square < limit;
+        failed += ok ? 0 : 1;
+
+        printf("%-9s [%d, %d]: chi-square %.1f, limit %.1f for %u degrees of freedom%s\n", G::name, range.min, range.max, chi_square,
+               limit, range.bins - 1, ok ? "" : ", FAILED");
+    }
+
+    return failed;
+}
+
+// Times the float normalized mapping the range functions used to make, the range function and the fill, in ns per value.
+template <typename G>
+static void time_range(uint32_t draws, int min, int max) {
+    const int Batch = 256;
+    int values[Batch];
+    int64_t sum = 0;
+    G generator;
+
+    generator.seed(1);
+    const float range = (float)(max - min + 1);
+    uint64_t start = time_now_ns();
+    for (uint32_t i = 0; i < draws; ++i) {
+        sum += min + (int)(generator.nextf() * range);
+    }
+    uint64_t float_ns = time_now_ns() - start;
+
+    generator.seed(1);
+    start = time_now_ns();
+    for (uint32_t i = 0; i < draws; ++i) {
+        sum += generator.range(min, max);
+    }
+    uint64_t range_ns = time_now_ns() - start;
+
+    generator.seed(1);
+    start = time_now_ns();
+    for (uint32_t i = 0; i < draws; i += Batch) {
+        generator.fill_range(values, Batch, min, max);
+        sum += values[Batch - 1];
+    }
+    uint64_t fill_ns = time_now_ns() - start;
+
+    printf("%-9s [%d, %d]: float %.2fns, range %.2fns, fill %.2fns per value (%lld)\n", G::name, min, max, (double)float_ns / draws,
+           (double)range_ns / draws, (double)fill_ns / draws, (long long)sum);
+}
+
+// Times the single value function against the fill of the same values, in ns per value.
+template <typename G, typename T>
+static void time_fill(uint32_t draws) {
+    const int Batch = 256;
+    T values[Batch];
+    uint64_t sum = 0;
+    G generator;
+
+    generator.seed(1);
+    uint64_t start = time_now_ns();
+    for (uint32_t i = 0; i < draws; ++i) {
+        sum += generator.next();
+    }
+    uint64_t next_ns = time_now_ns() - start;
+
+    generator.seed(1);
+    start = time_now_ns();
+    for (uint32_t i = 0; i < draws; i += Batch) {
+        generator.fill(values, Batch);
+        sum += values[Batch - 1];
+    }
+    uint64_t fill_ns = time_now_ns() - start;
+
+    printf("%-9s next %.2fns, fill %.2fns per value (%llu)\n", G::name, (double)next_ns / draws, (double)fill_ns / draws, (unsigned long long)sum);
+}
+
+/**
+ * @brief Checks the range functions of each generator for uniformity with a chi-square test,
+ * and times them against the float normalized mapping they replaced, and the fills against the
+ * single value functions.
+ */
+static int bench_rnd(uint32_t draws, uint32_t seed) {
+    uint32_t failed = check_uniform<PcgGenerator>(draws, seed) + check_uniform<WellGenerator>(draws, seed) +
+                      check_uniform<GamerandGenerator>(draws, seed) + check_uniform<XorshiftGenerator>(draws, seed);
+
+    time_range<PcgGenerator>(draws, 1, 6);
+    time_range<WellGenerator>(draws, 1, 6);
+    time_range<GamerandGenerator>(draws, 1, 6);
+    time_range<XorshiftGenerator>(draws, 1, 6);
+    time_range<PcgGenerator>(draws, 0, 999999);
+
+    time_fill<PcgGenerator, RND_U32>(draws);
+    time_fill<WellGenerator, RND_U32>(draws);
+    time_fill<GamerandGenerator, RND_U32>(draws);
+    time_fill<XorshiftGenerator, RND_U64>(draws);
+
+    printf("draws: %u, seed: %u, ranges failed: %u\n", draws, seed, failed);
+
+    return failed == 0 ? 0 : 1;
+}
+
+/**
+ * @brief Queues a full timeline of repeating spawns and starts them tick by tick,
+ * checking they start in order and timing the heap against scanning every spawn each tick.
+ */
+static int bench_waves(uint32_t spawns, uint32_t ticks) {
+    spawns = spawns < SpawnMax ? spawns : SpawnMax;
+
+    rnd_pcg_t random;
+    rnd_pcg_seed(&random, 1);
+
+    Spawn timeline[SpawnMax];
+    SpawnHeap heap;
+    heap.count = 0;
+
+    for (uint32_t i = 0; i < spawns; ++i) {
+        Spawn &spawn = timeline[i];
+        spawn = Spawn();
+        spawn.tick = (uint32_t)rnd_pcg_range(&random, 0, 600);
+        spawn.order = i;
+        spawn.repeat = (uint32_t)rnd_pcg_range(&random, 0, 3) == 0 ? 0 : (uint32_t)rnd_pcg_range(&random, 30, 1200);
+        waves::push(heap, spawn);
+    }
+
+    // Pop every due spawn, queueing the repeating ones again.
+    uint64_t heap_started = 0;
+    uint32_t out_of_order = 0;
+    uint64_t start = time_now_ns();
+
+    for (uint32_t tick = 0; tick < ticks; ++tick) {
+        uint32_t last_order = 0;
+        bool first = true;
+
+        while (heap.count > 0 && heap.items[0].tick <= tick) {
+            Spawn spawn = waves::pop(heap);
+            out_of_order += spawn.tick != tick || (!first && spawn.order < last_order) ? 1 : 0;
+            last_order = spawn.order;
+            first = false;
+            ++heap_started;
+
+            if (spawn.repeat > 0) {
+                spawn.tick += spawn.repeat;
+                waves::push(heap, spawn);
+            }
+        }
+    }
+
+    uint64_t heap_ns = time_now_ns() - start;
+
+    // The same timeline, looking at every spawn every tick.
+    uint64_t scan_started = 0;
+    start = time_now_ns();
+
+    for (uint32_t tick = 0; tick < ticks; ++tick) {
+        for (uint32_t i = 0; i < spawns; ++i) {
+            Spawn &spawn = timeline[i];
+            if (spawn.tick == tick) {
+                ++scan_started;
+                spawn.tick += spawn.repeat;
+            }
+        }
+    }
+
+    uint64_t scan_ns = time_now_ns() - start;
+
+    printf("spawns: %u, ticks: %u, started: %llu\n", spawns, ticks, (unsigned long long)heap_started);
+    printf("heap: %.1fns per tick, scan: %.1fns per tick, out of order: %u\n", (double)heap_ns / ticks, (double)scan_ns / ticks, out_of_order);
+
+    return out_of_order == 0 && heap_started == scan_started ? 0 : 1;
+}
+
+// The gameplay parameters a tuning sweep varies, in the order of the CSV's columns.
+enum class TuneParameter : uint8_t {
+    BulletRate,
+    BulletSpeed,
+    RotSpeed,
+    MaxSpeed,
+    Drag,
+    COUNT,
+};
+
+// The section of each parameter in a sweep file, indexed by TuneParameter.
+static const char *tune_parameter_names[(int)TuneParameter::COUNT] = {"bullet_rate", "bullet_speed", "rot_speed", "max_speed", "drag"};
+
+// The values a sweep tries for one parameter, steps of them evenly from min to max.
+struct TuneAxis {
+    float min;
+    float max;
+    uint32_t steps;
+};
+
+/**
+ * @brief A grid of gameplay parameters, and the sessions played at every point of it.
+ *
+ * A session plays one player until it is first hit or runs out of ticks. The
+ * sessions of a point are seeded seed, seed + 1 and so on, the same at every
+ * point, so points differ by their parameters rather than their luck.
+ */
+struct TuneSweep {
+    TuneAxis axes[(int)TuneParameter::COUNT];
+    uint32_t points;
+    uint32_t sessions;
+    uint32_t ticks;
+    uint32_t seed;
+    uint32_t threads;
+
+    // The skill of the bot playing the sessions, negative for random buttons.
+    float skill;
+};
+
+// The survival and score of the sessions at one point of a sweep, in ticks and food eaten.
+struct TuneResult {
+    float values[(int)TuneParameter::COUNT];
+    float survival_mean;
+    uint32_t survival_p10;
+    uint32_t survival_p50;
+    uint32_t survival_p90;
+
+    // The fraction of sessions that were never hit.
+    float survived;
+
+    float score_mean;
+    int32_t score_p10;
+    int32_t score_p50;
+    int32_t score_p90;
+};
+
+// A thread of a sweep with its own world, so sessions share nothing but the next point to play.
+struct TuneWorker {
+    TuneWorker(Allocator &allocator)
+    : world(allocator)
+    , initial(allocator)
+    , waves()
+    , survival(nullptr)
+    , score(nullptr)
+    , thread() {
+    }
+
+    World world;
+
+    // The world before its first tick, restored for every session.
+    WorldSnapshot initial;
+
+    // The kinds of enemy as loaded, which each point scales.
+    WaveTable waves;
+
+    // The results of the point being played, one per session.
+    uint32_t *survival;
+    int32_t *score;
+
+    std::thread thread;
+};
+
+static bool read_sweep(TuneSweep &sweep, const char *path) {
+    uint64_t hash;
+    ini_t *ini = load_config(path, hash);
+
+    const Player player;
+    const Enemy enemy;
+    const float defaults[(int)TuneParameter::COUNT] = {(float)enemy.bullet_rate, (float)enemy.bullet_speed, (float)enemy.rot_speed,
+                                                       (float)player.max_speed, (float)player.drag};
+
+    sweep.points = 1;
+    for (int i = 0; i < (int)TuneParameter::COUNT; ++i) {
+        TuneAxis &axis = sweep.axes[i];
+        axis.min = config_float(ini, tune_parameter_names[i], "min", defaults[i]);
+        axis.max = config_float(ini, tune_parameter_names[i], "max", axis.min);
+        axis.steps = (uint32_t)config_int(ini, tune_parameter_names[i], "steps", 1);
+        axis.steps = axis.steps > 0 ? axis.steps : 1;
+        sweep.points *= axis.steps;
+    }
+
+    sweep.sessions = (uint32_t)config_int(ini, "tune", "sessions", 1000);
+    sweep.ticks = (uint32_t)config_int(ini, "tune", "ticks", 60 * TickRate);
+    sweep.seed = (uint32_t)config_int(ini, "tune", "seed", 1);
+    sweep.threads = (uint32_t)config_int(ini, "tune", "threads", 0);
+    sweep.skill = config_float(ini, "tune", "skill", -1.0f);
+
+    if (sweep.threads == 0) {
+        sweep.threads = std::thread::hardware_concurrency() > 0 ? std::thread::hardware_concurrency() : 1;
+    }
+
+    ini_destroy(ini);
+
+    return sweep.sessions > 0 && sweep.ticks > 0;
+}
+
+// Plays every session of a point and sums them up.
+static void play_point(const TuneSweep &sweep, TuneWorker &worker, uint32_t point, TuneResult &result) {
+    World &world = worker.world;
+
+    // The point's step along each axis, the first axis changing slowest.
+    uint32_t rest = point;
+    for (int i = (int)TuneParameter::COUNT - 1; i >= 0; --i) {
+        const TuneAxis &axis = sweep.axes[i];
+        uint32_t step = rest % axis.steps;
+        rest /= axis.steps;
+        result.values[i] = axis.steps > 1 ? axis.min + (axis.max - axis.min) * (float)step / (float)(axis.steps - 1) : axis.min;
+    }
+
+    uint64_t survival_sum = 0;
+    int64_t score_sum = 0;
+    uint32_t survived = 0;
+
+    for (uint32_t s = 0; s < sweep.sessions; ++s) {
+        const uint32_t seed = sweep.seed + s;
+
+        world::restore(world, worker.initial);
+        rnd_pcg_seed(&world.random, seed);
+
+        // The point sets the first kind of enemy, the one the game opens with, and scales the rest to match.
+        const EnemyType &first = worker.waves.types[0];
+        auto scale = [&result](TuneParameter parameter, Real first_value, Real value) {
+            const float point = result.values[(int)parameter];
+            return first_value != Real(0.0f) ? Real(point * (float)value / (float)first_value) : Real(point);
+        };
+
+        for (uint32_t t = 0; t < worker.waves.type_count; ++t) {
+            const EnemyType &type = worker.waves.types[t];
+            world.waves.types[t].bullet_rate = scale(TuneParameter::BulletRate, first.bullet_rate, type.bullet_rate);
+            world.waves.types[t].bullet_speed = scale(TuneParameter::BulletSpeed, first.bullet_speed, type.bullet_speed);
+            world.waves.types[t].rot_speed = scale(TuneParameter::RotSpeed, first.rot_speed, type.rot_speed);
+        }
+
+        Player &player = world.players[0];
+        player.max_speed = result.values[(int)TuneParameter::MaxSpeed];
+        player.drag = result.values[(int)TuneParameter::Drag];
+
+        Bot bot;
+        RandomBot random_bot = {};
+        bot::init(bot, 0, sweep.skill, seed);
+        rnd_pcg_seed(&random_bot.random, seed);
+
+        while (world.tick < sweep.ticks && player.hits == 0) {
+            TickInput input = sweep.skill >= 0.0f ? bot::think(bot, world) : random_input(random_bot);
+            world::tick(world, &input);
+        }
+
+        worker.survival[s] = world.tick;
+        worker.score[s] = player.score;
+        survival_sum += world.tick;
+        score_sum += player.score;
+        survived += player.hits == 0 ? 1 : 0;
+    }
+
+    std::sort(worker.survival, worker.survival + sweep.sessions);
+    std::sort(worker.score, worker.score + sweep.sessions);
+
+    const uint32_t p10 = sweep.sessions / 10;
+    const uint32_t p50 = sweep.sessions / 2;
+    const uint32_t p90 = sweep.sessions - 1 - sweep.sessions / 10;
+
+    result.survival_mean = (float)((double)survival_sum / sweep.sessions);
+    result.survival_p10 = worker.survival[p10];
+    result.survival_p50 = worker.survival[p50];
+    result.survival_p90 = worker.survival[p90];
+    result.survived = (float)survived / (float)sweep.sessions;
+    result.score_mean = (float)((double)score_sum / sweep.sessions);
+    result.score_p10 = worker.score[p10];
+    result.score_p50 = worker.score[p50];
+    result.score_p90 = worker.score[p90];
+}
+
+// A sweep thread. Takes the next point until none are left.
+static void run_tune_worker(const TuneSweep *sweep, TuneWorker *worker, std::atomic<uint32_t> *next_point, TuneResult *results) {
+    while (true) {
+        uint32_t point = next_point->fetch_add(1, std::memory_order_relaxed);
+        if (point >= sweep->points) {
+            break;
+        }
+
+        play_point(*sweep, *worker, point, results[point]);
+    }
+}
+
+/**
+ * @brief Plays the sessions of every point of a sweep of gameplay parameters
+ * on parallel threads, and writes their survival and score distributions as CSV.
+ *
+ * The workers are set up before they start, so sweeping doesn't allocate and
+ * the threads share nothing but a counter of the points taken.
+ */
+static int tune(Allocator &allocator, const ini_t *config, const char *sweep_path, const char *csv_path) {
+    TuneSweep sweep;
+    if (!read_sweep(sweep, sweep_path)) {
+        log_error("Sweep %s needs sessions and ticks", sweep_path);
+        return 1;
+    }
+
+    FILE *csv = csv_path ? fopen(csv_path, "wb") : stdout;
+    if (!csv) {
+        log_error("Could not create %s", csv_path);
+        return 1;
+    }
+
+    TuneResult *results = (TuneResult *)allocator.allocate(sweep.points * sizeof(TuneResult), alignof(TuneResult));
+    TuneWorker **workers = (TuneWorker **)allocator.allocate(sweep.threads * sizeof(TuneWorker *), alignof(TuneWorker *));
+
+    for (uint32_t i = 0; i < sweep.threads; ++i) {
+        TuneWorker *worker = MAKE_NEW(allocator, TuneWorker, allocator);
+        world::init(worker->world, config, PlayfieldWidth, PlayfieldHeight, sweep.seed, 1);
+
+        // At its largest from the start, so a pool set to grow never allocates on a worker thread.
+        BulletPool &pool = worker->world.bullets;
+        bullet_pool::init(pool, pool.max_capacity, pool.max_capacity, pool.overflow);
+
+        world::save(worker->world, worker->initial);
+        worker->waves = worker->world.waves;
+        worker->survival = (uint32_t *)allocator.allocate(sweep.sessions * sizeof(uint32_t), alignof(uint32_t));
+        worker->score = (int32_t *)allocator.allocate(sweep.sessions * sizeof(int32_t), alignof(int32_t));
+        workers[i] = worker;
+    }
+
+    std::atomic<uint32_t> next_point(0);
+    uint64_t start = time_now_ns();
+
+    for (uint32_t i = 0; i < sweep.threads; ++i) {
+        workers[i]->thread = std::thread(run_tune_worker, &sweep, workers[i], &next_point, results);
+    }
+
+    for (uint32_t i = 0; i < sweep.threads; ++i) {
+        workers[i]->thread.join();
+    }
+
+    double seconds = (double)(time_now_ns() - start) / 1000000000.0;
+
+    for (const char *name : tune_parameter_names) {
+        fprintf(csv, "%s,", name);
+    }
+    fprintf(csv, "survival_mean,survival_p10,survival_p50,survival_p90,survived,score_mean,score_p10,score_p50,score_p90\n");
+
+    for (uint32_t p = 0; p < sweep.points; ++p) {
+        const TuneResult &r = results[p];
+        for (float value : r.values) {
+            fprintf(csv, "%g,", (double)value);
+        }
+        fprintf(csv, "%.1f,%u,%u,%u,%.3f,%.2f,%d,%d,%d\n", (double)r.survival_mean, r.survival_p10, r.survival_p50, r.survival_p90, (double)r.survived,
+                (double)r.score_mean, r.score_p10, r.score_p50, r.score_p90);
+    }
+
+    if (csv != stdout) {
+        fclose(csv);
+    }
+
+    fprintf(stderr, "%u points, %u sessions each, %u threads, %.1fs, %.0f sessions/s\n", sweep.points, sweep.sessions, sweep.threads, seconds,
+            (double)sweep.points * sweep.sessions / seconds);
+
+    for (uint32_t i = 0; i < sweep.threads; ++i) {
+        allocator.deallocate(workers[i]->survival);
+        allocator.deallocate(workers[i]->score);
+        MAKE_DELETE(allocator, TuneWorker, workers[i]);
+    }
+
+    allocator.deallocate(workers);
+    allocator.deallocate(results);
+
+    return 0;
+}
+
+/**
+ * @brief Feeds a frame governor frames that run normal, then heavy, then
+ * normal again, each shed level taking some work off, and prints the levels
+ * it picks. Checks that it sheds under load and restores every level after.
+ */
+static int governor_trace(const ini_t *config, float normal_ms, float heavy_ms, float saved_ms) {
+    FrameGovernor governor;
+    frame_governor::init(governor, config);
+    governor.enabled = true;
+
+    const uint32_t phase_frames = 600;
+    QualityLevel deepest = QualityLevel::Full;
+    QualityLevel level = governor.level;
+
+    for (uint32_t frame = 0; frame < phase_frames * 3; ++frame) {
+        const float base_ms = frame >= phase_frames && frame < phase_frames * 2 ? heavy_ms : normal_ms;
+        const float work_ms = base_ms - saved_ms * (float)governor.level;
+        frame_governor::record(governor, (uint64_t)((work_ms > 0.0f ? work_ms : 0.0f) * 1000000.0f));
+
+        if (governor.level != level) {
+            level = governor.level;
+            deepest = level > deepest ? level : deepest;
+            printf("frame %4u: %s, estimate %.2fms\n", frame, frame_governor::level_name(level), governor.estimate_ns / 1000000.0);
+        }
+    }
+
+    printf("frames: %llu, over budget: %u, sheds: %u, restores: %u, degraded: %llu\n", (unsigned long long)governor.frames, governor.frames_over_budget,
+           governor.sheds, governor.restores, (unsigned long long)(governor.frames - governor.frames_at_level[(int)QualityLevel::Full]));
+
+    return deepest != QualityLevel::Full && governor.level == QualityLevel::Full ? 0 : 1;
+}
+
+// One side of the loopback test.
+struct Peer {
+    Peer(Allocator &allocator)
+    : world(allocator)
+    , scratch(allocator)
+    , rollback(allocator)
+    , lockstep()
+    , bot()
+    , checksums(allocator)
+    , confirmed(0) {
+    }
+
+    World world;
+    World scratch;
+    Rollback rollback;
+    Lockstep lockstep;
+    RandomBot bot;
+
+    // The checksum of the world at the end of every confirmed tick.
+    Array<uint64_t> checksums;
+    uint32_t confirmed;
+};
+
+// Steps a peer through a frame, as game_state_playing_update does.
+static bool step(Peer &peer, const ini_t *config, float dt) {
+    Lockstep &lockstep = peer.lockstep;
+    World &world = peer.world;
+
+    lockstep::poll(lockstep, dt);
+
+    if (lockstep.status == LockstepStatus::Disconnected) {
+        return false;
+    }
+
+    if (lockstep.status == LockstepStatus::Connecting) {
+        return true;
+    }
+
+    if (world.player_count == 0) {
+        world::init(world, config, PlayfieldWidth, PlayfieldHeight, lockstep.seed, PlayerMax);
+        world::init(peer.scratch, config, PlayfieldWidth, PlayfieldHeight, lockstep.seed, PlayerMax);
+        rollback::init(peer.rollback, world.bullets.max_capacity);
+    }
+
+    uint32_t rollback_tick;
+    if (lockstep::take_rollback(lockstep, rollback_tick) && !rollback::resimulate(peer.rollback, world, lockstep, rollback_tick)) {
+        log_error("Player %u can't roll back to tick %u", lockstep.local_player + 1, rollback_tick);
+        return false;
+    }
+
+    if (!lockstep::should_yield(lockstep, world.tick)) {
+        lockstep::schedule(lockstep, world.tick, random_input(peer.bot));
+
+        TickInput inputs[PlayerMax];
+        if (lockstep::inputs_for(lockstep, world.tick, inputs)) {
+            rollback::advance(peer.rollback, world, inputs);
+        }
+    }
+
+    lockstep::flush(lockstep);
+
+    // A tick is final once the remote input for it is known. Its end is the snapshot of the next tick.
+    const uint32_t remote = 1 - lockstep.local_player;
+    while (peer.confirmed + 1 < world.tick && peer.confirmed < lockstep.known[remote]) {
+        if (!rollback::restore(peer.rollback, peer.scratch, peer.confirmed + 1)) {
+            log_error("Player %u lost the snapshot of tick %u", lockstep.local_player + 1, peer.confirmed + 1);
+            return false;
+        }
+
+        array::push_back(peer.checksums, world::checksum(peer.scratch));
+        ++peer.confirmed;
+    }
+
+    return true;
+}
+
+// Returns whether a host turns away a peer whose config hash differs, and keeps waiting for another.
+static bool refuses_other_config(Allocator &allocator, uint64_t config_hash, uint16_t port) {
+    Lockstep *host = MAKE_NEW(allocator, Lockstep);
+    Lockstep *join = MAKE_NEW(allocator, Lockstep);
+
+    if (!lockstep::open(*host, LockstepRole::Host, nullptr, port, 3, 1234, config_hash, 5.0f)
+        || !lockstep::open(*join, LockstepRole::Join, "127.0.0.1", port, 3, 0, config_hash ^ 1, 5.0f)) {
+        log_fatal("Could not open the loopback sessions");
+    }
+
+    for (uint32_t frame = 0; frame < 60 && join->status == LockstepStatus::Connecting; ++frame) {
+        lockstep::poll(*join, TickDt);
+        lockstep::poll(*host, TickDt);
+    }
+
+    bool refused = join->status == LockstepStatus::Disconnected && host->status == LockstepStatus::Connecting;
+
+    MAKE_DELETE(allocator, Lockstep, join);
+    MAKE_DELETE(allocator, Lockstep, host);
+
+    return refused;
+}
+
+/**
+ * @brief Runs a host and a peer in one process over UDP loopback, with simulated
+ * latency, jitter and loss, and checks that their worlds agree on every confirmed tick.
+ * First checks that the host refuses a peer with another config.
+ */
+static int loopback(Allocator &allocator, const ini_t *config, uint64_t config_hash, float latency, float jitter, float loss, uint32_t ticks,
+                    uint32_t max_rollback, uint16_t port) {
+    bool refused = refuses_other_config(allocator, config_hash, port);
+    printf("peer with another config refused: %s\n", refused ? "yes" : "no");
+
+    Peer *host = MAKE_NEW(allocator, Peer, allocator);
+    Peer *join = MAKE_NEW(allocator, Peer, allocator);
+
+    rnd_pcg_seed(&host->bot.random, 1);
+    rnd_pcg_seed(&join->bot.random, 2);
+
+    if (!lockstep::open(host->lockstep, LockstepRole::Host, nullptr, port, 3, 1234, config_hash, 5.0f)
+        || !lockstep::open(join->lockstep, LockstepRole::Join, "127.0.0.1", port, 3, 0, config_hash, 5.0f)) {
+        log_fatal("Could not open the loopback sessions");
+    }
+
+    for (Peer *peer : {host, join}) {
+        lockstep::set_prediction(peer->lockstep, max_rollback < RollbackWindow ? max_rollback : RollbackWindow - 1);
+        lockstep::simulate_conditions(peer->lockstep, latency, jitter, loss);
+    }
+
+    // Frames are simulated, not waited for, so this runs as fast as it can.
+    const uint32_t max_frames = ticks * 4 + 600;
+    bool ok = true;
+    uint32_t frame = 0;
+    for (; frame < max_frames && ok && (host->confirmed < ticks || join->confirmed < ticks); ++frame) {
+        ok = step(*host, config, TickDt) && step(*join, config, TickDt);
+    }
+
+    uint32_t compared = host->confirmed < join->confirmed ? host->confirmed : join->confirmed;
+    uint32_t mismatches = 0;
+    for (uint32_t i = 0; i < compared; ++i) {
+        if (host->checksums[i] != join->checksums[i]) {
+            if (mismatches == 0) {
+                printf("first mismatch at tick %u\n", i);
+            }
+            ++mismatches;
+        }
+    }
+
+    printf("latency: %.0fms, jitter: %.0fms, loss: %.1f%%, max rollback: %u\n", latency * 1000.0f, jitter * 1000.0f, loss * 100.0f, max_rollback);
+    printf("frames: %u, compared ticks: %u, mismatches: %u\n", frame, compared, mismatches);
+
+    for (Peer *peer : {host, join}) {
+        const Lockstep &ls = peer->lockstep;
+        const Rollback &rb = peer->rollback;
+        printf("player %u: stalls %u, mispredictions %u, rollbacks %u, deepest %u, resimulated %u, worst %.3fms\n",
+               ls.local_player + 1, ls.stalls, ls.mispredictions, rb.rollbacks, rb.deepest, rb.resimulated, rb.worst_rollback_ns / 1000000.0);
+    }
+
+    lockstep::close(host->lockstep);
+    lockstep::close(join->lockstep);
+
+    MAKE_DELETE(allocator, Peer, host);
+    MAKE_DELETE(allocator, Peer, join);
+
+    if (!ok || compared < ticks) {
+        printf("the peers didn't reach tick %u\n", ticks);
+        return 1;
+    }
+
+    return mismatches == 0 && refused ? 0 : 1;
+}
+
+static void usage() {
+    printf("usage: space_hell_headless --bench [bullets] [depth] [iterations]\n");
+    printf("       space_hell_headless --loopback [latency_ms] [jitter_ms] [loss] [ticks] [max_rollback] [port]\n");
+    printf("       space_hell_headless --bench-math [bullets] [ticks]\n");
+    printf("       space_hell_headless --checksum [ticks]\n");
+    printf("       space_hell_headless --bench-collision [bullets] [speed] [iterations]\n");
+    printf("       space_hell_headless --soak <replay> [ticks] [keyframe_interval]\n");
+    printf("       space_hell_headless --verify <replay>\n");
+    printf("       space_hell_headless --capture <replay> <out.ppm|out.y4m|out.raw> [every]\n");
+    printf("       space_hell_headless --golden [list] [dump_dir]\n");
+    printf("       space_hell_headless --golden-record [list]\n");
+    printf("       space_hell_headless --alloc-check [ticks]\n");
+    printf("       space_hell_headless --bot [skill] [minutes] [seed]\n");
+    printf("       space_hell_headless --tune [sweep.ini] [out.csv]\n");
+    printf("       space_hell_headless --bench-particles [particles] [frames]\n");
+    printf("       space_hell_headless --bench-waves [spawns] [ticks]\n");
+    printf("       space_hell_headless --bench-rnd [draws] [seed]\n");
+    printf("       space_hell_headless --bench-upscale [frames]\n");
+    printf("       space_hell_headless --governor [normal_ms] [heavy_ms] [saved_ms_per_level]\n");
+}
+
+// Returns argument i as a number, or a default if it wasn't given.
+static double arg(int argc, char *argv[], int i, double default_value) {
+    return i < argc ? atof(argv[i]) : default_value;
+}
+
+// The directory of the executable, from how it was started, or the current directory.
+static void executable_dir(const char *argv0, char *dir, size_t size) {
+    const char *end = strrchr(argv0, '/');
+    const char *backslash = strrchr(argv0, '\\');
+    if (backslash && (!end || backslash > end)) {
+        end = backslash;
+    }
+
+    if (!end) {
+        snprintf(dir, size, ".");
+    } else {
+        snprintf(dir, size, "%.*s", (int)(end - argv0), argv0);
+    }
+}
+
+int main(int argc, char *argv[]) {
+    if (argc < 2) {
+        usage();
+        return 1;
+    }
+
+    memory_globals::init();
+    int status = 1;
+
+    {
+        Allocator &allocator = memory_globals::default_allocator();
+        uint64_t config_hash;
+        ini_t *config = load_config("assets/config.ini", config_hash);
+
+        if (strcmp(argv[1], "--bench") == 0) {
+            status = bench(allocator, config,
+                           (uint32_t)arg(argc, argv, 2, 4096),
+                           (uint32_t)arg(argc, argv, 3, 8),
+                           (uint32_t)arg(argc, argv, 4, 100));
+        } else if (strcmp(argv[1], "--loopback") == 0) {
+            status = loopback(allocator, config, config_hash,
+                              (float)arg(argc, argv, 2, 60) / 1000.0f,
+                              (float)arg(argc, argv, 3, 20) / 1000.0f,
+                              (float)arg(argc, argv, 4, 0.05),
+                              (uint32_t)arg(argc, argv, 5, 3600),
+                              (uint32_t)arg(argc, argv, 6, 8),
+                              (uint16_t)arg(argc, argv, 7, 27115));
+        } else if (strcmp(argv[1], "--bench-math") == 0) {
+            status = bench_math(allocator,
+                                (uint32_t)arg(argc, argv, 2, 4096),
+                                (uint32_t)arg(argc, argv, 3, 600));
+        } else if (strcmp(argv[1], "--bench-collision") == 0) {
+            status = bench_collision(allocator, config,
+                                     (uint32_t)arg(argc, argv, 2, 4096),
+                                     (float)arg(argc, argv, 3, 1200),
+                                     (uint32_t)arg(argc, argv, 4, 1000));
+        } else if (strcmp(argv[1], "--checksum") == 0) {
+            status = checksum(allocator, config, (uint32_t)arg(argc, argv, 2, 3600));
+        } else if (strcmp(argv[1], "--soak") == 0 && argc > 2) {
+            status = soak(allocator, config, config_hash,
+                          (uint32_t)arg(argc, argv, 3, 60 * 60 * TickRate),
+                          argv[2],
+                          (uint32_t)arg(argc, argv, 4, config_int(config, "replay", "keyframe_interval", (int32_t)ReplayKeyframeInterval)));
+        } else if (strcmp(argv[1], "--verify") == 0 && argc > 2) {
+            status = verify(allocator, config, config_hash, argv[2]);
+        } else if (strcmp(argv[1], "--capture") == 0 && argc > 3) {
+            status = capture(allocator, config, argv[2], argv[3], (uint32_t)arg(argc, argv, 4, 1));
+        } else if (strcmp(argv[1], "--golden") == 0) {
+            // The tool runs from the source directory to find the assets; a divergent frame goes next to the tool instead.
+            char dump_dir[512];
+            executable_dir(argv[0], dump_dir, sizeof(dump_dir));
+            status = golden(allocator, config, argc > 2 ? argv[2] : GoldenListPath, argc > 3 ? argv[3] : dump_dir, false);
+        } else if (strcmp(argv[1], "--golden-record") == 0) {
+            status = golden(allocator, config, argc > 2 ? argv[2] : GoldenListPath, ".", true);
+        } else if (strcmp(argv[1], "--alloc-check") == 0) {
+            status = alloc_check(allocator, config, (uint32_t)arg(argc, argv, 2, 3600));
+        } else if (strcmp(argv[1], "--governor") == 0) {
+            status = governor_trace(config,
+                                    (float)arg(argc, argv, 2, 8),
+                                    (float)arg(argc, argv, 3, 20),
+                                    (float)arg(argc, argv, 4, 2));
+        } else if (strcmp(argv[1], "--bench-particles") == 0) {
+            status = bench_particles(allocator, config,
+                                     (uint32_t)arg(argc, argv, 2, 50000),
+                                     (uint32_t)arg(argc, argv, 3, 600));
+        } else if (strcmp(argv[1], "--bench-waves") == 0) {
+            status = bench_waves((uint32_t)arg(argc, argv, 2, SpawnMax),
+                                 (uint32_t)arg(argc, argv, 3, 60 * 60 * TickRate));
+        } else if (strcmp(argv[1], "--bench-rnd") == 0) {
+            status = bench_rnd((uint32_t)arg(argc, argv, 2, 1 << 22), (uint32_t)arg(argc, argv, 3, 1));
+        } else if (strcmp(argv[1], "--bench-upscale") == 0) {
+            status = bench_upscale(allocator, (uint32_t)arg(argc, argv, 2, 1000));
+        } else if (strcmp(argv[1], "--tune") == 0) {
+            status = tune(allocator, config, argc > 2 ? argv[2] : TuneSweepPath, argc > 3 ? argv[3] : nullptr);
+        } else if (strcmp(argv[1], "--bot") == 0) {
+            status = bot_soak(allocator, config,
+                              (float)arg(argc, argv, 2, 1.0),
+                              (uint32_t)arg(argc, argv, 3, 60),
+                              (uint32_t)arg(argc, argv, 4, 1));
+        } else {
+            usage();
+        }
+
+        ini_destroy(config);
+    }
+
+    memory_globals::shutdown();
+
+    return status;
+}
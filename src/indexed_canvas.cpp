@@ -0,0 +1,423 @@
+#include "indexed_canvas.h"
+#include "game.h"
+
+#pragma warning(push, 0)
+#include <cassert>
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include <array.h>
+#include <memory.h>
+#include <murmur_hash.h>
+
+#include <engine/log.h>
+#pragma warning(pop)
+
+namespace game {
+
+using namespace foundation;
+
+constexpr uint32_t rgba(uint32_t r, uint32_t g, uint32_t b) {
+    return r | (g << 8) | (b << 16) | (0xffu << 24);
+}
+
+const uint32_t pico8_palette[16] = {
+    rgba(0x00, 0x00, 0x00),
+    rgba(0x1d, 0x2b, 0x53),
+    rgba(0x7e, 0x25, 0x53),
+    rgba(0x00, 0x87, 0x51),
+    rgba(0xab, 0x52, 0x36),
+    rgba(0x5f, 0x57, 0x4f),
+    rgba(0xc2, 0xc3, 0xc7),
+    rgba(0xff, 0xf1, 0xe8),
+    rgba(0xff, 0x00, 0x4d),
+    rgba(0xff, 0xa3, 0x00),
+    rgba(0xff, 0xec, 0x27),
+    rgba(0x00, 0xe4, 0x36),
+    rgba(0x29, 0xad, 0xff),
+    rgba(0x83, 0x76, 0x9c),
+    rgba(0xff, 0x77, 0xa8),
+    rgba(0xff, 0xcc, 0xaa),
+};
+
+// Returns the palette index closest to an RGBA pixel, or TransparentIndex.
+static uint8_t palette_index(const uint8_t *pixel) {
+    if (pixel[3] < 128) {
+        return TransparentIndex;
+    }
+
+    uint8_t best = 0;
+    int32_t best_distance = INT32_MAX;
+
+    for (uint8_t i = 0; i < 16; ++i) {
+        const uint8_t *color = (const uint8_t *)&pico8_palette[i];
+        int32_t dr = (int32_t)pixel[0] - color[0];
+        int32_t dg = (int32_t)pixel[1] - color[1];
+        int32_t db = (int32_t)pixel[2] - color[2];
+        int32_t distance = dr * dr + dg * dg + db * db;
+        if (distance < best_distance) {
+            best = i;
+            best_distance = distance;
+        }
+    }
+
+    return best == pico8::black ? TransparentIndex : best;
+}
+
+IndexedCanvas::IndexedCanvas(Allocator &allocator)
+: allocator(allocator)
+, config(nullptr)
+, width(0)
+, height(0)
+, pixels(nullptr)
+, sprite_size(0)
+, atlas_width(0)
+, atlas_height(0)
+, atlas(nullptr)
+, tiles(allocator)
+, spans(allocator)
+, span_pixels(allocator)
+, glyphs()
+, text_runs()
+, next_text_run(0) {
+}
+
+IndexedCanvas::~IndexedCanvas() {
+    if (pixels) {
+        allocator.deallocate(pixels);
+    }
+
+    if (atlas) {
+        allocator.deallocate(atlas);
+    }
+
+    for (TextRun &run : text_runs) {
+        if (run.mask) {
+            allocator.deallocate(run.mask);
+        }
+    }
+}
+
+// Returns the sprite for a character from the config's char_* properties, or -1.
+static int32_t glyph_sprite(const ini_t *config, char c) {
+    char property[16];
+
+    switch (c) {
+    case ',':
+        return config_int(config, "canvas", "char_comma", -1);
+    case '-':
+        return config_int(config, "canvas", "char_minus", -1);
+    case '.':
+        return config_int(config, "canvas", "char_dot", -1);
+    case ':':
+        return config_int(config, "canvas", "char_colon", -1);
+    default:
+        break;
+    }
+
+    if (!isalnum((unsigned char)c)) {
+        return -1;
+    }
+
+    snprintf(property, sizeof(property), "char_%c", tolower((unsigned char)c));
+    return config_int(config, "canvas", property, -1);
+}
+
+// Converts every sprite in the atlas into runs of opaque pixels.
+static void build_sprite_spans(IndexedCanvas &canvas) {
+    const int32_t size = canvas.sprite_size;
+    const int32_t per_row = canvas.atlas_width / size;
+    const int32_t count = per_row * (canvas.atlas_height / size);
+
+    array::clear(canvas.tiles);
+    array::clear(canvas.spans);
+    array::clear(canvas.span_pixels);
+    array::resize(canvas.tiles, (uint32_t)count);
+
+    for (int32_t index = 0; index < count; ++index) {
+        const int32_t sx = (index % per_row) * size;
+        const int32_t sy = (index / per_row) * size;
+
+        SpriteTile tile;
+        tile.first_span = array::size(canvas.spans);
+        tile.min_x = (uint8_t)size;
+        tile.min_y = (uint8_t)size;
+
+        for (int32_t row = 0; row < size; ++row) {
+            const uint8_t *src = canvas.atlas + (sy + row) * canvas.atlas_width + sx;
+
+            int32_t col = 0;
+            while (col < size) {
+                if (src[col] == TransparentIndex) {
+                    ++col;
+                    continue;
+                }
+
+                int32_t start = col;
+                while (col < size && src[col] != TransparentIndex) {
+                    ++col;
+                }
+
+                SpriteSpan span;
+                span.x = (uint8_t)start;
+                span.y = (uint8_t)row;
+                span.length = (uint8_t)(col - start);
+                span.padding = 0;
+                span.offset = array::size(canvas.span_pixels);
+                array::push_back(canvas.spans, span);
+
+                for (int32_t i = start; i < col; ++i) {
+                    array::push_back(canvas.span_pixels, src[i]);
+                }
+
+                tile.min_x = start < tile.min_x ? (uint8_t)start : tile.min_x;
+                tile.max_x = col > tile.max_x ? (uint8_t)col : tile.max_x;
+                tile.min_y = row < tile.min_y ? (uint8_t)row : tile.min_y;
+                tile.max_y = (uint8_t)(row + 1);
+            }
+        }
+
+        tile.span_count = array::size(canvas.spans) - tile.first_span;
+        canvas.tiles[index] = tile;
+    }
+}
+
+namespace indexed_canvas {
+
+void init(IndexedCanvas &canvas, const ini_t *config, int32_t width, int32_t height) {
+    assert(config != nullptr);
+    assert(width > 0 && height > 0);
+
+    canvas.config = config;
+
+    if (canvas.pixels) {
+        canvas.allocator.deallocate(canvas.pixels);
+    }
+
+    canvas.width = width;
+    canvas.height = height;
+    canvas.pixels = (uint8_t *)canvas.allocator.allocate(width * height, 32);
+    memset(canvas.pixels, pico8::black, width * height);
+
+    canvas.sprite_size = config_int(config, "canvas", "sprite_size", 8);
+
+    // Resolve the glyphs once, so text never touches the config.
+    for (int32_t c = 0; c < GlyphCount; ++c) {
+        canvas.glyphs[c] = (int16_t)glyph_sprite(config, (char)c);
+    }
+
+    // Allocate the text run cache.
+    for (TextRun &run : canvas.text_runs) {
+        if (run.mask) {
+            canvas.allocator.deallocate(run.mask);
+        }
+
+        run = TextRun();
+        run.mask = (uint8_t *)canvas.allocator.allocate(TextRunMaxLength * canvas.sprite_size * canvas.sprite_size);
+    }
+
+    canvas.next_text_run = 0;
+}
+
+void palettize(const uint8_t *rgba, uint8_t *indices, int32_t count) {
+    for (int32_t i = 0; i < count; ++i) {
+        indices[i] = palette_index(&rgba[i * 4]);
+    }
+}
+
+void load_sprites(IndexedCanvas &canvas, const uint8_t *indices, int32_t width, int32_t height) {
+    assert(indices != nullptr);
+    assert(canvas.sprite_size > 0);
+
+    if (canvas.atlas) {
+        canvas.allocator.deallocate(canvas.atlas);
+    }
+
+    canvas.atlas_width = width;
+    canvas.atlas_height = height;
+    canvas.atlas = (uint8_t *)canvas.allocator.allocate(width * height);
+    memcpy(canvas.atlas, indices, width * height);
+
+    build_sprite_spans(canvas);
+
+    // Glyphs rasterized before the atlas was loaded are blank.
+    for (TextRun &run : canvas.text_runs) {
+        run.key = 0;
+    }
+}
+
+void clear(IndexedCanvas &canvas, uint8_t color) {
+    memset(canvas.pixels, color, canvas.width * canvas.height);
+}
+
+void pset(IndexedCanvas &canvas, int32_t x, int32_t y, uint8_t color) {
+    if (x < 0 || y < 0 || x >= canvas.width || y >= canvas.height) {
+        return;
+    }
+
+    canvas.pixels[y * canvas.width + x] = color;
+}
+
+void points(IndexedCanvas &canvas, const uint32_t *offsets, const uint8_t *colors, uint32_t count) {
+    uint8_t *pixels = canvas.pixels;
+    for (uint32_t i = 0; i < count; ++i) {
+        assert(offsets[i] < (uint32_t)(canvas.width * canvas.height));
+        pixels[offsets[i]] = colors[i];
+    }
+}
+
+void sprite(IndexedCanvas &canvas, int32_t index, int32_t x, int32_t y) {
+    if (index < 0 || (uint32_t)index >= array::size(canvas.tiles)) {
+        return;
+    }
+
+    const SpriteTile &tile = canvas.tiles[index];
+    if (tile.span_count == 0) {
+        return;
+    }
+
+    // Reject sprites whose opaque pixels are entirely outside the canvas.
+    if (x + tile.max_x <= 0 || x + tile.min_x >= canvas.width || y + tile.max_y <= 0 || y + tile.min_y >= canvas.height) {
+        return;
+    }
+
+    const SpriteSpan *span = array::begin(canvas.spans) + tile.first_span;
+    const SpriteSpan *span_end = span + tile.span_count;
+    const uint8_t *pixels = array::begin(canvas.span_pixels);
+
+    // Sprites entirely inside the canvas copy their spans without clipping.
+    if (x + tile.min_x >= 0 && x + tile.max_x <= canvas.width && y + tile.min_y >= 0 && y + tile.max_y <= canvas.height) {
+        for (; span != span_end; ++span) {
+            memcpy(canvas.pixels + (y + span->y) * canvas.width + x + span->x, pixels + span->offset, span->length);
+        }
+        return;
+    }
+
+    for (; span != span_end; ++span) {
+        int32_t dy = y + span->y;
+        if (dy < 0 || dy >= canvas.height) {
+            continue;
+        }
+
+        int32_t x0 = x + span->x;
+        int32_t x1 = x0 + span->length;
+        int32_t skip = x0 < 0 ? -x0 : 0;
+        x0 += skip;
+        x1 = x1 > canvas.width ? canvas.width : x1;
+
+        if (x0 < x1) {
+            memcpy(canvas.pixels + dy * canvas.width + x0, pixels + span->offset + skip, x1 - x0);
+        }
+    }
+}
+
+void line(IndexedCanvas &canvas, int32_t x0, int32_t y0, int32_t x1, int32_t y1, uint8_t color) {
+    int32_t dx = abs(x1 - x0);
+    int32_t dy = -abs(y1 - y0);
+    int32_t step_x = x0 < x1 ? 1 : -1;
+    int32_t step_y = y0 < y1 ? 1 : -1;
+    int32_t error = dx + dy;
+
+    while (true) {
+        pset(canvas, x0, y0, color);
+
+        if (x0 == x1 && y0 == y1) {
+            break;
+        }
+
+        int32_t e2 = 2 * error;
+        if (e2 >= dy) {
+            error += dy;
+            x0 += step_x;
+        }
+        if (e2 <= dx) {
+            error += dx;
+            y0 += step_y;
+        }
+    }
+}
+
+void rectangle(IndexedCanvas &canvas, int32_t x0, int32_t y0, int32_t x1, int32_t y1, uint8_t color) {
+    line(canvas, x0, y0, x1, y0, color);
+    line(canvas, x0, y1, x1, y1, color);
+    line(canvas, x0, y0, x0, y1, color);
+    line(canvas, x1, y0, x1, y1, color);
+}
+
+const TextRun &text_run(IndexedCanvas &canvas, const char *text) {
+    uint32_t length = (uint32_t)strlen(text);
+    if (length > (uint32_t)TextRunMaxLength) {
+        length = (uint32_t)TextRunMaxLength;
+    }
+
+    uint64_t key = murmur_hash_64(text, length, 0);
+
+    for (const TextRun &run : canvas.text_runs) {
+        if (run.key == key && run.mask && run.length == (int32_t)length && memcmp(run.text, text, length) == 0) {
+            return run;
+        }
+    }
+
+    // Rasterize into the oldest slot.
+    TextRun &run = canvas.text_runs[canvas.next_text_run];
+    canvas.next_text_run = (canvas.next_text_run + 1) % TextRunCacheSize;
+
+    const int32_t size = canvas.sprite_size;
+    const int32_t per_row = canvas.atlas_width / size;
+    const int32_t tile_count = per_row * (canvas.atlas_height / size);
+
+    run.key = key;
+    memcpy(run.text, text, length);
+    run.length = (int32_t)length;
+    run.width = (int32_t)length * size;
+    run.height = size;
+    memset(run.mask, 0, run.width * run.height);
+
+    for (uint32_t i = 0; i < length; ++i) {
+        unsigned char c = (unsigned char)text[i];
+        int32_t index = c < GlyphCount ? canvas.glyphs[c] : -1;
+        if (index < 0 || index >= tile_count || !canvas.atlas) {
+            continue;
+        }
+
+        const int32_t sx = (index % per_row) * size;
+        const int32_t sy = (index / per_row) * size;
+
+        for (int32_t row = 0; row < size; ++row) {
+            const uint8_t *src = canvas.atlas + (sy + row) * canvas.atlas_width + sx;
+            uint8_t *dst = run.mask + row * run.width + i * size;
+            for (int32_t col = 0; col < size; ++col) {
+                dst[col] = src[col] != TransparentIndex;
+            }
+        }
+    }
+
+    return run;
+}
+
+void blit_text(IndexedCanvas &canvas, const TextRun &run, int32_t x, int32_t y, uint8_t color) {
+    int32_t x0 = x < 0 ? -x : 0;
+    int32_t y0 = y < 0 ? -y : 0;
+    int32_t x1 = x + run.width > canvas.width ? canvas.width - x : run.width;
+    int32_t y1 = y + run.height > canvas.height ? canvas.height - y : run.height;
+
+    for (int32_t row = y0; row < y1; ++row) {
+        const uint8_t *src = run.mask + row * run.width;
+        uint8_t *dst = canvas.pixels + (y + row) * canvas.width + x;
+        for (int32_t col = x0; col < x1; ++col) {
+            if (src[col]) {
+                dst[col] = color;
+            }
+        }
+    }
+}
+
+void print(IndexedCanvas &canvas, const char *text, int32_t x, int32_t y, uint8_t color) {
+    blit_text(canvas, text_run(canvas, text), x, y, color);
+}
+
+} // namespace indexed_canvas
+
+} // namespace game
@@ -0,0 +1,200 @@
+#pragma once
+
+#include "util.h"
+
+#pragma warning(push, 0)
+#include <collection_types.h>
+#include <memory_types.h>
+#include <stdint.h>
+#pragma warning(pop)
+
+typedef struct ini_t ini_t;
+
+namespace game {
+
+/// The PICO-8 palette indices.
+namespace pico8 {
+constexpr uint8_t black = 0;
+constexpr uint8_t dark_blue = 1;
+constexpr uint8_t dark_purple = 2;
+constexpr uint8_t dark_green = 3;
+constexpr uint8_t brown = 4;
+constexpr uint8_t dark_gray = 5;
+constexpr uint8_t light_gray = 6;
+constexpr uint8_t white = 7;
+constexpr uint8_t red = 8;
+constexpr uint8_t orange = 9;
+constexpr uint8_t yellow = 10;
+constexpr uint8_t green = 11;
+constexpr uint8_t blue = 12;
+constexpr uint8_t indigo = 13;
+constexpr uint8_t pink = 14;
+constexpr uint8_t peach = 15;
+} // namespace pico8
+
+/// The PICO-8 palette as RGBA bytes in memory order, indexed by palette index.
+extern const uint32_t pico8_palette[16];
+
+/// Marks a transparent pixel in the sprite atlas.
+constexpr uint8_t TransparentIndex = 0xff;
+
+/// The number of characters that have glyphs, starting at 0.
+constexpr int32_t GlyphCount = 128;
+
+/// The longest text a TextRun holds. Longer text is cut off.
+constexpr int32_t TextRunMaxLength = 32;
+
+/// The number of TextRuns cached by a canvas.
+constexpr uint32_t TextRunCacheSize = 8;
+
+/**
+ * @brief A horizontal run of opaque pixels in a sprite.
+ *
+ */
+struct SpriteSpan {
+    uint8_t x;
+    uint8_t y;
+    uint8_t length;
+    uint8_t padding;
+
+    // Offset of the span's pixels in IndexedCanvas::span_pixels.
+    uint32_t offset;
+};
+
+/**
+ * @brief The opaque spans of one sprite in the atlas, with the bounds of its opaque pixels.
+ *
+ */
+struct SpriteTile {
+    uint32_t first_span = 0;
+    uint32_t span_count = 0;
+
+    // Bounds of the opaque pixels, max is exclusive. Used to reject and clip the sprite as a whole.
+    uint8_t min_x = 0;
+    uint8_t min_y = 0;
+    uint8_t max_x = 0;
+    uint8_t max_y = 0;
+};
+
+/**
+ * @brief A line of text rasterized into a single bitmap, keyed by the text.
+ *
+ * The murmur hash of the text is compared first, and the text itself only when
+ * the hashes match, so a collision can't draw another string.
+ */
+struct TextRun {
+    uint64_t key = 0;
+    char text[TextRunMaxLength] = {};
+    int32_t length = 0;
+    int32_t width = 0;
+    int32_t height = 0;
+
+    // width * height bytes, 1 where the text has ink.
+    uint8_t *mask = nullptr;
+};
+
+/**
+ * @brief A canvas of 8 bit palette indices. All drawing writes palette indices,
+ * and the expansion to RGBA is done once when the canvas is presented.
+ *
+ * Like PICO-8, black pixels in sprites are transparent.
+ */
+struct IndexedCanvas {
+    IndexedCanvas(foundation::Allocator &allocator);
+    ~IndexedCanvas();
+    DELETE_COPY_AND_MOVE(IndexedCanvas)
+
+    foundation::Allocator &allocator;
+    const ini_t *config;
+    int32_t width;
+    int32_t height;
+    uint8_t *pixels;
+
+    // The sprite atlas, as palette indices or TransparentIndex.
+    int32_t sprite_size;
+    int32_t atlas_width;
+    int32_t atlas_height;
+    uint8_t *atlas;
+
+    // The atlas preprocessed into runs of opaque pixels, indexed by sprite.
+    foundation::Array<SpriteTile> tiles;
+    foundation::Array<SpriteSpan> spans;
+    foundation::Array<uint8_t> span_pixels;
+
+    // The glyph sprite of each character, or -1, resolved from the config's char_* properties.
+    int16_t glyphs[GlyphCount];
+
+    // Recently printed text.
+    TextRun text_runs[TextRunCacheSize];
+    uint32_t next_text_run;
+};
+
+namespace indexed_canvas {
+
+/**
+ * @brief Allocates the canvas and resolves the glyphs named by the config's [canvas] section.
+ * The canvas draws no sprites until they are loaded with load_sprites.
+ *
+ * @param canvas The canvas to initialize.
+ * @param config The config to read the sprite size and glyphs from.
+ * @param width The width of the canvas.
+ * @param height The height of the canvas.
+ */
+void init(IndexedCanvas &canvas, const ini_t *config, int32_t width, int32_t height);
+
+/**
+ * @brief Converts RGBA pixels to the nearest palette indices. Black and translucent pixels become TransparentIndex.
+ * Doesn't allocate, so it's safe to call from a worker thread. The indices may overwrite the RGBA pixels in place.
+ *
+ * @param rgba The RGBA pixels.
+ * @param indices The palette indices, count bytes.
+ * @param count The number of pixels.
+ */
+void palettize(const uint8_t *rgba, uint8_t *indices, int32_t count);
+
+/**
+ * @brief Copies a sprite atlas of palette indices into the canvas and preprocesses its sprites.
+ *
+ * @param canvas The canvas to load the sprites into.
+ * @param indices The atlas as palette indices, from palettize.
+ * @param width The width of the atlas.
+ * @param height The height of the atlas.
+ */
+void load_sprites(IndexedCanvas &canvas, const uint8_t *indices, int32_t width, int32_t height);
+
+/// Fills the canvas with a color.
+void clear(IndexedCanvas &canvas, uint8_t color);
+
+/// Sets a single pixel, if it is inside the canvas.
+void pset(IndexedCanvas &canvas, int32_t x, int32_t y, uint8_t color);
+
+/// Sets a batch of pixels, given as offsets into the canvas that must all be inside it.
+void points(IndexedCanvas &canvas, const uint32_t *offsets, const uint8_t *colors, uint32_t count);
+
+/// Draws a sprite from the atlas with its top left corner at x, y.
+void sprite(IndexedCanvas &canvas, int32_t index, int32_t x, int32_t y);
+
+/// Draws a line between two points, inclusive.
+void line(IndexedCanvas &canvas, int32_t x0, int32_t y0, int32_t x1, int32_t y1, uint8_t color);
+
+/// Draws the outline of a rectangle between two corners, inclusive.
+void rectangle(IndexedCanvas &canvas, int32_t x0, int32_t y0, int32_t x1, int32_t y1, uint8_t color);
+
+/**
+ * @brief Returns the rasterized run for a text, rasterizing it into the cache if it isn't there.
+ *
+ * @param canvas The canvas whose glyphs and cache to use.
+ * @param text The text.
+ * @return const TextRun& The run, valid until TextRunCacheSize other texts have been rasterized.
+ */
+const TextRun &text_run(IndexedCanvas &canvas, const char *text);
+
+/// Draws a rasterized run of text, in a color.
+void blit_text(IndexedCanvas &canvas, const TextRun &run, int32_t x, int32_t y, uint8_t color);
+
+/// Prints text using the char_* glyph sprites from the config, drawn in a color.
+void print(IndexedCanvas &canvas, const char *text, int32_t x, int32_t y, uint8_t color);
+
+} // namespace indexed_canvas
+
+} // namespace game
@@ -0,0 +1,113 @@
+#include "input_log.h"
+#include "game.h"
+
+#pragma warning(push, 0)
+#include <chrono>
+#include <cstdio>
+
+#include <engine/log.h>
+#pragma warning(pop)
+
+namespace game {
+
+static_assert((InputLogCapacity & (InputLogCapacity - 1)) == 0, "InputLogCapacity must be a power of two");
+
+uint64_t time_now_ns() {
+    using namespace std::chrono;
+    return (uint64_t)duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+namespace input_log {
+
+void record(InputLog &log, Action action, bool pressed) {
+    // Drop the oldest event if the ring is full.
+    if (log.recorded - log.presented == InputLogCapacity) {
+        ++log.presented;
+        if (log.consumed < log.presented) {
+            log.consumed = log.presented;
+        }
+    }
+
+    InputEvent &event = log.events[log.recorded & (InputLogCapacity - 1)];
+    event = InputEvent();
+    event.received_time = time_now_ns();
+    event.action = action;
+    event.pressed = pressed;
+
+    ++log.recorded;
+}
+
+void consume(InputLog &log) {
+    for (; log.consumed != log.recorded; ++log.consumed) {
+        log.events[log.consumed & (InputLogCapacity - 1)].consumed_frame = log.frame;
+    }
+}
+
+void present(InputLog &log) {
+    uint64_t now = time_now_ns();
+
+    for (; log.presented != log.consumed; ++log.presented) {
+        InputEvent &event = log.events[log.presented & (InputLogCapacity - 1)];
+        event.presented_frame = log.frame;
+        event.presented_time = now;
+
+        uint64_t latency = now - event.received_time;
+        uint64_t bucket = latency / 1000 / LatencyHistogramBucketWidth;
+        if (bucket >= LatencyHistogramBuckets) {
+            bucket = LatencyHistogramBuckets - 1;
+        }
+
+        ++log.histogram[bucket];
+        ++log.samples;
+        log.total_latency += latency;
+        log.min_latency = latency < log.min_latency ? latency : log.min_latency;
+        log.max_latency = latency > log.max_latency ? latency : log.max_latency;
+    }
+
+    ++log.frame;
+}
+
+void reset_histogram(InputLog &log) {
+    for (uint32_t i = 0; i < LatencyHistogramBuckets; ++i) {
+        log.histogram[i] = 0;
+    }
+
+    log.samples = 0;
+    log.total_latency = 0;
+    log.min_latency = UINT64_MAX;
+    log.max_latency = 0;
+}
+
+bool export_csv(const InputLog &log, const char *filename) {
+    FILE *file = fopen(filename, "w");
+    if (!file) {
+        log_error("Could not open %s for writing", filename);
+        return false;
+    }
+
+    fprintf(file, "bucket_start_us,bucket_end_us,count\n");
+    for (uint32_t i = 0; i < LatencyHistogramBuckets; ++i) {
+        fprintf(file, "%u,%u,%u\n", i * LatencyHistogramBucketWidth, (i + 1) * LatencyHistogramBucketWidth, log.histogram[i]);
+    }
+
+    fprintf(file, "\naction,pressed,received_ns,consumed_frame,presented_frame,latency_us\n");
+    uint32_t first = log.recorded > InputLogCapacity ? log.recorded - InputLogCapacity : 0;
+    for (uint32_t i = first; i != log.presented; ++i) {
+        const InputEvent &event = log.events[i & (InputLogCapacity - 1)];
+        fprintf(file, "%u,%d,%llu,%llu,%llu,%.1f\n",
+                (uint32_t)event.action,
+                event.pressed ? 1 : 0,
+                (unsigned long long)event.received_time,
+                (unsigned long long)event.consumed_frame,
+                (unsigned long long)event.presented_frame,
+                (event.presented_time - event.received_time) / 1000.0);
+    }
+
+    fclose(file);
+    log_info("Exported input latency to %s", filename);
+    return true;
+}
+
+} // namespace input_log
+
+} // namespace game
@@ -0,0 +1,124 @@
+#pragma once
+
+#include <stdint.h>
+
+namespace game {
+
+/// Dense action indices, resolved from the ActionHash bound to each keycode by the game.
+enum class Action : uint8_t {
+    NONE,
+    QUIT,
+    LEFT,
+    UP,
+    RIGHT,
+    DOWN,
+    ACTION,
+    DEBUG,
+    PAUSE,
+    COUNT,
+};
+
+/// The number of input events retained by the InputLog, must be a power of two.
+constexpr uint32_t InputLogCapacity = 256;
+
+/// The number of buckets in the latency histogram.
+constexpr uint32_t LatencyHistogramBuckets = 64;
+
+/// The width of each latency histogram bucket, in microseconds.
+constexpr uint32_t LatencyHistogramBucketWidth = 500;
+
+/**
+ * @brief A single timestamped input event.
+ *
+ */
+struct InputEvent {
+    // Time in nanoseconds when the event was received.
+    uint64_t received_time = 0;
+
+    // Time in nanoseconds when the frame that consumed the event was presented.
+    uint64_t presented_time = 0;
+
+    // The frame which consumed the event in its update.
+    uint64_t consumed_frame = 0;
+
+    // The frame which presented the result of the event.
+    uint64_t presented_frame = 0;
+
+    Action action = Action::NONE;
+    bool pressed = false;
+    char padding[6];
+};
+
+/**
+ * @brief A ring buffer of input events, tracking the latency from when an input
+ * is received until the frame consuming it has been presented.
+ *
+ */
+struct InputLog {
+    InputEvent events[InputLogCapacity];
+
+    // Monotonic event indices, masked into events.
+    uint32_t recorded = 0;
+    uint32_t consumed = 0;
+    uint32_t presented = 0;
+
+    // The current frame, advanced when a frame is presented.
+    uint64_t frame = 0;
+
+    // Histogram of input to present latency.
+    uint32_t histogram[LatencyHistogramBuckets] = {};
+    uint32_t samples = 0;
+    uint64_t total_latency = 0;
+    uint64_t min_latency = UINT64_MAX;
+    uint64_t max_latency = 0;
+};
+
+/// Returns a monotonic high resolution timestamp in nanoseconds.
+uint64_t time_now_ns();
+
+namespace input_log {
+
+/**
+ * @brief Records an input event, timestamped now.
+ *
+ * @param log The log to record into.
+ * @param action The action of the event.
+ * @param pressed Whether the action was pressed or released.
+ */
+void record(InputLog &log, Action action, bool pressed);
+
+/**
+ * @brief Tags all recorded events as consumed by the current frame. Call when
+ * the simulation has sampled the input.
+ *
+ * @param log The log.
+ */
+void consume(InputLog &log);
+
+/**
+ * @brief Tags all consumed events as presented, accumulates their latency and
+ * advances the frame. Call after the frame has been handed to the renderer.
+ *
+ * @param log The log.
+ */
+void present(InputLog &log);
+
+/**
+ * @brief Clears the latency histogram.
+ *
+ * @param log The log.
+ */
+void reset_histogram(InputLog &log);
+
+/**
+ * @brief Writes the latency histogram and the retained events as CSV.
+ *
+ * @param log The log to export.
+ * @param filename The file to write.
+ * @return true If the file was written.
+ */
+bool export_csv(const InputLog &log, const char *filename);
+
+} // namespace input_log
+
+} // namespace game
@@ -0,0 +1,648 @@
+#include "lockstep.h"
+
+#pragma warning(push, 0)
+#include <cassert>
+#include <cstring>
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <winsock2.h>
+#include <ws2tcpip.h>
+typedef SOCKET native_socket;
+#else
+#include <arpa/inet.h>
+#include <cerrno>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+typedef int native_socket;
+#endif
+
+#include <engine/log.h>
+#pragma warning(pop)
+
+namespace game {
+
+constexpr intptr_t InvalidSocket = -1;
+
+// "SH", the first bytes of every packet.
+constexpr uint16_t PacketMagic = 0x4853;
+// Float and fixed point builds simulate differently, so they don't talk to each other.
+#if defined(FIXED_POINT)
+constexpr uint8_t PacketVersion = 0x84;
+#else
+constexpr uint8_t PacketVersion = 4;
+#endif
+
+// Seconds between hellos while joining.
+constexpr float HandshakeInterval = 0.25f;
+
+// Ticks between two waits for the peer, long enough for the first to show up in its reports.
+constexpr uint32_t YieldInterval = 15;
+
+enum class PacketType : uint8_t {
+    // Join to host: let me in, with the hash of my config.
+    Hello = 1,
+
+    // Host to join: the seed, input delay and the hash of the host's config. Sent for every hello.
+    Welcome = 2,
+
+    // Both ways: inputs from the first unacknowledged tick, and what we have received.
+    Input = 3,
+
+    // Host to join: your config differs from mine, with the hash of the host's config.
+    Refuse = 4,
+};
+
+constexpr uint32_t PacketHeaderSize = 4;
+constexpr uint32_t HelloSize = PacketHeaderSize + 8;
+constexpr uint32_t WelcomeSize = PacketHeaderSize + 13;
+constexpr uint32_t RefuseSize = PacketHeaderSize + 8;
+constexpr uint32_t InputHeaderSize = PacketHeaderSize + 14;
+constexpr uint32_t PacketMaxSize = InputHeaderSize + LockstepMaxPacketInputs;
+
+static_assert(PacketMaxSize == LockstepMaxPacketSize, "LockstepMaxPacketSize must fit an input packet");
+
+static void write_u16(uint8_t *p, uint16_t v) {
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+}
+
+static void write_u32(uint8_t *p, uint32_t v) {
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+    p[2] = (uint8_t)(v >> 16);
+    p[3] = (uint8_t)(v >> 24);
+}
+
+static void write_u64(uint8_t *p, uint64_t v) {
+    write_u32(p, (uint32_t)v);
+    write_u32(p + 4, (uint32_t)(v >> 32));
+}
+
+static uint16_t read_u16(const uint8_t *p) {
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static uint32_t read_u32(const uint8_t *p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static uint64_t read_u64(const uint8_t *p) {
+    return (uint64_t)read_u32(p) | ((uint64_t)read_u32(p + 4) << 32);
+}
+
+static void write_header(uint8_t *p, PacketType type) {
+    write_u16(p, PacketMagic);
+    p[2] = PacketVersion;
+    p[3] = (uint8_t)type;
+}
+
+static void close_socket(intptr_t socket) {
+#if defined(_WIN32)
+    closesocket((native_socket)socket);
+#else
+    ::close((native_socket)socket);
+#endif
+}
+
+// Closes a socket that failed to open, and releases Winsock.
+static void abandon(intptr_t socket) {
+    if (socket != InvalidSocket) {
+        close_socket(socket);
+    }
+
+#if defined(_WIN32)
+    WSACleanup();
+#endif
+}
+
+// Returns true if a failed receive should be skipped rather than ending the poll.
+static bool skip_receive_error() {
+#if defined(_WIN32)
+    // Windows reports an ICMP port unreachable from an earlier send as a reset on the next receive.
+    return WSAGetLastError() == WSAECONNRESET;
+#else
+    return errno == ECONNREFUSED;
+#endif
+}
+
+static void send_to(Lockstep &lockstep, uint32_t address, uint16_t port, const uint8_t *data, uint32_t size) {
+    sockaddr_in to = {};
+    to.sin_family = AF_INET;
+    to.sin_addr.s_addr = htonl(address);
+    to.sin_port = htons(port);
+
+    int sent = (int)sendto((native_socket)lockstep.socket, (const char *)data, (int)size, 0, (const sockaddr *)&to, (int)sizeof(to));
+    if (sent < 0) {
+        // The peer may not be listening yet, the next packet carries the same data.
+        return;
+    }
+
+    lockstep.bytes_sent += size;
+    lockstep.packets_sent++;
+}
+
+static void send_now(Lockstep &lockstep, const uint8_t *data, uint32_t size) {
+    send_to(lockstep, lockstep.peer_address, lockstep.peer_port, data, size);
+}
+
+static void send_packet(Lockstep &lockstep, const uint8_t *data, uint32_t size) {
+    if (lockstep.sim_latency <= 0.0f && lockstep.sim_jitter <= 0.0f && lockstep.sim_loss <= 0.0f) {
+        send_now(lockstep, data, size);
+        return;
+    }
+
+    if (rnd_pcg_nextf(&lockstep.sim_random) < lockstep.sim_loss || lockstep.delayed_count == LockstepDelayedMax) {
+        return;
+    }
+
+    float jitter = (rnd_pcg_nextf(&lockstep.sim_random) * 2.0f - 1.0f) * lockstep.sim_jitter;
+
+    DelayedPacket &packet = lockstep.delayed[lockstep.delayed_count++];
+    packet.release_time = lockstep.clock + lockstep.sim_latency + jitter;
+    packet.size = size;
+    memcpy(packet.data, data, size);
+}
+
+// Sends the delayed packets that are due. Jitter can reorder them, as on a real network.
+static void release_delayed(Lockstep &lockstep) {
+    uint32_t i = 0;
+    while (i < lockstep.delayed_count) {
+        DelayedPacket &packet = lockstep.delayed[i];
+        if (packet.release_time > lockstep.clock) {
+            ++i;
+            continue;
+        }
+
+        send_now(lockstep, packet.data, packet.size);
+        packet = lockstep.delayed[--lockstep.delayed_count];
+    }
+}
+
+// Starts exchanging inputs. The first input_delay ticks of both players are empty.
+static void start(Lockstep &lockstep) {
+    memset(lockstep.inputs, 0, sizeof(lockstep.inputs));
+
+    for (uint32_t player = 0; player < PlayerMax; ++player) {
+        lockstep.known[player] = lockstep.input_delay;
+    }
+
+    memset(lockstep.predicted, 0, sizeof(lockstep.predicted));
+    lockstep.rollback_pending = false;
+    lockstep.rollback_tick = 0;
+
+    lockstep.peer_ack = 0;
+    lockstep.tick = 0;
+    lockstep.peer_tick = 0;
+    lockstep.peer_advantage = 0;
+    lockstep.next_yield_tick = 0;
+    lockstep.status = LockstepStatus::Running;
+
+    log_info("Lockstep running as player %u, seed %u, input delay %u", lockstep.local_player + 1, lockstep.seed, lockstep.input_delay);
+}
+
+static void send_welcome(Lockstep &lockstep) {
+    uint8_t packet[WelcomeSize];
+    write_header(packet, PacketType::Welcome);
+    write_u32(packet + 4, lockstep.seed);
+    packet[8] = (uint8_t)lockstep.input_delay;
+    write_u64(packet + 9, lockstep.config_hash);
+    send_packet(lockstep, packet, sizeof(packet));
+}
+
+// Turns away a peer whose config differs. Sent straight away, since the peer isn't the session's.
+static void send_refuse(Lockstep &lockstep, uint32_t address, uint16_t port) {
+    uint8_t packet[RefuseSize];
+    write_header(packet, PacketType::Refuse);
+    write_u64(packet + 4, lockstep.config_hash);
+    send_to(lockstep, address, port, packet, sizeof(packet));
+}
+
+static void receive_input(Lockstep &lockstep, const uint8_t *data, uint32_t size) {
+    if (size < InputHeaderSize) {
+        return;
+    }
+
+    uint32_t ack = read_u32(data + 4);
+    uint32_t peer_tick = read_u32(data + 8);
+    int32_t peer_advantage = (int8_t)data[12];
+    uint32_t first = read_u32(data + 13);
+    uint32_t count = data[17];
+
+    if (size < InputHeaderSize + count) {
+        return;
+    }
+
+    // Packets may arrive out of order, only move forward.
+    if ((int32_t)(ack - lockstep.peer_ack) > 0) {
+        lockstep.peer_ack = ack;
+    }
+
+    if ((int32_t)(peer_tick - lockstep.peer_tick) >= 0) {
+        lockstep.peer_tick = peer_tick;
+        lockstep.peer_advantage = peer_advantage;
+    }
+
+    const uint32_t remote = 1 - lockstep.local_player;
+    const uint8_t *inputs = data + InputHeaderSize;
+
+    for (uint32_t i = 0; i < count; ++i) {
+        uint32_t tick = first + i;
+
+        // Already known, or a gap that a later packet fills.
+        if (tick != lockstep.known[remote]) {
+            if ((int32_t)(tick - lockstep.known[remote]) > 0) {
+                break;
+            }
+            continue;
+        }
+
+        // Don't overwrite inputs that haven't been simulated. Ticks behind ours were predicted.
+        if ((int32_t)(tick - lockstep.tick) >= (int32_t)LockstepWindow) {
+            break;
+        }
+
+        lockstep.inputs[remote][tick % LockstepWindow] = inputs[i];
+        lockstep.known[remote]++;
+
+        // Ticks before our next tick were simulated with a guess, roll back if it was wrong.
+        if ((int32_t)(tick - lockstep.tick) < 0 && lockstep.predicted[tick % LockstepWindow] != inputs[i]) {
+            lockstep.mispredictions++;
+            if (!lockstep.rollback_pending || (int32_t)(tick - lockstep.rollback_tick) < 0) {
+                lockstep.rollback_tick = tick;
+            }
+            lockstep.rollback_pending = true;
+        }
+    }
+}
+
+Lockstep::Lockstep()
+: socket(InvalidSocket)
+, peer_address(0)
+, peer_port(0)
+, role(LockstepRole::Host)
+, status(LockstepStatus::Disconnected)
+, local_player(0)
+, input_delay(0)
+, seed(0)
+, config_hash(0)
+, inputs()
+, predicted()
+, max_prediction(0)
+, rollback_tick(0)
+, rollback_pending(false)
+, known()
+, peer_ack(0)
+, tick(0)
+, peer_tick(0)
+, peer_advantage(0)
+, next_yield_tick(0)
+, silence(0.0f)
+, timeout(0.0f)
+, handshake_timer(0.0f)
+, sim_latency(0.0f)
+, sim_jitter(0.0f)
+, sim_loss(0.0f)
+, sim_random()
+, clock(0.0)
+, delayed()
+, delayed_count(0)
+, bytes_sent(0)
+, bytes_received(0)
+, packets_sent(0)
+, packets_received(0)
+, stalls(0)
+, mispredictions(0) {
+}
+
+Lockstep::~Lockstep() {
+    lockstep::close(*this);
+}
+
+namespace lockstep {
+
+bool open(Lockstep &lockstep, LockstepRole role, const char *address, uint16_t port, uint32_t input_delay, uint32_t seed, uint64_t config_hash, float timeout) {
+    close(lockstep);
+
+#if defined(_WIN32)
+    WSADATA wsa_data;
+    if (WSAStartup(MAKEWORD(2, 2), &wsa_data) != 0) {
+        log_error("Could not start Winsock");
+        return false;
+    }
+#endif
+
+    intptr_t s = (intptr_t)::socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    if (s == InvalidSocket) {
+        log_error("Could not create a UDP socket");
+        abandon(s);
+        return false;
+    }
+
+#if defined(_WIN32)
+    u_long non_blocking = 1;
+    ioctlsocket((native_socket)s, FIONBIO, &non_blocking);
+#else
+    fcntl((native_socket)s, F_SETFL, fcntl((native_socket)s, F_GETFL, 0) | O_NONBLOCK);
+#endif
+
+    // The host listens on the port, the joining peer on any free port.
+    sockaddr_in local = {};
+    local.sin_family = AF_INET;
+    local.sin_addr.s_addr = htonl(INADDR_ANY);
+    local.sin_port = htons(role == LockstepRole::Host ? port : 0);
+
+    if (bind((native_socket)s, (const sockaddr *)&local, (int)sizeof(local)) != 0) {
+        log_error("Could not bind UDP port %u", role == LockstepRole::Host ? port : 0);
+        abandon(s);
+        return false;
+    }
+
+    lockstep.peer_address = 0;
+    lockstep.peer_port = 0;
+
+    if (role == LockstepRole::Join) {
+        in_addr host = {};
+        if (inet_pton(AF_INET, address, &host) != 1) {
+            log_error("Invalid host address %s", address);
+            abandon(s);
+            return false;
+        }
+
+        lockstep.peer_address = ntohl(host.s_addr);
+        lockstep.peer_port = port;
+    }
+
+    lockstep.socket = s;
+    lockstep.role = role;
+    lockstep.status = LockstepStatus::Connecting;
+    lockstep.local_player = role == LockstepRole::Host ? 0 : 1;
+    lockstep.input_delay = input_delay > LockstepMaxInputDelay ? LockstepMaxInputDelay : input_delay;
+    lockstep.seed = seed;
+    lockstep.config_hash = config_hash;
+    lockstep.silence = 0.0f;
+    lockstep.timeout = timeout;
+    lockstep.handshake_timer = 0.0f;
+    lockstep.bytes_sent = 0;
+    lockstep.bytes_received = 0;
+    lockstep.packets_sent = 0;
+    lockstep.packets_received = 0;
+    lockstep.stalls = 0;
+    lockstep.mispredictions = 0;
+    lockstep.clock = 0.0;
+    lockstep.delayed_count = 0;
+
+    if (role == LockstepRole::Host) {
+        log_info("Hosting on UDP port %u", port);
+    } else {
+        log_info("Joining %s:%u", address, port);
+    }
+
+    return true;
+}
+
+void set_prediction(Lockstep &lockstep, uint32_t max_prediction) {
+    // Inputs past the window would overwrite ticks that haven't been confirmed.
+    lockstep.max_prediction = max_prediction < LockstepWindow / 2 ? max_prediction : LockstepWindow / 2;
+}
+
+void simulate_conditions(Lockstep &lockstep, float latency, float jitter, float loss) {
+    lockstep.sim_latency = latency;
+    lockstep.sim_jitter = jitter < latency ? jitter : latency;
+    lockstep.sim_loss = loss;
+    rnd_pcg_seed(&lockstep.sim_random, 0x5eed);
+}
+
+void close(Lockstep &lockstep) {
+    if (lockstep.socket == InvalidSocket) {
+        return;
+    }
+
+    close_socket(lockstep.socket);
+    lockstep.socket = InvalidSocket;
+    lockstep.status = LockstepStatus::Disconnected;
+
+#if defined(_WIN32)
+    WSACleanup();
+#endif
+}
+
+void poll(Lockstep &lockstep, float dt) {
+    if (lockstep.socket == InvalidSocket) {
+        lockstep.status = LockstepStatus::Disconnected;
+        return;
+    }
+
+    lockstep.silence += dt;
+    lockstep.clock += dt;
+
+    release_delayed(lockstep);
+
+    uint8_t packet[PacketMaxSize];
+
+    while (true) {
+        sockaddr_in from = {};
+        socklen_t from_size = sizeof(from);
+        int size = (int)recvfrom((native_socket)lockstep.socket, (char *)packet, (int)sizeof(packet), 0, (sockaddr *)&from, &from_size);
+        if (size < 0) {
+            if (skip_receive_error()) {
+                continue;
+            }
+            break;
+        }
+
+        if ((uint32_t)size < PacketHeaderSize || read_u16(packet) != PacketMagic || packet[2] != PacketVersion) {
+            continue;
+        }
+
+        uint32_t from_address = ntohl(from.sin_addr.s_addr);
+        uint16_t from_port = ntohs(from.sin_port);
+        PacketType type = (PacketType)packet[3];
+
+        // The host takes the first peer that says hello with the same config, and ignores everyone else after that.
+        if (lockstep.role == LockstepRole::Host && type == PacketType::Hello && lockstep.status == LockstepStatus::Connecting) {
+            uint64_t peer_hash = (uint32_t)size >= HelloSize ? read_u64(packet + 4) : 0;
+            if (peer_hash != lockstep.config_hash) {
+                log_error("Refused a peer from %u.%u.%u.%u:%u, its config hash %016llx differs from %016llx", from_address >> 24, (from_address >> 16) & 0xff,
+                          (from_address >> 8) & 0xff, from_address & 0xff, from_port, (unsigned long long)peer_hash, (unsigned long long)lockstep.config_hash);
+                send_refuse(lockstep, from_address, from_port);
+                continue;
+            }
+
+            lockstep.peer_address = from_address;
+            lockstep.peer_port = from_port;
+            log_info("Peer joined from %u.%u.%u.%u:%u", from_address >> 24, (from_address >> 16) & 0xff, (from_address >> 8) & 0xff, from_address & 0xff, from_port);
+            start(lockstep);
+        }
+
+        if (from_address != lockstep.peer_address || from_port != lockstep.peer_port) {
+            continue;
+        }
+
+        lockstep.silence = 0.0f;
+        lockstep.bytes_received += (uint32_t)size;
+        lockstep.packets_received++;
+
+        switch (type) {
+        case PacketType::Hello: {
+            if (lockstep.role == LockstepRole::Host) {
+                send_welcome(lockstep);
+            }
+            break;
+        }
+        case PacketType::Welcome: {
+            if (lockstep.role == LockstepRole::Join && lockstep.status == LockstepStatus::Connecting && (uint32_t)size >= WelcomeSize) {
+                uint64_t host_hash = read_u64(packet + 9);
+                if (host_hash != lockstep.config_hash) {
+                    log_error("The host's config hash %016llx differs from %016llx", (unsigned long long)host_hash, (unsigned long long)lockstep.config_hash);
+                    lockstep.status = LockstepStatus::Disconnected;
+                    break;
+                }
+
+                lockstep.seed = read_u32(packet + 4);
+                lockstep.input_delay = packet[8] > LockstepMaxInputDelay ? LockstepMaxInputDelay : packet[8];
+                start(lockstep);
+            }
+            break;
+        }
+        case PacketType::Refuse: {
+            if (lockstep.role == LockstepRole::Join && lockstep.status == LockstepStatus::Connecting && (uint32_t)size >= RefuseSize) {
+                log_error("The host refused us, its config hash %016llx differs from %016llx", (unsigned long long)read_u64(packet + 4),
+                          (unsigned long long)lockstep.config_hash);
+                lockstep.status = LockstepStatus::Disconnected;
+            }
+            break;
+        }
+        case PacketType::Input: {
+            if (lockstep.status == LockstepStatus::Running) {
+                receive_input(lockstep, packet, (uint32_t)size);
+            }
+            break;
+        }
+        }
+    }
+
+    if (lockstep.status == LockstepStatus::Connecting && lockstep.role == LockstepRole::Join) {
+        lockstep.handshake_timer -= dt;
+        if (lockstep.handshake_timer <= 0.0f) {
+            lockstep.handshake_timer = HandshakeInterval;
+
+            uint8_t hello[HelloSize];
+            write_header(hello, PacketType::Hello);
+            write_u64(hello + 4, lockstep.config_hash);
+            send_packet(lockstep, hello, sizeof(hello));
+        }
+    }
+
+    // The host waits for a peer for as long as it takes.
+    bool waiting = lockstep.status == LockstepStatus::Connecting && lockstep.role == LockstepRole::Host;
+    if (!waiting && lockstep.status != LockstepStatus::Disconnected && lockstep.silence > lockstep.timeout) {
+        log_error("Lost the peer after %.1fs of silence", lockstep.silence);
+        lockstep.status = LockstepStatus::Disconnected;
+    }
+}
+
+void flush(Lockstep &lockstep) {
+    if (lockstep.status != LockstepStatus::Running) {
+        return;
+    }
+
+    const uint32_t local = lockstep.local_player;
+    const uint32_t remote = 1 - local;
+
+    uint32_t first = lockstep.peer_ack;
+    uint32_t count = lockstep.known[local] - first;
+    if (count > LockstepMaxPacketInputs) {
+        count = LockstepMaxPacketInputs;
+    }
+
+    uint8_t packet[PacketMaxSize];
+    write_header(packet, PacketType::Input);
+    write_u32(packet + 4, lockstep.known[remote]);
+    write_u32(packet + 8, lockstep.tick);
+
+    int32_t advantage = (int32_t)(lockstep.tick - lockstep.peer_tick);
+    packet[12] = (uint8_t)(int8_t)(advantage < -128 ? -128 : advantage > 127 ? 127 : advantage);
+
+    write_u32(packet + 13, first);
+    packet[17] = (uint8_t)count;
+
+    for (uint32_t i = 0; i < count; ++i) {
+        packet[InputHeaderSize + i] = lockstep.inputs[local][(first + i) % LockstepWindow];
+    }
+
+    send_packet(lockstep, packet, InputHeaderSize + count);
+}
+
+void schedule(Lockstep &lockstep, uint32_t tick, TickInput input) {
+    const uint32_t local = lockstep.local_player;
+
+    if (lockstep.known[local] != tick + lockstep.input_delay) {
+        return;
+    }
+
+    lockstep.inputs[local][lockstep.known[local] % LockstepWindow] = input;
+    lockstep.known[local]++;
+}
+
+bool inputs_for(Lockstep &lockstep, uint32_t tick, TickInput *inputs) {
+    lockstep.tick = tick;
+
+    const uint32_t local = lockstep.local_player;
+    const uint32_t remote = 1 - local;
+
+    if ((int32_t)(lockstep.known[local] - tick) <= 0) {
+        lockstep.stalls++;
+        return false;
+    }
+
+    inputs[local] = lockstep.inputs[local][tick % LockstepWindow];
+
+    int32_t ahead = (int32_t)(tick - lockstep.known[remote]);
+    if (ahead < 0) {
+        inputs[remote] = lockstep.inputs[remote][tick % LockstepWindow];
+    } else if (ahead < (int32_t)lockstep.max_prediction) {
+        // Guess the remote player still holds what it held in its last known input.
+        uint32_t last = lockstep.known[remote] - 1;
+        TickInput guess = lockstep.known[remote] > 0 ? lockstep.inputs[remote][last % LockstepWindow] : 0;
+        lockstep.predicted[tick % LockstepWindow] = guess;
+        inputs[remote] = guess;
+    } else {
+        lockstep.stalls++;
+        return false;
+    }
+
+    lockstep.tick = tick + 1;
+    return true;
+}
+
+bool take_rollback(Lockstep &lockstep, uint32_t &tick) {
+    if (!lockstep.rollback_pending) {
+        return false;
+    }
+
+    tick = lockstep.rollback_tick;
+    lockstep.rollback_pending = false;
+    return true;
+}
+
+bool should_yield(Lockstep &lockstep, uint32_t tick) {
+    if ((int32_t)(tick - lockstep.next_yield_tick) < 0) {
+        return false;
+    }
+
+    int32_t advantage = (int32_t)(tick - lockstep.peer_tick);
+    if ((advantage - lockstep.peer_advantage) / 2 < 1) {
+        return false;
+    }
+
+    lockstep.next_yield_tick = tick + YieldInterval;
+    return true;
+}
+
+} // namespace lockstep
+
+} // namespace game
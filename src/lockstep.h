@@ -0,0 +1,238 @@
+#pragma once
+
+#include "util.h"
+#include "world.h"
+
+#pragma warning(push, 0)
+#include "rnd.h"
+
+#include <stdint.h>
+#pragma warning(pop)
+
+namespace game {
+
+/// The number of ticks of input a Lockstep keeps. Bounds how far the peers can drift apart.
+constexpr uint32_t LockstepWindow = 128;
+
+/// The most input delay, in ticks.
+constexpr uint32_t LockstepMaxInputDelay = 30;
+
+/// The most inputs sent in one packet. Older unacknowledged inputs wait for the next packet.
+constexpr uint32_t LockstepMaxPacketInputs = 64;
+
+/// The largest packet, an input packet with LockstepMaxPacketInputs inputs.
+constexpr uint32_t LockstepMaxPacketSize = 18 + LockstepMaxPacketInputs;
+
+/// The most packets held back by simulated latency.
+constexpr uint32_t LockstepDelayedMax = 64;
+
+/// A packet held back by simulated latency.
+struct DelayedPacket {
+    double release_time;
+    uint32_t size;
+    uint8_t data[LockstepMaxPacketSize];
+};
+
+enum class LockstepRole : uint8_t {
+    // Binds the port and waits for a peer to join.
+    Host,
+
+    // Sends hellos to the host until it answers.
+    Join,
+};
+
+enum class LockstepStatus : uint8_t {
+    // Waiting to hear from the peer.
+    Connecting,
+
+    // Exchanging inputs.
+    Running,
+
+    // The peer hasn't been heard from in too long, or the socket failed.
+    Disconnected,
+};
+
+/**
+ * @brief A lockstep session with one peer over UDP.
+ *
+ * Both peers run the same deterministic World and only exchange the input of
+ * their local player for each tick. Local input is scheduled input_delay ticks
+ * ahead, which hides the round trip: a tick is simulated once the inputs of both
+ * players for it have arrived. Every packet carries all inputs the peer hasn't
+ * acknowledged yet, so a lost packet is covered by the next one.
+ *
+ * With prediction enabled the session no longer waits for the remote input.
+ * It guesses that the remote player holds the same buttons as in its last known
+ * input, and when the real input turns out different it asks for a rollback to
+ * that tick.
+ *
+ * The host is player 0 and chooses the seed, the joining peer is player 1. The
+ * host refuses a peer whose config hash differs from its own, since the two
+ * worlds would simulate differently.
+ */
+struct Lockstep {
+    Lockstep();
+    ~Lockstep();
+    DELETE_COPY_AND_MOVE(Lockstep)
+
+    intptr_t socket;
+    uint32_t peer_address;
+    uint16_t peer_port;
+    LockstepRole role;
+    LockstepStatus status;
+
+    uint32_t local_player;
+    uint32_t input_delay;
+    uint32_t seed;
+
+    // The hash of the config, which both peers must share.
+    uint64_t config_hash;
+
+    // Inputs of both players, indexed by tick % LockstepWindow.
+    TickInput inputs[PlayerMax][LockstepWindow];
+
+    // The remote inputs that were guessed, indexed by tick % LockstepWindow.
+    TickInput predicted[LockstepWindow];
+
+    // How many ticks past the last known remote input are predicted. 0 waits for it.
+    uint32_t max_prediction;
+
+    // The earliest tick simulated with a wrong guess, if rollback_pending.
+    uint32_t rollback_tick;
+    bool rollback_pending;
+
+    // The inputs of a player are known for every tick before this.
+    uint32_t known[PlayerMax];
+
+    // The peer has acknowledged our inputs for every tick before this.
+    uint32_t peer_ack;
+
+    // The next tick we simulate.
+    uint32_t tick;
+
+    // The tick the peer was simulating when it sent its latest packet, and how far ahead of us it saw itself.
+    uint32_t peer_tick;
+    int32_t peer_advantage;
+
+    // We don't wait for the peer again before this tick, so one correction is seen by both sides before the next.
+    uint32_t next_yield_tick;
+
+    // Time since anything was heard from the peer, and the time after which it's disconnected.
+    float silence;
+    float timeout;
+
+    // Time until the next hello while connecting.
+    float handshake_timer;
+
+    // Simulated network conditions for outgoing packets, for testing on loopback.
+    float sim_latency;
+    float sim_jitter;
+    float sim_loss;
+    rnd_pcg_t sim_random;
+    double clock;
+    DelayedPacket delayed[LockstepDelayedMax];
+    uint32_t delayed_count;
+
+    // Counters
+    uint64_t bytes_sent;
+    uint64_t bytes_received;
+    uint32_t packets_sent;
+    uint32_t packets_received;
+    uint32_t stalls;
+    uint32_t mispredictions;
+};
+
+namespace lockstep {
+
+/**
+ * @brief Opens a non-blocking UDP socket for a session.
+ *
+ * @param lockstep The session to open.
+ * @param role Whether to host or join.
+ * @param address The host's IPv4 address to join. Ignored when hosting.
+ * @param port The port the host listens on.
+ * @param input_delay The number of ticks local input is delayed by. Only the host's delay is used.
+ * @param seed The seed of the world. Only the host's seed is used.
+ * @param config_hash The hash of the config. The peers refuse each other when theirs differ.
+ * @param timeout The seconds of silence after which the peer is disconnected.
+ * @return true If the socket opened.
+ */
+bool open(Lockstep &lockstep, LockstepRole role, const char *address, uint16_t port, uint32_t input_delay, uint32_t seed, uint64_t config_hash, float timeout);
+
+/**
+ * @brief Lets the session predict remote input instead of waiting for it, for rollback.
+ *
+ * @param lockstep The session.
+ * @param max_prediction How many ticks past the last known remote input to predict. 0 waits for it.
+ */
+void set_prediction(Lockstep &lockstep, uint32_t max_prediction);
+
+/**
+ * @brief Delays and drops outgoing packets, to test on loopback as if over a real network.
+ *
+ * @param lockstep The session.
+ * @param latency The seconds every packet is delayed by.
+ * @param jitter The most seconds added to or taken from the latency, uniformly.
+ * @param loss The fraction of packets dropped.
+ */
+void simulate_conditions(Lockstep &lockstep, float latency, float jitter, float loss);
+
+/// Closes the socket.
+void close(Lockstep &lockstep);
+
+/**
+ * @brief Receives packets from the peer and answers the handshake. Call once per frame, before stepping.
+ *
+ * @param lockstep The session.
+ * @param dt The time since the last poll, for the timeout.
+ */
+void poll(Lockstep &lockstep, float dt);
+
+/// Sends the peer every local input it hasn't acknowledged. Call once per frame, after stepping.
+void flush(Lockstep &lockstep);
+
+/**
+ * @brief Schedules the local player's input for tick + input_delay, if it isn't scheduled yet.
+ *
+ * @param lockstep The session.
+ * @param tick The tick about to be simulated.
+ * @param input The local player's buttons.
+ */
+void schedule(Lockstep &lockstep, uint32_t tick, TickInput input);
+
+/**
+ * @brief Returns the inputs of all players for a tick, if they have arrived or can be predicted.
+ * Counts a stall if they can't.
+ *
+ * @param lockstep The session.
+ * @param tick The tick about to be simulated.
+ * @param inputs Receives PlayerMax inputs.
+ * @return true If the tick can be simulated.
+ */
+bool inputs_for(Lockstep &lockstep, uint32_t tick, TickInput *inputs);
+
+/**
+ * @brief Returns the earliest tick that was simulated with a wrong prediction, and clears it.
+ *
+ * @param lockstep The session.
+ * @param tick Receives the tick to roll back to.
+ * @return true If a rollback is needed.
+ */
+bool take_rollback(Lockstep &lockstep, uint32_t &tick);
+
+/**
+ * @brief Returns whether to skip simulating this tick so the peer can catch up.
+ *
+ * Each peer measures how far it is ahead of the ticks the peer reports. Latency
+ * adds the same lag to both measurements, so half their difference is how far
+ * we are really ahead.
+ *
+ * @param lockstep The session.
+ * @param tick The tick about to be simulated.
+ * @return true If we are a tick or more ahead and should wait.
+ */
+bool should_yield(Lockstep &lockstep, uint32_t tick);
+
+} // namespace lockstep
+
+} // namespace game
@@ -1,4 +1,5 @@
 #include "game.h"
+#include "tracking_allocator.h"
 
 #pragma warning(push, 0)
 #define RND_IMPLEMENTATION
@@ -10,6 +11,10 @@
 #include <backward.hpp>
 #include <memory.h>
 
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
 #if defined(LIVE_PP)
 #include <Windows.h>
 
@@ -19,9 +24,6 @@
 #pragma warning(pop)
 
 int main(int argc, char *argv[]) {
-    (void)argc;
-    (void)argv;
-
     // Validate platform
     {
         unsigned int x = 1;
@@ -54,8 +56,37 @@ int main(int argc, char *argv[]) {
 
     {
         const char *config_path = "assets/config.ini";
-        engine::Engine engine(allocator, config_path);
-        game::Game game(allocator, config_path);
+
+        // Outlives the engine and the game, to report what they leak.
+        game::MemoryTracker memory(allocator);
+
+        engine::Engine engine(game::memory_tracker::allocator(memory, game::MemoryTag::Engine), config_path);
+        game::Game game(memory, config_path);
+
+        // Override the [net] config from the command line, to run a host and a peer from the same assets.
+        for (int i = 1; i < argc; ++i) {
+            if (strcmp(argv[i], "--host") == 0) {
+                game.net.mode = game::NetMode::Host;
+            } else if (strcmp(argv[i], "--join") == 0 && i + 1 < argc) {
+                game.net.mode = game::NetMode::Join;
+                snprintf(game.net.address, sizeof(game.net.address), "%s", argv[++i]);
+            } else if (strcmp(argv[i], "--local") == 0) {
+                game.net.mode = game::NetMode::Local;
+            } else if (strcmp(argv[i], "--record") == 0 && i + 1 < argc) {
+                game.record_path = argv[++i];
+            } else if (strcmp(argv[i], "--replay") == 0 && i + 1 < argc) {
+                game.replay_path = argv[++i];
+            } else if (strcmp(argv[i], "--capture") == 0 && i + 1 < argc) {
+                game.capture_path = argv[++i];
+            } else if (strcmp(argv[i], "--capture-every") == 0 && i + 1 < argc) {
+                game.capture_every = (uint32_t)atoi(argv[++i]);
+            } else if (strcmp(argv[i], "--bot") == 0 && i + 1 < argc) {
+                game.bot_skill = (float)atof(argv[++i]);
+            } else {
+                log_error("Unknown argument %s", argv[i]);
+            }
+        }
+
         engine::EngineCallbacks engine_callbacks;
         engine_callbacks.on_input = game::on_input;
         engine_callbacks.update = game::update;
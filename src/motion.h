@@ -0,0 +1,150 @@
+#pragma once
+
+#include "bullet_pool.h"
+#include "real.h"
+#include "world.h"
+
+#pragma warning(push, 0)
+#include <engine/math.inl>
+#include <stdint.h>
+#pragma warning(pop)
+
+namespace game {
+
+/**
+ * The motion of the entities of a World for one tick, written once for every scalar.
+ * Everything here is arithmetic on T and real:: functions, so with Fixed it is bit-exact on every build.
+ */
+namespace motion {
+
+/// Updates a player from its buttons, keeping it inside the playfield.
+template <typename T>
+void move_player(BasicPlayer<T> &player, TickInput input, int32_t width, int32_t height) {
+    const T dt = TickDt;
+
+    T steer_x = 0;
+    T steer_y = 0;
+
+    if (held(input, Button::Up)) {
+        steer_y -= player.speed_incr;
+    }
+    if (held(input, Button::Down)) {
+        steer_y += player.speed_incr;
+    }
+    if (held(input, Button::Left)) {
+        steer_x -= player.speed_incr;
+    }
+    if (held(input, Button::Right)) {
+        steer_x += player.speed_incr;
+    }
+
+    player.vel.x += steer_x * dt;
+    player.vel.y += steer_y * dt;
+
+    // velocity magnitude
+    T vel_mag = real::sqrt(player.vel.x * player.vel.x + player.vel.y * player.vel.y);
+
+    // check if faster than max
+    if (vel_mag > player.max_speed) {
+        T norm_vel_x = player.vel.x / vel_mag;
+        T norm_vel_y = player.vel.y / vel_mag;
+        player.vel.x = norm_vel_x * player.max_speed;
+        player.vel.y = norm_vel_y * player.max_speed;
+        vel_mag = player.max_speed;
+    } else if (vel_mag < T(0.01f)) {
+        // check if almost stopped
+        player.vel.x = 0;
+        player.vel.y = 0;
+    } else {
+        // apply a little bit of drag
+        player.vel.x = player.vel.x * (T(1) - player.drag);
+        player.vel.y = player.vel.y * (T(1) - player.drag);
+    }
+
+    // update position
+    player.pos.x += player.vel.x;
+    player.pos.y += player.vel.y;
+
+    // check for out of bounds
+    // account for player size
+    {
+        if (player.pos.x + player.bounds.origin.x + player.bounds.size.x > width - 1) {
+            player.pos.x = T(width - player.bounds.size.x - 1);
+            player.vel.x = 0;
+        }
+
+        if (player.pos.x + player.bounds.origin.x < 1) {
+            player.pos.x = T(-player.bounds.origin.x + 1);
+            player.vel.x = 0;
+        }
+
+        if (player.pos.y + player.bounds.origin.y + player.bounds.size.y > height - 1) {
+            player.pos.y = T(height - player.bounds.origin.y - player.bounds.size.y - 1);
+            player.vel.y = 0;
+        }
+
+        if (player.pos.y + player.bounds.origin.y < 10) {
+            player.pos.y = T(-player.bounds.origin.y + 10);
+            player.vel.y = 0;
+        }
+    }
+}
+
+/// Samples each path curve into a table, so moving an enemy is a lookup rather than sines and cosines.
+template <typename T>
+void build_paths(BasicPathLut<T> &lut) {
+    for (uint32_t i = 0; i < PathLutSize; ++i) {
+        T tt = real::pi<T>() * 2 * T((int32_t)i) / T((int32_t)PathLutSize);
+
+        // figure eight
+        {
+            T scale = T(2) / (T(3) - real::cos(tt * 2));
+            lut.points[(int)PathCurve::Lemniscate][i] = {scale * real::cos(tt) * 48, scale * real::sin(tt * 2) / 2 * 64};
+        }
+
+        lut.points[(int)PathCurve::Circle][i] = {real::cos(tt) * 40, real::sin(tt) * 40};
+
+        // a shallow arc above the center, there and back
+        lut.points[(int)PathCurve::Sweep][i] = {real::cos(tt) * 48, real::cos(tt * 2) * 6 - 32};
+
+        lut.points[(int)PathCurve::Lissajous][i] = {real::sin(tt * 3) * 44, real::sin(tt * 2) * 36};
+    }
+}
+
+/// Moves an enemy along its path around the center of the playfield, and turns its bullet spawner.
+template <typename T>
+void move_enemy(BasicEnemy<T> &enemy, const BasicPathLut<T> &lut, int32_t width, int32_t height) {
+    const T dt = TickDt;
+
+    // rotate bullet spawner
+    enemy.rot = real::wrap_angle(enemy.rot + enemy.rot_speed * dt);
+
+    // update enemy position, between the two nearest points of its path
+    const T steps_per_radian = T((double)PathLutSize / (3.14159265358979323846 * 2));
+    T step = enemy.path * steps_per_radian;
+    int32_t index = (int32_t)step;
+    T fraction = step - T(index);
+
+    const Vec2<T> *points = lut.points[(int)enemy.curve];
+    const Vec2<T> &a = points[(uint32_t)index & (PathLutSize - 1)];
+    const Vec2<T> &b = points[(uint32_t)(index + 1) & (PathLutSize - 1)];
+
+    enemy.pos.x = T(width) / 2 + a.x + (b.x - a.x) * fraction;
+    enemy.pos.y = T(height) / 2 + a.y + (b.y - a.y) * fraction;
+
+    enemy.path = real::wrap_angle(enemy.path + enemy.speed * dt);
+}
+
+/// Moves a bullet, returning whether it's still inside the bounds.
+template <typename T>
+bool move_bullet(BasicBullet<T> &bullet, const math::Rect &bounds) {
+    const T dt = TickDt;
+
+    bullet.pos.x += bullet.vel.x * dt;
+    bullet.pos.y += bullet.vel.y * dt;
+    return real::is_inside(bounds, bullet.pos);
+}
+
+} // namespace motion
+
+} // namespace game
@@ -0,0 +1,195 @@
+#include "particles.h"
+#include "indexed_canvas.h"
+
+#pragma warning(push, 0)
+#include <cassert>
+#include <cmath>
+
+#include <memory.h>
+#pragma warning(pop)
+
+namespace game {
+
+using namespace foundation;
+
+// How a kind of burst looks.
+struct ParticleLook {
+    uint8_t colors[4];
+    float min_speed;
+    float max_speed;
+    float min_life;
+    float max_life;
+};
+
+static const ParticleLook looks[(int)ParticleEffect::COUNT] = {
+    {{pico8::yellow, pico8::orange, pico8::white, pico8::peach}, 15.0f, 45.0f, 0.3f, 0.7f},
+    {{pico8::red, pico8::orange, pico8::pink, pico8::white}, 30.0f, 90.0f, 0.2f, 0.5f},
+};
+
+// Pulls particles down, in pixels per second squared.
+constexpr float ParticleGravity = 40.0f;
+
+// The fraction of its speed a particle keeps each second.
+constexpr float ParticleDrag = 0.1f;
+
+ParticlePool::ParticlePool(Allocator &allocator)
+: allocator(allocator)
+, capacity(0)
+, count(0)
+, x(nullptr)
+, y(nullptr)
+, vx(nullptr)
+, vy(nullptr)
+, life(nullptr)
+, color(nullptr)
+, offsets(nullptr)
+, colors(nullptr)
+, random()
+, peak(0)
+, dropped(0) {
+}
+
+ParticlePool::~ParticlePool() {
+    allocator.deallocate(x);
+    allocator.deallocate(y);
+    allocator.deallocate(vx);
+    allocator.deallocate(vy);
+    allocator.deallocate(life);
+    allocator.deallocate(color);
+    allocator.deallocate(offsets);
+    allocator.deallocate(colors);
+}
+
+namespace particles {
+
+void init(ParticlePool &pool, uint32_t capacity, uint32_t seed) {
+    Allocator &a = pool.allocator;
+
+    a.deallocate(pool.x);
+    a.deallocate(pool.y);
+    a.deallocate(pool.vx);
+    a.deallocate(pool.vy);
+    a.deallocate(pool.life);
+    a.deallocate(pool.color);
+    a.deallocate(pool.offsets);
+    a.deallocate(pool.colors);
+
+    // Aligned for the widest vector loads.
+    const uint32_t align = 32;
+
+    pool.capacity = capacity;
+    pool.count = 0;
+    pool.x = (float *)a.allocate(capacity * sizeof(float), align);
+    pool.y = (float *)a.allocate(capacity * sizeof(float), align);
+    pool.vx = (float *)a.allocate(capacity * sizeof(float), align);
+    pool.vy = (float *)a.allocate(capacity * sizeof(float), align);
+    pool.life = (float *)a.allocate(capacity * sizeof(float), align);
+    pool.color = (uint8_t *)a.allocate(capacity, align);
+    pool.offsets = (uint32_t *)a.allocate(capacity * sizeof(uint32_t), align);
+    pool.colors = (uint8_t *)a.allocate(capacity, align);
+    pool.peak = 0;
+    pool.dropped = 0;
+
+    rnd_pcg_seed(&pool.random, seed);
+}
+
+void burst(ParticlePool &pool, ParticleEffect effect, float x, float y, uint32_t count) {
+    const ParticleLook &look = looks[(int)effect];
+
+    if (pool.count + count > pool.capacity) {
+        pool.dropped += pool.count + count - pool.capacity;
+        count = pool.capacity - pool.count;
+    }
+
+    for (uint32_t i = pool.count; i < pool.count + count; ++i) {
+        float angle = rnd_pcg_nextf(&pool.random) * 6.2831853f;
+        float speed = look.min_speed + (look.max_speed - look.min_speed) * rnd_pcg_nextf(&pool.random);
+
+        pool.x[i] = x;
+        pool.y[i] = y;
+        pool.vx[i] = cosf(angle) * speed;
+        pool.vy[i] = sinf(angle) * speed;
+        pool.life[i] = look.min_life + (look.max_life - look.min_life) * rnd_pcg_nextf(&pool.random);
+        pool.color[i] = look.colors[rnd_pcg_range(&pool.random, 0, 3)];
+    }
+
+    pool.count += count;
+    pool.peak = pool.count > pool.peak ? pool.count : pool.peak;
+}
+
+void update(ParticlePool &pool, float dt, int32_t width, int32_t height) {
+    const uint32_t count = pool.count;
+
+    float *__restrict x = pool.x;
+    float *__restrict y = pool.y;
+    float *__restrict vx = pool.vx;
+    float *__restrict vy = pool.vy;
+    float *__restrict life = pool.life;
+
+    // Linear in dt rather than a power, close enough at frame rates.
+    const float keep = 1.0f - (1.0f - ParticleDrag) * dt;
+    const float fall = ParticleGravity * dt;
+
+    // Straight loops with no branches, which the compiler vectorizes.
+    for (uint32_t i = 0; i < count; ++i) {
+        vx[i] = vx[i] * keep;
+        vy[i] = vy[i] * keep + fall;
+        x[i] += vx[i] * dt;
+        y[i] += vy[i] * dt;
+        life[i] -= dt;
+    }
+
+    // Swap the dead with the last live particle. Only the dead pay for the move.
+    const float w = (float)width;
+    const float h = (float)height;
+    uint32_t live = count;
+    uint32_t i = 0;
+
+    while (i < live) {
+        if (life[i] > 0.0f && x[i] >= 0.0f && y[i] >= 0.0f && x[i] < w && y[i] < h) {
+            ++i;
+            continue;
+        }
+
+        --live;
+        x[i] = x[live];
+        y[i] = y[live];
+        vx[i] = vx[live];
+        vy[i] = vy[live];
+        life[i] = life[live];
+        pool.color[i] = pool.color[live];
+    }
+
+    pool.count = live;
+}
+
+void draw(ParticlePool &pool, IndexedCanvas &canvas, bool thin, uint64_t frame) {
+    const float *__restrict x = pool.x;
+    const float *__restrict y = pool.y;
+    uint32_t *__restrict offsets = pool.offsets;
+
+    // Every particle is on the canvas after an update, so there is nothing to clip.
+    const int32_t width = canvas.width;
+
+    if (!thin) {
+        for (uint32_t i = 0; i < pool.count; ++i) {
+            offsets[i] = (uint32_t)((int32_t)y[i] * width + (int32_t)x[i]);
+        }
+
+        indexed_canvas::points(canvas, offsets, pool.color, pool.count);
+        return;
+    }
+
+    uint32_t drawn = 0;
+    for (uint32_t i = (uint32_t)(frame & 1); i < pool.count; i += 2) {
+        offsets[drawn] = (uint32_t)((int32_t)y[i] * width + (int32_t)x[i]);
+        pool.colors[drawn] = pool.color[i];
+        ++drawn;
+    }
+
+    indexed_canvas::points(canvas, offsets, pool.colors, drawn);
+}
+
+} // namespace particles
+
+} // namespace game
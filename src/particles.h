@@ -0,0 +1,112 @@
+#pragma once
+
+#include "util.h"
+
+#pragma warning(push, 0)
+#include "rnd.h"
+
+#include <memory_types.h>
+#include <stdint.h>
+#pragma warning(pop)
+
+namespace game {
+
+struct IndexedCanvas;
+
+/// The kinds of particle bursts, which pick their colors, speed and life.
+enum class ParticleEffect : uint8_t {
+    // Food eaten.
+    Pickup,
+
+    // A bullet hit a player.
+    Hit,
+
+    COUNT,
+};
+
+/**
+ * @brief A fixed pool of particles for effects, stored as an array per field.
+ *
+ * Particles are only drawn, never simulated, so they aren't part of the world
+ * and don't need to be deterministic. Each field is its own array so updating
+ * is a few straight loops over floats the compiler can vectorize, and drawing
+ * turns positions into canvas offsets in one loop and writes them as a batch.
+ *
+ * Dead particles are swapped with the last live one, so the live particles
+ * stay packed at the front in no particular order. Sized once, so bursts never
+ * allocate; a burst into a full pool drops what doesn't fit.
+ */
+struct ParticlePool {
+    ParticlePool(foundation::Allocator &allocator);
+    ~ParticlePool();
+    DELETE_COPY_AND_MOVE(ParticlePool)
+
+    foundation::Allocator &allocator;
+    uint32_t capacity;
+    uint32_t count;
+
+    // Position and velocity in pixels and pixels per second, and the seconds left to live.
+    float *x;
+    float *y;
+    float *vx;
+    float *vy;
+    float *life;
+    uint8_t *color;
+
+    // Scratch for drawing, the canvas offset and color of each particle drawn.
+    uint32_t *offsets;
+    uint8_t *colors;
+
+    // Only for the look of bursts.
+    rnd_pcg_t random;
+
+    // Counters
+    uint32_t peak;
+    uint32_t dropped;
+};
+
+namespace particles {
+
+/**
+ * @brief Allocates a pool's storage and empties it.
+ *
+ * @param pool The pool.
+ * @param capacity The most live particles.
+ * @param seed The seed of the bursts' random spread.
+ */
+void init(ParticlePool &pool, uint32_t capacity, uint32_t seed);
+
+/**
+ * @brief Spawns particles flying out from a point.
+ *
+ * @param pool The pool.
+ * @param effect The kind of burst.
+ * @param x The point, in canvas pixels.
+ * @param y The point, in canvas pixels.
+ * @param count The number of particles, as many as fit.
+ */
+void burst(ParticlePool &pool, ParticleEffect effect, float x, float y, uint32_t count);
+
+/**
+ * @brief Moves the particles and removes the ones that died or left the canvas.
+ *
+ * @param pool The pool.
+ * @param dt The time since the last update, in seconds.
+ * @param width The width of the canvas.
+ * @param height The height of the canvas.
+ */
+void update(ParticlePool &pool, float dt, int32_t width, int32_t height);
+
+/**
+ * @brief Draws the particles as single pixels.
+ *
+ * @param pool The pool, updated for the canvas's size so every particle is on it.
+ * @param canvas The canvas.
+ * @param thin Whether to draw only every other particle, a different half each frame.
+ * @param frame The number of the frame, which half to draw.
+ */
+void draw(ParticlePool &pool, IndexedCanvas &canvas, bool thin, uint64_t frame);
+
+} // namespace particles
+
+} // namespace game
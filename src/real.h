@@ -0,0 +1,97 @@
+#pragma once
+
+#include "fixed.h"
+
+#pragma warning(push, 0)
+#include <cmath>
+
+#include <engine/math.inl>
+#include <stdint.h>
+#pragma warning(pop)
+
+namespace game {
+
+/**
+ * @brief The math a simulation scalar supports, specialized for float and Fixed.
+ *
+ * The simulation is written once against these, and the scalar it runs on is
+ * chosen at compile time by FIXED_POINT.
+ */
+template <typename T>
+struct Scalar;
+
+template <>
+struct Scalar<float> {
+    static float sin(float x) { return sinf(x); }
+    static float cos(float x) { return cosf(x); }
+    static float sqrt(float x) { return sqrtf(x); }
+};
+
+template <>
+struct Scalar<Fixed> {
+    static Fixed sin(Fixed x) { return fixed::sin(x); }
+    static Fixed cos(Fixed x) { return fixed::cos(x); }
+    static Fixed sqrt(Fixed x) { return fixed::sqrt(x); }
+};
+
+#if defined(FIXED_POINT)
+/// The scalar of the simulation. Fixed point, so every build simulates bit-exact.
+typedef Fixed Real;
+#else
+/// The scalar of the simulation. Float, which only simulates bit-exact between identical builds.
+typedef float Real;
+#endif
+
+template <typename T>
+struct Vec2 {
+    T x;
+    T y;
+};
+
+typedef Vec2<Real> Vector2r;
+
+namespace real {
+
+/// Pi in any scalar.
+template <typename T>
+constexpr T pi() {
+    return T(3.14159265358979323846);
+}
+
+template <typename T>
+T sin(T x) {
+    return Scalar<T>::sin(x);
+}
+
+template <typename T>
+T cos(T x) {
+    return Scalar<T>::cos(x);
+}
+
+template <typename T>
+T sqrt(T x) {
+    return Scalar<T>::sqrt(x);
+}
+
+/// Wraps an angle into [0, 2 pi), so angles that keep turning stay in range and precise.
+template <typename T>
+T wrap_angle(T angle) {
+    const T turn = pi<T>() * 2;
+    while (angle >= turn) {
+        angle -= turn;
+    }
+    while (angle < 0) {
+        angle += turn;
+    }
+    return angle;
+}
+
+/// Returns whether a point is inside a rect, like math::is_inside.
+template <typename T>
+bool is_inside(const math::Rect &rect, const Vec2<T> &point) {
+    return point.x >= rect.origin.x && point.y >= rect.origin.y && point.x < rect.origin.x + rect.size.x && point.y < rect.origin.y + rect.size.y;
+}
+
+} // namespace real
+
+} // namespace game
@@ -0,0 +1,733 @@
+#include "replay.h"
+
+#pragma warning(push, 0)
+#include <cassert>
+#include <cstring>
+
+#include <array.h>
+
+#include <engine/log.h>
+#pragma warning(pop)
+
+namespace game {
+
+using namespace foundation;
+
+constexpr uint32_t ReplayMagic = 0x50524853; // SHRP
+constexpr uint16_t ReplayVersion = 4;
+constexpr uint32_t ReplayHeaderSize = 32;
+
+enum class EntryKind : uint32_t {
+    Input = 0,
+    Keyframe = 1,
+    End = 2,
+};
+
+static uint8_t build_flags() {
+#if defined(FIXED_POINT)
+    return (uint8_t)ReplayFlags::FixedPoint;
+#else
+    return 0;
+#endif
+}
+
+ReplayWriter::ReplayWriter()
+: file(nullptr)
+, buffer()
+, buffered(0)
+, player_count(0)
+, keyframe_interval(ReplayKeyframeInterval)
+, tick(0)
+, entry_tick(0)
+, held()
+, bytes_written(0)
+, keyframes(0) {
+}
+
+ReplayWriter::~ReplayWriter() {
+    replay::close(*this);
+}
+
+ReplayReader::ReplayReader(Allocator &allocator)
+: file(nullptr)
+, header()
+, keyframes(allocator)
+, end_tick(0)
+, tick(0)
+, entry_tick(0)
+, entry_kind(0)
+, held()
+, at_keyframe(false)
+, keyframe_checksum(0)
+, snapshot(allocator) {
+}
+
+ReplayReader::~ReplayReader() {
+    replay::close(*this);
+}
+
+// Writing
+
+static void flush(ReplayWriter &writer) {
+    if (writer.buffered > 0) {
+        fwrite(writer.buffer, 1, writer.buffered, writer.file);
+        writer.bytes_written += writer.buffered;
+        writer.buffered = 0;
+    }
+}
+
+static void put(ReplayWriter &writer, const void *data, uint32_t size) {
+    if (writer.buffered + size > ReplayBufferSize) {
+        flush(writer);
+    }
+
+    // Too big to buffer, like the bullets of a keyframe with a large pool.
+    if (size > ReplayBufferSize) {
+        fwrite(data, 1, size, writer.file);
+        writer.bytes_written += size;
+        return;
+    }
+
+    memcpy(writer.buffer + writer.buffered, data, size);
+    writer.buffered += size;
+}
+
+template <typename T>
+static void put(ReplayWriter &writer, const T &value) {
+    put(writer, &value, sizeof(value));
+}
+
+// Counts the bytes of a keyframe instead of writing them, so its size can be written in front of it.
+struct KeyframeSize {
+    uint64_t size;
+};
+
+static void put(KeyframeSize &counter, const void *data, uint32_t size) {
+    (void)data;
+    counter.size += size;
+}
+
+template <typename Out>
+static void put_varint(Out &out, uint64_t value) {
+    uint8_t bytes[10];
+    uint32_t count = 0;
+
+    do {
+        uint8_t byte = value & 0x7f;
+        value >>= 7;
+        bytes[count++] = value ? (uint8_t)(byte | 0x80) : byte;
+    } while (value);
+
+    put(out, bytes, count);
+}
+
+// Signed values zigzag, so small negative numbers stay short.
+template <typename Out>
+static void put_int(Out &out, int32_t value) {
+    put_varint(out, (uint64_t)(((uint32_t)value << 1) ^ (uint32_t)(value >> 31)));
+}
+
+template <typename Out>
+static void put_u8(Out &out, uint8_t value) {
+    put(out, &value, 1);
+}
+
+template <typename Out>
+static void put_u64(Out &out, uint64_t value) {
+    uint8_t bytes[8];
+    for (uint32_t i = 0; i < 8; ++i) {
+        bytes[i] = (uint8_t)(value >> (i * 8));
+    }
+
+    put(out, bytes, 8);
+}
+
+// Fixed point values are integers and zigzag. Floats rarely have short bit patterns, so they're four bytes.
+template <typename Out>
+static void put_real(Out &out, Real value) {
+#if defined(FIXED_POINT)
+    put_int(out, value.raw);
+#else
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+
+    uint8_t bytes[4] = {(uint8_t)bits, (uint8_t)(bits >> 8), (uint8_t)(bits >> 16), (uint8_t)(bits >> 24)};
+    put(out, bytes, 4);
+#endif
+}
+
+template <typename Out>
+static void put_vec(Out &out, const Vector2r &value) {
+    put_real(out, value.x);
+    put_real(out, value.y);
+}
+
+template <typename Out>
+static void put_rect(Out &out, const math::Rect &rect) {
+    put_int(out, rect.origin.x);
+    put_int(out, rect.origin.y);
+    put_int(out, rect.size.x);
+    put_int(out, rect.size.y);
+}
+
+// The fields of a keyframe one at a time, independent of how the structs are laid out.
+template <typename Out>
+static void put_world(Out &out, const World &world, const TickInput *held) {
+    put_u64(out, world::checksum(world));
+    put_varint(out, world.tick);
+    put_u64(out, world.random.state[0]);
+    put_u64(out, world.random.state[1]);
+
+    for (const Player &player : world.players) {
+        put_int(out, player.score);
+        put_int(out, player.hits);
+        put_vec(out, player.pos);
+        put_vec(out, player.vel);
+        put_real(out, player.speed_incr);
+        put_real(out, player.max_speed);
+        put_real(out, player.drag);
+        put_rect(out, player.bounds);
+    }
+
+    put_varint(out, world.enemy_count);
+    for (uint32_t i = 0; i < world.enemy_count; ++i) {
+        const Enemy &enemy = world.enemies[i];
+        put_vec(out, enemy.pos);
+        put_real(out, enemy.speed);
+        put_real(out, enemy.path);
+        put_real(out, enemy.rot);
+        put_real(out, enemy.rot_speed);
+        put_real(out, enemy.bullet_rate);
+        put_real(out, enemy.bullet_cooldown);
+        put_real(out, enemy.bullet_speed);
+        put_rect(out, enemy.bounds);
+        put_int(out, enemy.sprite);
+        put_varint(out, enemy.life);
+        put_u8(out, (uint8_t)enemy.curve);
+        put_u8(out, (uint8_t)enemy.pattern);
+    }
+
+    put_varint(out, world.spawns.count);
+    for (uint32_t i = 0; i < world.spawns.count; ++i) {
+        const Spawn &spawn = world.spawns.items[i];
+        put_varint(out, spawn.tick);
+        put_varint(out, spawn.order);
+        put_varint(out, spawn.repeat);
+        put_varint(out, spawn.life);
+        put_real(out, spawn.phase);
+        put_u8(out, spawn.type);
+        put_u8(out, (uint8_t)spawn.curve);
+        put_u8(out, (uint8_t)spawn.pattern);
+    }
+
+    const Food &food = world.food;
+    put_u8(out, food.spawned ? 1 : 0);
+    put_real(out, food.grace_timer);
+    put_real(out, food.grace);
+    put_vec(out, food.pos);
+    put_int(out, food.sprite);
+    put_rect(out, food.bounds);
+
+    put_varint(out, world.bullets.capacity);
+    put_u8(out, world.bullets.grow_pending ? 1 : 0);
+    put_varint(out, world.bullets.count);
+    for (uint32_t i = 0; i < world.bullets.count; ++i) {
+        const Bullet &bullet = bullet_pool::at(world.bullets, i);
+        put_vec(out, bullet.pos);
+        put_vec(out, bullet.vel);
+    }
+
+    put(out, held, PlayerMax * sizeof(TickInput));
+}
+
+static void put_entry(ReplayWriter &writer, EntryKind kind) {
+    put_varint(writer, (uint64_t)(writer.tick - writer.entry_tick) << 2 | (uint64_t)kind);
+    writer.entry_tick = writer.tick;
+}
+
+static void put_keyframe(ReplayWriter &writer, const World &world) {
+    KeyframeSize counter = {0};
+    put_world(counter, world, writer.held);
+
+    put_entry(writer, EntryKind::Keyframe);
+    put_varint(writer, counter.size);
+    put_world(writer, world, writer.held);
+
+    writer.keyframes++;
+}
+
+// Reading
+
+static bool get(ReplayReader &reader, void *data, uint32_t size) {
+    return fread(data, 1, size, reader.file) == size;
+}
+
+template <typename T>
+static bool get(ReplayReader &reader, T &value) {
+    return get(reader, &value, sizeof(value));
+}
+
+static bool get_varint(ReplayReader &reader, uint64_t &value) {
+    value = 0;
+
+    for (uint32_t shift = 0; shift < 64; shift += 7) {
+        int byte = fgetc(reader.file);
+        if (byte == EOF) {
+            return false;
+        }
+
+        value |= (uint64_t)(byte & 0x7f) << shift;
+        if ((byte & 0x80) == 0) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static bool get_int(ReplayReader &reader, int32_t &value) {
+    uint64_t zigzag;
+    if (!get_varint(reader, zigzag) || zigzag > UINT32_MAX) {
+        return false;
+    }
+
+    value = (int32_t)((uint32_t)zigzag >> 1 ^ (0U - ((uint32_t)zigzag & 1)));
+    return true;
+}
+
+static bool get_u32(ReplayReader &reader, uint32_t &value) {
+    uint64_t varint;
+    if (!get_varint(reader, varint) || varint > UINT32_MAX) {
+        return false;
+    }
+
+    value = (uint32_t)varint;
+    return true;
+}
+
+static bool get_u8(ReplayReader &reader, uint8_t &value) {
+    int byte = fgetc(reader.file);
+    value = (uint8_t)byte;
+    return byte != EOF;
+}
+
+static bool get_u64(ReplayReader &reader, uint64_t &value) {
+    uint8_t bytes[8];
+    if (!get(reader, bytes, 8)) {
+        return false;
+    }
+
+    value = 0;
+    for (uint32_t i = 0; i < 8; ++i) {
+        value |= (uint64_t)bytes[i] << (i * 8);
+    }
+
+    return true;
+}
+
+static bool get_real(ReplayReader &reader, Real &value) {
+#if defined(FIXED_POINT)
+    int32_t raw;
+    if (!get_int(reader, raw)) {
+        return false;
+    }
+
+    value = Fixed::from_raw(raw);
+    return true;
+#else
+    uint8_t bytes[4];
+    if (!get(reader, bytes, 4)) {
+        return false;
+    }
+
+    uint32_t bits = (uint32_t)bytes[0] | (uint32_t)bytes[1] << 8 | (uint32_t)bytes[2] << 16 | (uint32_t)bytes[3] << 24;
+    memcpy(&value, &bits, sizeof(bits));
+    return true;
+#endif
+}
+
+static bool get_vec(ReplayReader &reader, Vector2r &value) {
+    return get_real(reader, value.x) && get_real(reader, value.y);
+}
+
+static bool get_rect(ReplayReader &reader, math::Rect &rect) {
+    return get_int(reader, rect.origin.x) && get_int(reader, rect.origin.y) && get_int(reader, rect.size.x) && get_int(reader, rect.size.y);
+}
+
+// Reads an enum stored as a byte, which has to be one of its values.
+template <typename E>
+static bool get_enum(ReplayReader &reader, E &value) {
+    uint8_t byte;
+    if (!get_u8(reader, byte) || byte >= (uint8_t)E::COUNT) {
+        return false;
+    }
+
+    value = (E)byte;
+    return true;
+}
+
+// Reads the fields put_world wrote into a snapshot, checking the counts against what a world holds.
+static bool get_world(ReplayReader &reader, WorldSnapshot &snapshot, uint32_t max_capacity) {
+    uint64_t checksum;
+    uint64_t random[2];
+    if (!get_u64(reader, checksum) || !get_u32(reader, snapshot.tick) || !get_u64(reader, random[0]) || !get_u64(reader, random[1])) {
+        return false;
+    }
+    snapshot.random.state[0] = random[0];
+    snapshot.random.state[1] = random[1];
+
+    for (Player &player : snapshot.players) {
+        if (!get_int(reader, player.score) || !get_int(reader, player.hits) || !get_vec(reader, player.pos) || !get_vec(reader, player.vel) ||
+            !get_real(reader, player.speed_incr) || !get_real(reader, player.max_speed) || !get_real(reader, player.drag) ||
+            !get_rect(reader, player.bounds)) {
+            return false;
+        }
+    }
+
+    if (!get_u32(reader, snapshot.enemy_count) || snapshot.enemy_count > EnemyMax) {
+        return false;
+    }
+
+    for (uint32_t i = 0; i < snapshot.enemy_count; ++i) {
+        Enemy &enemy = snapshot.enemies[i];
+        if (!get_vec(reader, enemy.pos) || !get_real(reader, enemy.speed) || !get_real(reader, enemy.path) || !get_real(reader, enemy.rot) ||
+            !get_real(reader, enemy.rot_speed) || !get_real(reader, enemy.bullet_rate) || !get_real(reader, enemy.bullet_cooldown) ||
+            !get_real(reader, enemy.bullet_speed) || !get_rect(reader, enemy.bounds) || !get_int(reader, enemy.sprite) ||
+            !get_u32(reader, enemy.life) || !get_enum(reader, enemy.curve) || !get_enum(reader, enemy.pattern)) {
+            return false;
+        }
+    }
+
+    if (!get_u32(reader, snapshot.spawns.count) || snapshot.spawns.count > SpawnMax) {
+        return false;
+    }
+
+    for (uint32_t i = 0; i < snapshot.spawns.count; ++i) {
+        Spawn &spawn = snapshot.spawns.items[i];
+        spawn = Spawn();
+        if (!get_u32(reader, spawn.tick) || !get_u32(reader, spawn.order) || !get_u32(reader, spawn.repeat) || !get_u32(reader, spawn.life) ||
+            !get_real(reader, spawn.phase) || !get_u8(reader, spawn.type) || spawn.type >= EnemyTypeMax || !get_enum(reader, spawn.curve) ||
+            !get_enum(reader, spawn.pattern)) {
+            return false;
+        }
+    }
+
+    Food &food = snapshot.food;
+    uint8_t spawned;
+    if (!get_u8(reader, spawned) || !get_real(reader, food.grace_timer) || !get_real(reader, food.grace) || !get_vec(reader, food.pos) ||
+        !get_int(reader, food.sprite) || !get_rect(reader, food.bounds)) {
+        return false;
+    }
+    food.spawned = spawned != 0;
+
+    uint8_t grow_pending;
+    uint32_t count;
+    if (!get_u32(reader, snapshot.bullet_capacity) || snapshot.bullet_capacity > max_capacity ||
+        (snapshot.bullet_capacity & (snapshot.bullet_capacity - 1)) != 0 || !get_u8(reader, grow_pending) || !get_u32(reader, count) ||
+        count > snapshot.bullet_capacity) {
+        return false;
+    }
+    snapshot.bullet_grow_pending = grow_pending != 0;
+
+    array::resize(snapshot.bullets, count);
+    for (uint32_t i = 0; i < count; ++i) {
+        Bullet &bullet = snapshot.bullets[i];
+        if (!get_vec(reader, bullet.pos) || !get_vec(reader, bullet.vel)) {
+            return false;
+        }
+    }
+
+    return get(reader, reader.held, PlayerMax * sizeof(TickInput));
+}
+
+// Reads the header of the next entry. A recording cut short, by a crash say, ends at its last entry.
+static void get_entry(ReplayReader &reader) {
+    uint64_t value;
+    if (!get_varint(reader, value)) {
+        reader.entry_kind = (uint32_t)EntryKind::End;
+        return;
+    }
+
+    reader.entry_tick += (uint32_t)(value >> 2);
+    reader.entry_kind = (uint32_t)(value & 3);
+}
+
+static bool skip(ReplayReader &reader, uint64_t size) {
+    return fseek(reader.file, (long)size, SEEK_CUR) == 0;
+}
+
+namespace replay {
+
+bool open(ReplayWriter &writer, const char *path, const World &world, uint32_t seed, uint64_t config_hash, uint32_t keyframe_interval) {
+    assert(world.tick == 0);
+
+    close(writer);
+
+    writer.file = fopen(path, "wb");
+    if (!writer.file) {
+        log_error("Could not create replay %s", path);
+        return false;
+    }
+
+    writer.buffered = 0;
+    writer.player_count = world.player_count;
+    writer.keyframe_interval = keyframe_interval > 0 ? keyframe_interval : ReplayKeyframeInterval;
+    writer.tick = 0;
+    writer.entry_tick = 0;
+    memset(writer.held, 0, sizeof(writer.held));
+    writer.bytes_written = 0;
+    writer.keyframes = 0;
+
+    put(writer, ReplayMagic);
+    put(writer, ReplayVersion);
+    put(writer, (uint8_t)world.player_count);
+    put(writer, build_flags());
+    put(writer, seed);
+    put(writer, world.width);
+    put(writer, world.height);
+    put(writer, writer.keyframe_interval);
+    put(writer, config_hash);
+
+    log_info("Recording replay %s", path);
+
+    return true;
+}
+
+void record(ReplayWriter &writer, const World &world, const TickInput *inputs) {
+    if (!writer.file) {
+        return;
+    }
+
+    assert(world.tick == writer.tick);
+
+    if (writer.tick % writer.keyframe_interval == 0) {
+        put_keyframe(writer, world);
+    }
+
+    for (uint32_t player = 0; player < writer.player_count; ++player) {
+        TickInput changed = inputs[player] ^ writer.held[player];
+        if (changed) {
+            put_entry(writer, EntryKind::Input);
+            put(writer, (uint8_t)(player << 5 | changed));
+            writer.held[player] = inputs[player];
+        }
+    }
+
+    writer.tick++;
+}
+
+void close(ReplayWriter &writer) {
+    if (!writer.file) {
+        return;
+    }
+
+    put_entry(writer, EntryKind::End);
+    flush(writer);
+    fclose(writer.file);
+    writer.file = nullptr;
+
+    log_info("Recorded %u ticks in %llu bytes", writer.tick, (unsigned long long)writer.bytes_written);
+}
+
+bool open(ReplayReader &reader, const char *path) {
+    close(reader);
+
+    reader.file = fopen(path, "rb");
+    if (!reader.file) {
+        log_error("Could not open replay %s", path);
+        return false;
+    }
+
+    ReplayHeader &header = reader.header;
+    bool read = get(reader, header.magic)
+                && get(reader, header.version)
+                && get(reader, header.player_count)
+                && get(reader, header.flags)
+                && get(reader, header.seed)
+                && get(reader, header.width)
+                && get(reader, header.height)
+                && get(reader, header.keyframe_interval)
+                && get(reader, header.config_hash);
+
+    const char *error = nullptr;
+    if (!read || header.magic != ReplayMagic) {
+        error = "isn't a replay";
+    } else if (header.version != ReplayVersion) {
+        error = "is a different version";
+    } else if (header.flags != build_flags()) {
+        error = "was recorded by a build with a different simulation";
+    } else if (header.player_count == 0 || header.player_count > PlayerMax) {
+        error = "has an invalid player count";
+    }
+
+    if (error) {
+        log_error("Replay %s %s", path, error);
+        close(reader);
+        return false;
+    }
+
+    // Find the keyframes, skipping over everything else.
+    array::clear(reader.keyframes);
+    reader.entry_tick = 0;
+
+    while (true) {
+        get_entry(reader);
+
+        EntryKind kind = (EntryKind)reader.entry_kind;
+        if (kind == EntryKind::End) {
+            break;
+        }
+
+        if (kind == EntryKind::Input) {
+            if (fgetc(reader.file) == EOF) {
+                break;
+            }
+        } else if (kind == EntryKind::Keyframe) {
+            ReplayKeyframe keyframe = {reader.entry_tick, 0, (uint64_t)ftell(reader.file)};
+
+            uint64_t size;
+            if (!get_varint(reader, size) || !skip(reader, size)) {
+                break;
+            }
+
+            array::push_back(reader.keyframes, keyframe);
+        } else {
+            log_error("Replay %s is corrupt at tick %u", path, reader.entry_tick);
+            break;
+        }
+    }
+
+    reader.end_tick = reader.entry_tick;
+
+    if (array::empty(reader.keyframes) || reader.keyframes[0].tick != 0) {
+        log_error("Replay %s has no first keyframe", path);
+        close(reader);
+        return false;
+    }
+
+    return true;
+}
+
+// Rewinds to the first tick, once the world is initialized.
+static void to_first_tick(ReplayReader &reader) {
+    fseek(reader.file, ReplayHeaderSize, SEEK_SET);
+    reader.tick = 0;
+    reader.entry_tick = 0;
+    memset(reader.held, 0, sizeof(reader.held));
+    reader.at_keyframe = false;
+
+    get_entry(reader);
+}
+
+void start(ReplayReader &reader, World &world, const ini_t *config) {
+    assert(reader.file);
+
+    world::init(world, config, reader.header.width, reader.header.height, reader.header.seed, reader.header.player_count);
+    to_first_tick(reader);
+}
+
+void start(ReplayReader &reader, World &world, const ini_t *config, const WaveTable &waves) {
+    assert(reader.file);
+
+    world::init(world, config, waves, reader.header.width, reader.header.height, reader.header.seed, reader.header.player_count);
+    to_first_tick(reader);
+}
+
+bool next(ReplayReader &reader, TickInput *inputs) {
+    reader.at_keyframe = false;
+
+    if (reader.tick >= reader.end_tick) {
+        return false;
+    }
+
+    while (reader.entry_tick == reader.tick && (EntryKind)reader.entry_kind != EntryKind::End) {
+        if ((EntryKind)reader.entry_kind == EntryKind::Input) {
+            int byte = fgetc(reader.file);
+            uint32_t player = (uint32_t)byte >> 5;
+            if (byte == EOF || player >= PlayerMax) {
+                return false;
+            }
+
+            reader.held[player] ^= (TickInput)(byte & 0x1f);
+        } else {
+            uint64_t size;
+            if (!get_varint(reader, size) || size < sizeof(uint64_t) || !get_u64(reader, reader.keyframe_checksum) || !skip(reader, size - sizeof(uint64_t))) {
+                return false;
+            }
+
+            reader.at_keyframe = true;
+        }
+
+        get_entry(reader);
+    }
+
+    memcpy(inputs, reader.held, sizeof(reader.held));
+    reader.tick++;
+    return true;
+}
+
+bool seek(ReplayReader &reader, World &world, uint32_t tick) {
+    assert(reader.file);
+
+    if (tick > reader.end_tick) {
+        return false;
+    }
+
+    // The last keyframe at or before the tick.
+    uint32_t first = 0;
+    uint32_t last = array::size(reader.keyframes);
+    while (last - first > 1) {
+        uint32_t middle = (first + last) / 2;
+        if (reader.keyframes[middle].tick <= tick) {
+            first = middle;
+        } else {
+            last = middle;
+        }
+    }
+
+    const ReplayKeyframe &keyframe = reader.keyframes[first];
+
+    // Only jump when it's ahead of where the world is.
+    if (world.tick > tick || keyframe.tick > world.tick) {
+        WorldSnapshot &snapshot = reader.snapshot;
+
+        fseek(reader.file, (long)keyframe.offset, SEEK_SET);
+
+        uint64_t size;
+        bool read = get_varint(reader, size);
+        long fields = ftell(reader.file);
+        read = read && get_world(reader, snapshot, world.bullets.max_capacity);
+
+        if (!read || (uint64_t)(ftell(reader.file) - fields) != size) {
+            log_error("Replay keyframe at tick %u is corrupt", keyframe.tick);
+            return false;
+        }
+
+        world::restore(world, snapshot);
+
+        reader.tick = keyframe.tick;
+        reader.entry_tick = keyframe.tick;
+        get_entry(reader);
+    }
+
+    TickInput inputs[PlayerMax];
+    while (world.tick < tick) {
+        if (!next(reader, inputs)) {
+            return false;
+        }
+        world::tick(world, inputs);
+    }
+
+    return true;
+}
+
+void close(ReplayReader &reader) {
+    if (reader.file) {
+        fclose(reader.file);
+        reader.file = nullptr;
+    }
+}
+
+} // namespace replay
+
+} // namespace game
@@ -0,0 +1,201 @@
+#pragma once
+
+#include "util.h"
+#include "world.h"
+
+#pragma warning(push, 0)
+#include <collection_types.h>
+#include <cstdio>
+#include <memory_types.h>
+#include <stdint.h>
+#pragma warning(pop)
+
+namespace game {
+
+/// The size of a ReplayWriter's buffer. All the memory a writer uses, however long it records.
+constexpr uint32_t ReplayBufferSize = 64 * 1024;
+
+/// The default number of ticks between keyframes, a minute. [replay] keyframe_interval in the config overrides it.
+constexpr uint32_t ReplayKeyframeInterval = 3600;
+
+/**
+ * @brief The header at the start of a replay file.
+ *
+ * The rest of the file is a stream of entries, each a varint of the ticks since
+ * the previous entry shifted left by two and or:ed with its kind:
+ *
+ * - Input: one byte, the player in the top three bits and the buttons that
+ *   changed in the low five. Players hold their buttons until they change.
+ * - Keyframe: a varint size and the state of the world at the start of the
+ *   tick, with its checksum and the buttons held, to seek to. Written a field
+ *   at a time, not as structs: counts and integers as varints, signed ones
+ *   zigzagged, Reals as four little-endian bytes, or a zigzagged varint of the
+ *   raw value under FIXED_POINT.
+ * - End: the tick the replay ends at.
+ *
+ * Buttons change a few times a second, so a tick costs a fraction of a byte.
+ */
+struct ReplayHeader {
+    uint32_t magic;
+    uint16_t version;
+    uint8_t player_count;
+
+    // ReplayFlags of the build that recorded it.
+    uint8_t flags;
+
+    uint32_t seed;
+    int32_t width;
+    int32_t height;
+    uint32_t keyframe_interval;
+
+    // A hash of the config the replay was recorded with.
+    uint64_t config_hash;
+};
+
+/// Recorded in ReplayHeader::flags, since a replay only plays back on a build that simulates the same.
+enum class ReplayFlags : uint8_t {
+    FixedPoint = 1 << 0,
+};
+
+/**
+ * @brief Writes a replay as it's played, through a fixed size buffer.
+ *
+ */
+struct ReplayWriter {
+    ReplayWriter();
+    ~ReplayWriter();
+    DELETE_COPY_AND_MOVE(ReplayWriter)
+
+    FILE *file;
+    uint8_t buffer[ReplayBufferSize];
+    uint32_t buffered;
+
+    uint32_t player_count;
+    uint32_t keyframe_interval;
+
+    // The next tick to record, and the tick of the last entry.
+    uint32_t tick;
+    uint32_t entry_tick;
+
+    // The buttons each player holds.
+    TickInput held[PlayerMax];
+
+    // Counters
+    uint64_t bytes_written;
+    uint32_t keyframes;
+};
+
+/// The tick and file offset of a keyframe.
+struct ReplayKeyframe {
+    uint32_t tick;
+    uint32_t padding;
+    uint64_t offset;
+};
+
+/**
+ * @brief Plays back a replay a tick at a time, and seeks through its keyframes.
+ *
+ */
+struct ReplayReader {
+    ReplayReader(foundation::Allocator &allocator);
+    ~ReplayReader();
+    DELETE_COPY_AND_MOVE(ReplayReader)
+
+    FILE *file;
+    ReplayHeader header;
+
+    // Every keyframe in the file, found when it's opened.
+    foundation::Array<ReplayKeyframe> keyframes;
+
+    // The tick the replay ends at.
+    uint32_t end_tick;
+
+    // The next tick to play, and the next entry, which is at or after it.
+    uint32_t tick;
+    uint32_t entry_tick;
+    uint32_t entry_kind;
+
+    // The buttons each player holds.
+    TickInput held[PlayerMax];
+
+    // Whether the tick last played started with a keyframe, and its checksum.
+    bool at_keyframe;
+    uint64_t keyframe_checksum;
+
+    // Where keyframes are loaded into before restoring a world.
+    WorldSnapshot snapshot;
+};
+
+namespace replay {
+
+/**
+ * @brief Starts recording a replay of a world that was just initialized.
+ *
+ * @param writer The writer.
+ * @param path The file to write.
+ * @param world The world, at its first tick.
+ * @param seed The seed the world was initialized with.
+ * @param config_hash A hash of the config the world was initialized with.
+ * @param keyframe_interval The number of ticks between keyframes.
+ * @return true If the file could be created.
+ */
+bool open(ReplayWriter &writer, const char *path, const World &world, uint32_t seed, uint64_t config_hash, uint32_t keyframe_interval);
+
+/**
+ * @brief Records the inputs of a tick. Call before simulating it.
+ *
+ * @param writer The writer.
+ * @param world The world, at the start of the tick.
+ * @param inputs The input of each player.
+ */
+void record(ReplayWriter &writer, const World &world, const TickInput *inputs);
+
+/// Ends the replay and closes the file.
+void close(ReplayWriter &writer);
+
+/**
+ * @brief Opens a replay and finds its keyframes.
+ *
+ * @param reader The reader.
+ * @param path The file to read.
+ * @return true If the file is a replay this build can play.
+ */
+bool open(ReplayReader &reader, const char *path);
+
+/**
+ * @brief Initializes a world as the replay's was, and rewinds to the first tick.
+ *
+ * @param reader The reader.
+ * @param world The world to initialize.
+ * @param config The config to initialize the world with.
+ */
+void start(ReplayReader &reader, World &world, const ini_t *config);
+
+/// Initializes a world as the replay's was like start, with a wave table already read rather than the config's wave file.
+void start(ReplayReader &reader, World &world, const ini_t *config, const WaveTable &waves);
+
+/**
+ * @brief Returns the inputs of the next tick.
+ *
+ * @param reader The reader.
+ * @param inputs Receives the input of each player.
+ * @return true If there was a tick left.
+ */
+bool next(ReplayReader &reader, TickInput *inputs);
+
+/**
+ * @brief Moves a world to a tick, from the closest keyframe before it.
+ *
+ * @param reader The reader.
+ * @param world The world, started with start.
+ * @param tick The tick to seek to.
+ * @return true If the replay reaches the tick.
+ */
+bool seek(ReplayReader &reader, World &world, uint32_t tick);
+
+/// Closes the file.
+void close(ReplayReader &reader);
+
+} // namespace replay
+
+} // namespace game
@@ -3,7 +3,7 @@
           Licensing information can be found at the end of the file.
 ------------------------------------------------------------------------------
 
-rnd.h - v1.0 - Pseudo-random number generators for C/C++.
+rnd.h - v1.2 - Pseudo-random number generators for C/C++.
 
 Do this:
     #define RND_IMPLEMENTATION
@@ -28,24 +28,40 @@ void rnd_pcg_seed( rnd_pcg_t* pcg, RND_U32 seed );
 RND_U32 rnd_pcg_next( rnd_pcg_t* pcg );
 float rnd_pcg_nextf( rnd_pcg_t* pcg );
 int rnd_pcg_range( rnd_pcg_t* pcg, int min, int max );
+void rnd_pcg_fill_u32( rnd_pcg_t* pcg, RND_U32* out, int count );
+void rnd_pcg_fill_float( rnd_pcg_t* pcg, float* out, int count );
+void rnd_pcg_fill_range( rnd_pcg_t* pcg, int* out, int count, int min, int max );
+void rnd_pcg_advance( rnd_pcg_t* pcg, RND_U64 delta );
+void rnd_pcg_split( rnd_pcg_t* pcg, rnd_pcg_t* out );
 
 typedef struct rnd_well_t { RND_U32 state[ 17 ]; } rnd_well_t;
 void rnd_well_seed( rnd_well_t* well, RND_U32 seed );
 RND_U32 rnd_well_next( rnd_well_t* well );
 float rnd_well_nextf( rnd_well_t* well );
 int rnd_well_range( rnd_well_t* well, int min, int max );
+void rnd_well_fill_u32( rnd_well_t* well, RND_U32* out, int count );
+void rnd_well_fill_float( rnd_well_t* well, float* out, int count );
+void rnd_well_fill_range( rnd_well_t* well, int* out, int count, int min, int max );
 
 typedef struct rnd_gamerand_t { RND_U32 state[ 2 ]; } rnd_gamerand_t;
 void rnd_gamerand_seed( rnd_gamerand_t* gamerand, RND_U32 seed );
 RND_U32 rnd_gamerand_next( rnd_gamerand_t* gamerand );
 float rnd_gamerand_nextf( rnd_gamerand_t* gamerand );
 int rnd_gamerand_range( rnd_gamerand_t* gamerand, int min, int max );
+void rnd_gamerand_fill_u32( rnd_gamerand_t* gamerand, RND_U32* out, int count );
+void rnd_gamerand_fill_float( rnd_gamerand_t* gamerand, float* out, int count );
+void rnd_gamerand_fill_range( rnd_gamerand_t* gamerand, int* out, int count, int min, int max );
 
 typedef struct rnd_xorshift_t { RND_U64 state[ 2 ]; } rnd_xorshift_t;
 void rnd_xorshift_seed( rnd_xorshift_t* xorshift, RND_U64 seed );
 RND_U64 rnd_xorshift_next( rnd_xorshift_t* xorshift );
 float rnd_xorshift_nextf( rnd_xorshift_t* xorshift );
 int rnd_xorshift_range( rnd_xorshift_t* xorshift, int min, int max );
+void rnd_xorshift_fill_u64( rnd_xorshift_t* xorshift, RND_U64* out, int count );
+void rnd_xorshift_fill_float( rnd_xorshift_t* xorshift, float* out, int count );
+void rnd_xorshift_fill_range( rnd_xorshift_t* xorshift, int* out, int count, int min, int max );
+void rnd_xorshift_jump( rnd_xorshift_t* xorshift );
+void rnd_xorshift_split( rnd_xorshift_t* xorshift, rnd_xorshift_t* out );
 
 #endif /* rnd_h */
 
@@ -140,6 +156,36 @@ Note that when customizing the data type, you need to use the same definition in
 as it affect the declarations as well as the definitions.
 
 
+### Ranges
+
+The `range` functions map a random number to the requested range with a multiply and a shift (D. Lemire, "Fast Random
+Integer Generation in an Interval"), rejecting the few values which would otherwise make some results more likely than
+others. The results are exactly uniform for any range, and in the common case no division is performed.
+
+
+### Batch generation
+
+Each generator has a set of `fill` functions, which write `count` values to an array in one call. They produce exactly
+the same values, in the same order, as calling the corresponding single value function `count` times, and leave the 
+generator in the same state, so they can be mixed freely with the single value functions. 
+
+The PCG fill functions run four interleaved copies of the generator, each offset by one step and advanced by four steps
+at a time using the jump-ahead of the underlying LCG. The lanes are independent of each other, so the CPU overlaps 
+their multiplies rather than waiting on each state update in turn. They are scalar: the 64-bit multiply and the 
+variable rotate of the output have no SIMD form in baseline x86-64. The range fill maps each value as it is drawn, and 
+redraws a group of four the way the single value function does when one of them is rejected. The other generators 
+have inherently serial state updates, and their fill functions run the generator in a tight loop with the state held 
+in registers.
+
+
+### Parallel streams
+
+To give parallel workers their own non-overlapping sequences, PCG and XorShift can be split. Splitting copies the
+current generator into a new one, and then jumps the original generator far ahead: 2^48 steps for PCG, and 2^64 steps
+for XorShift. Calling split repeatedly on the same generator yields streams which won't overlap until one of them has 
+produced that many numbers. WELL and GameRand do not support jump-ahead; seed them with different seeds instead.
+
+
 ### The generators
 
 The library includes four different generators: PCG, WELL, GameRand and XorShift. They all have different 
@@ -229,6 +275,47 @@ rnd_pcg_range
 Returns a random integer N in the range: min <= N <= max, from the specified PCG generator.
 
 
+rnd_pcg_fill_u32
+----------------
+
+    void rnd_pcg_fill_u32( rnd_pcg_t* pcg, RND_U32* out, int count )
+
+Writes `count` random numbers, as returned by `rnd_pcg_next`, to `out`.
+
+
+rnd_pcg_fill_float
+------------------
+
+    void rnd_pcg_fill_float( rnd_pcg_t* pcg, float* out, int count )
+
+Writes `count` random floats, as returned by `rnd_pcg_nextf`, to `out`.
+
+
+rnd_pcg_fill_range
+------------------
+
+    void rnd_pcg_fill_range( rnd_pcg_t* pcg, int* out, int count, int min, int max )
+
+Writes `count` random integers, as returned by `rnd_pcg_range`, to `out`.
+
+
+rnd_pcg_advance
+---------------
+
+    void rnd_pcg_advance( rnd_pcg_t* pcg, RND_U64 delta )
+
+Advances the specified PCG generator by `delta` steps, in O(log delta) time. This is the same as calling 
+`rnd_pcg_next` `delta` times.
+
+
+rnd_pcg_split
+-------------
+
+    void rnd_pcg_split( rnd_pcg_t* pcg, rnd_pcg_t* out )
+
+Copies the specified PCG generator to `out`, and then advances it by 2^48 steps. 
+
+
 rnd_well_seed
 -------------
 
@@ -260,6 +347,30 @@ rnd_well_range
 Returns a random integer N in the range: min <= N <= max, from the specified WELL generator.
 
 
+rnd_well_fill_u32
+-----------------
+
+    void rnd_well_fill_u32( rnd_well_t* well, RND_U32* out, int count )
+
+Writes `count` random numbers, as returned by `rnd_well_next`, to `out`.
+
+
+rnd_well_fill_float
+-------------------
+
+    void rnd_well_fill_float( rnd_well_t* well, float* out, int count )
+
+Writes `count` random floats, as returned by `rnd_well_nextf`, to `out`.
+
+
+rnd_well_fill_range
+-------------------
+
+    void rnd_well_fill_range( rnd_well_t* well, int* out, int count, int min, int max )
+
+Writes `count` random integers, as returned by `rnd_well_range`, to `out`.
+
+
 rnd_gamerand_seed
 -----------------
 
@@ -292,6 +403,30 @@ rnd_gamerand_range
 Returns a random integer N in the range: min <= N <= max, from the specified GameRand generator.
 
 
+rnd_gamerand_fill_u32
+---------------------
+
+    void rnd_gamerand_fill_u32( rnd_gamerand_t* gamerand, RND_U32* out, int count )
+
+Writes `count` random numbers, as returned by `rnd_gamerand_next`, to `out`.
+
+
+rnd_gamerand_fill_float
+-----------------------
+
+    void rnd_gamerand_fill_float( rnd_gamerand_t* gamerand, float* out, int count )
+
+Writes `count` random floats, as returned by `rnd_gamerand_nextf`, to `out`.
+
+
+rnd_gamerand_fill_range
+-----------------------
+
+    void rnd_gamerand_fill_range( rnd_gamerand_t* gamerand, int* out, int count, int min, int max )
+
+Writes `count` random integers, as returned by `rnd_gamerand_range`, to `out`.
+
+
 rnd_xorshift_seed
 -----------------
 
@@ -324,6 +459,46 @@ rnd_xorshift_range
 Returns a random integer N in the range: min <= N <= max, from the specified XorShift generator.
 
 
+rnd_xorshift_fill_u64
+---------------------
+
+    void rnd_xorshift_fill_u64( rnd_xorshift_t* xorshift, RND_U64* out, int count )
+
+Writes `count` random numbers, as returned by `rnd_xorshift_next`, to `out`.
+
+
+rnd_xorshift_fill_float
+-----------------------
+
+    void rnd_xorshift_fill_float( rnd_xorshift_t* xorshift, float* out, int count )
+
+Writes `count` random floats, as returned by `rnd_xorshift_nextf`, to `out`.
+
+
+rnd_xorshift_fill_range
+-----------------------
+
+    void rnd_xorshift_fill_range( rnd_xorshift_t* xorshift, int* out, int count, int min, int max )
+
+Writes `count` random integers, as returned by `rnd_xorshift_range`, to `out`.
+
+
+rnd_xorshift_jump
+-----------------
+
+    void rnd_xorshift_jump( rnd_xorshift_t* xorshift )
+
+Advances the specified XorShift generator by 2^64 steps. This is the same as calling `rnd_xorshift_next` 2^64 times.
+
+
+rnd_xorshift_split
+------------------
+
+    void rnd_xorshift_split( rnd_xorshift_t* xorshift, rnd_xorshift_t* out )
+
+Copies the specified XorShift generator to `out`, and then advances it by 2^64 steps.
+
+
 */
 
 
@@ -336,6 +511,9 @@ Returns a random integer N in the range: min <= N <= max, from the specified Xor
 #ifdef RND_IMPLEMENTATION
 #undef RND_IMPLEMENTATION
 
+// Size of the scratch buffer used when converting batches of random numbers
+#define RND_INTERNAL_FILL_CHUNK 64
+
 // Convert a randomized RND_U32 value to a float value x in the range 0.0f <= x < 1.0f. Contributed by Jonatan Hedborg
 static float rnd_internal_float_normalized_from_u32( RND_U32 value )
     {
@@ -381,16 +559,45 @@ void rnd_pcg_seed( rnd_pcg_t* pcg, RND_U32 seed )
     }
 
 
-RND_U32 rnd_pcg_next( rnd_pcg_t* pcg )
+static RND_U32 rnd_internal_pcg_output( RND_U64 oldstate )
     {
-    RND_U64 oldstate = pcg->state[ 0 ];
-    pcg->state[ 0 ] = oldstate * 0x5851f42d4c957f2dULL + pcg->state[ 1 ];
     RND_U32 xorshifted = (RND_U32)( ( ( oldstate >> 18ULL)  ^ oldstate ) >> 27ULL );
     RND_U32 rot = (RND_U32)( oldstate >> 59ULL );
     return ( xorshifted >> rot ) | ( xorshifted << ( ( -(int) rot ) & 31 ) );
     }
 
 
+// Computes the multiplier and increment which advance a PCG state by delta steps
+static void rnd_internal_pcg_jump_coefficients( RND_U64 increment, RND_U64 delta, RND_U64* mult, RND_U64* plus )
+    {
+    RND_U64 acc_mult = 1ULL;
+    RND_U64 acc_plus = 0ULL;
+    RND_U64 cur_mult = 0x5851f42d4c957f2dULL;
+    RND_U64 cur_plus = increment;
+    while( delta > 0 )
+        {
+        if( delta & 1ULL )
+            {
+            acc_mult *= cur_mult;
+            acc_plus = acc_plus * cur_mult + cur_plus;
+            }
+        cur_plus = ( cur_mult + 1ULL ) * cur_plus;
+        cur_mult *= cur_mult;
+        delta >>= 1ULL;
+        }
+    *mult = acc_mult;
+    *plus = acc_plus;
+    }
+
+
+RND_U32 rnd_pcg_next( rnd_pcg_t* pcg )
+    {
+    RND_U64 oldstate = pcg->state[ 0 ];
+    pcg->state[ 0 ] = oldstate * 0x5851f42d4c957f2dULL + pcg->state[ 1 ];
+    return rnd_internal_pcg_output( oldstate );
+    }
+
+
 float rnd_pcg_nextf( rnd_pcg_t* pcg )
     {
     return rnd_internal_float_normalized_from_u32( rnd_pcg_next( pcg ) );
@@ -399,10 +606,151 @@ float rnd_pcg_nextf( rnd_pcg_t* pcg )
 
 int rnd_pcg_range( rnd_pcg_t* pcg, int min, int max )
     {
-    int const range = ( max - min ) + 1;
-    if( range <= 0 ) return min;
-    int const value = (int) ( rnd_pcg_nextf( pcg ) * range );
-    return min + value; 
+    if( max < min ) return min;
+    RND_U32 const range = (RND_U32) max - (RND_U32) min + 1U;
+    if( range == 0 ) return (int)( (RND_U32) rnd_pcg_next( pcg ) );
+    RND_U64 m = (RND_U64) rnd_pcg_next( pcg ) * range;
+    if( (RND_U32) m < range )
+        {
+        RND_U32 const threshold = ( 0U - range ) % range;
+        while( (RND_U32) m < threshold )
+            m = (RND_U64) rnd_pcg_next( pcg ) * range;
+        }
+    return (int)( (RND_U32) min + (RND_U32)( m >> 32 ) );
+    }
+
+
+// Four copies of a PCG generator, each a step ahead of the one before, which advance four steps at a time
+typedef struct rnd_internal_pcg_lanes_t
+    {
+    RND_U64 state[ 4 ];
+    RND_U64 mult;
+    RND_U64 plus;
+    } rnd_internal_pcg_lanes_t;
+
+
+static void rnd_internal_pcg_lanes_start( rnd_pcg_t const* pcg, rnd_internal_pcg_lanes_t* lanes )
+    {
+    lanes->state[ 0 ] = pcg->state[ 0 ];
+    lanes->state[ 1 ] = lanes->state[ 0 ] * 0x5851f42d4c957f2dULL + pcg->state[ 1 ];
+    lanes->state[ 2 ] = lanes->state[ 1 ] * 0x5851f42d4c957f2dULL + pcg->state[ 1 ];
+    lanes->state[ 3 ] = lanes->state[ 2 ] * 0x5851f42d4c957f2dULL + pcg->state[ 1 ];
+    rnd_internal_pcg_jump_coefficients( pcg->state[ 1 ], 4ULL, &lanes->mult, &lanes->plus );
+    }
+
+
+void rnd_pcg_fill_u32( rnd_pcg_t* pcg, RND_U32* out, int count )
+    {
+    int i = 0;
+    if( count >= 4 )
+        {
+        // The lanes live in locals, so their four multiply chains stay in registers and overlap
+        rnd_internal_pcg_lanes_t lanes;
+        rnd_internal_pcg_lanes_start( pcg, &lanes );
+        RND_U64 s0 = lanes.state[ 0 ], s1 = lanes.state[ 1 ], s2 = lanes.state[ 2 ], s3 = lanes.state[ 3 ];
+        RND_U64 const mult = lanes.mult, plus = lanes.plus;
+        for( ; i + 4 <= count; i += 4 )
+            {
+            out[ i + 0 ] = rnd_internal_pcg_output( s0 );
+            out[ i + 1 ] = rnd_internal_pcg_output( s1 );
+            out[ i + 2 ] = rnd_internal_pcg_output( s2 );
+            out[ i + 3 ] = rnd_internal_pcg_output( s3 );
+            s0 = s0 * mult + plus;
+            s1 = s1 * mult + plus;
+            s2 = s2 * mult + plus;
+            s3 = s3 * mult + plus;
+            }
+        pcg->state[ 0 ] = s0;
+        }
+
+    for( ; i < count; ++i )
+        out[ i ] = rnd_pcg_next( pcg );
+    }
+
+
+void rnd_pcg_fill_float( rnd_pcg_t* pcg, float* out, int count )
+    {
+    RND_U32 values[ RND_INTERNAL_FILL_CHUNK ];
+    for( int i = 0; i < count; i += RND_INTERNAL_FILL_CHUNK )
+        {
+        int n = count - i < RND_INTERNAL_FILL_CHUNK ? count - i : RND_INTERNAL_FILL_CHUNK;
+        rnd_pcg_fill_u32( pcg, values, n );
+        for( int j = 0; j < n; ++j )
+            out[ i + j ] = rnd_internal_float_normalized_from_u32( values[ j ] );
+        }
+    }
+
+
+void rnd_pcg_fill_range( rnd_pcg_t* pcg, int* out, int count, int min, int max )
+    {
+    if( max < min )
+        {
+        for( int i = 0; i < count; ++i ) out[ i ] = min;
+        return;
+        }
+    RND_U32 const range = (RND_U32) max - (RND_U32) min + 1U;
+    if( range == 0 )
+        {
+        for( int i = 0; i < count; ++i ) out[ i ] = (int) rnd_pcg_next( pcg );
+        return;
+        }
+    RND_U32 const threshold = ( 0U - range ) % range;
+    int i = 0;
+    if( count >= 4 )
+        {
+        // The lanes of rnd_pcg_fill_u32, with each value mapped to the range as it is drawn
+        rnd_internal_pcg_lanes_t lanes;
+        rnd_internal_pcg_lanes_start( pcg, &lanes );
+        RND_U64 s0 = lanes.state[ 0 ], s1 = lanes.state[ 1 ], s2 = lanes.state[ 2 ], s3 = lanes.state[ 3 ];
+        RND_U64 const mult = lanes.mult, plus = lanes.plus;
+        for( ; i + 4 <= count; i += 4 )
+            {
+            RND_U64 const m0 = (RND_U64) rnd_internal_pcg_output( s0 ) * range;
+            RND_U64 const m1 = (RND_U64) rnd_internal_pcg_output( s1 ) * range;
+            RND_U64 const m2 = (RND_U64) rnd_internal_pcg_output( s2 ) * range;
+            RND_U64 const m3 = (RND_U64) rnd_internal_pcg_output( s3 ) * range;
+            if( ( (RND_U32) m0 < threshold ) | ( (RND_U32) m1 < threshold ) | ( (RND_U32) m2 < threshold ) | ( (RND_U32) m3 < threshold ) )
+                {
+                // Rejected, so draw these four the way rnd_pcg_range does, from the first of them, and restart the lanes
+                pcg->state[ 0 ] = s0;
+                for( int j = 0; j < 4; ++j )
+                    out[ i + j ] = rnd_pcg_range( pcg, min, max );
+                rnd_internal_pcg_lanes_start( pcg, &lanes );
+                s0 = lanes.state[ 0 ];
+                s1 = lanes.state[ 1 ];
+                s2 = lanes.state[ 2 ];
+                s3 = lanes.state[ 3 ];
+                continue;
+                }
+            out[ i + 0 ] = (int)( (RND_U32) min + (RND_U32)( m0 >> 32 ) );
+            out[ i + 1 ] = (int)( (RND_U32) min + (RND_U32)( m1 >> 32 ) );
+            out[ i + 2 ] = (int)( (RND_U32) min + (RND_U32)( m2 >> 32 ) );
+            out[ i + 3 ] = (int)( (RND_U32) min + (RND_U32)( m3 >> 32 ) );
+            s0 = s0 * mult + plus;
+            s1 = s1 * mult + plus;
+            s2 = s2 * mult + plus;
+            s3 = s3 * mult + plus;
+            }
+        pcg->state[ 0 ] = s0;
+        }
+
+    for( ; i < count; ++i )
+        out[ i ] = rnd_pcg_range( pcg, min, max );
+    }
+
+
+void rnd_pcg_advance( rnd_pcg_t* pcg, RND_U64 delta )
+    {
+    RND_U64 mult, plus;
+    rnd_internal_pcg_jump_coefficients( pcg->state[ 1 ], delta, &mult, &plus );
+    pcg->state[ 0 ] = pcg->state[ 0 ] * mult + plus;
+    }
+
+
+void rnd_pcg_split( rnd_pcg_t* pcg, rnd_pcg_t* out )
+    {
+    *out = *pcg;
+    rnd_pcg_advance( pcg, 1ULL << 48ULL );
     }
 
 
@@ -440,10 +788,38 @@ float rnd_well_nextf( rnd_well_t* well )
 
 int rnd_well_range( rnd_well_t* well, int min, int max )
     {
-    int const range = ( max - min ) + 1;
-    if( range <= 0 ) return min;
-    int const value = (int) ( rnd_well_nextf( well ) * range );
-    return min + value; 
+    if( max < min ) return min;
+    RND_U32 const range = (RND_U32) max - (RND_U32) min + 1U;
+    if( range == 0 ) return (int)( (RND_U32) rnd_well_next( well ) );
+    RND_U64 m = (RND_U64) rnd_well_next( well ) * range;
+    if( (RND_U32) m < range )
+        {
+        RND_U32 const threshold = ( 0U - range ) % range;
+        while( (RND_U32) m < threshold )
+            m = (RND_U64) rnd_well_next( well ) * range;
+        }
+    return (int)( (RND_U32) min + (RND_U32)( m >> 32 ) );
+    }
+
+
+void rnd_well_fill_u32( rnd_well_t* well, RND_U32* out, int count )
+    {
+    for( int i = 0; i < count; ++i )
+        out[ i ] = rnd_well_next( well );
+    }
+
+
+void rnd_well_fill_float( rnd_well_t* well, float* out, int count )
+    {
+    for( int i = 0; i < count; ++i )
+        out[ i ] = rnd_internal_float_normalized_from_u32( rnd_well_next( well ) );
+    }
+
+
+void rnd_well_fill_range( rnd_well_t* well, int* out, int count, int min, int max )
+    {
+    for( int i = 0; i < count; ++i )
+        out[ i ] = rnd_well_range( well, min, max );
     }
 
 
@@ -472,10 +848,53 @@ float rnd_gamerand_nextf( rnd_gamerand_t* gamerand )
 
 int rnd_gamerand_range( rnd_gamerand_t* gamerand, int min, int max )
     {
-    int const range = ( max - min ) + 1;
-    if( range <= 0 ) return min;
-    int const value = (int) ( rnd_gamerand_nextf( gamerand ) * range );
-    return min + value; 
+    if( max < min ) return min;
+    RND_U32 const range = (RND_U32) max - (RND_U32) min + 1U;
+    if( range == 0 ) return (int)( (RND_U32) rnd_gamerand_next( gamerand ) );
+    RND_U64 m = (RND_U64) rnd_gamerand_next( gamerand ) * range;
+    if( (RND_U32) m < range )
+        {
+        RND_U32 const threshold = ( 0U - range ) % range;
+        while( (RND_U32) m < threshold )
+            m = (RND_U64) rnd_gamerand_next( gamerand ) * range;
+        }
+    return (int)( (RND_U32) min + (RND_U32)( m >> 32 ) );
+    }
+
+
+void rnd_gamerand_fill_u32( rnd_gamerand_t* gamerand, RND_U32* out, int count )
+    {
+    RND_U32 s0 = gamerand->state[ 0 ];
+    RND_U32 s1 = gamerand->state[ 1 ];
+    for( int i = 0; i < count; ++i )
+        {
+        s0 = ( s0 << 16 ) + ( s0 >> 16 );
+        s0 += s1;
+        s1 += s0;
+        out[ i ] = s0;
+        }
+    gamerand->state[ 0 ] = s0;
+    gamerand->state[ 1 ] = s1;
+    }
+
+
+void rnd_gamerand_fill_float( rnd_gamerand_t* gamerand, float* out, int count )
+    {
+    RND_U32 values[ RND_INTERNAL_FILL_CHUNK ];
+    for( int i = 0; i < count; i += RND_INTERNAL_FILL_CHUNK )
+        {
+        int n = count - i < RND_INTERNAL_FILL_CHUNK ? count - i : RND_INTERNAL_FILL_CHUNK;
+        rnd_gamerand_fill_u32( gamerand, values, n );
+        for( int j = 0; j < n; ++j )
+            out[ i + j ] = rnd_internal_float_normalized_from_u32( values[ j ] );
+        }
+    }
+
+
+void rnd_gamerand_fill_range( rnd_gamerand_t* gamerand, int* out, int count, int min, int max )
+    {
+    for( int i = 0; i < count; ++i )
+        out[ i ] = rnd_gamerand_range( gamerand, min, max );
     }
 
 
@@ -509,11 +928,89 @@ float rnd_xorshift_nextf( rnd_xorshift_t* xorshift )
 
 int rnd_xorshift_range( rnd_xorshift_t* xorshift, int min, int max )
     {
-    int const range = ( max - min ) + 1;
-    if( range <= 0 ) return min;
-    int const value = (int) ( rnd_xorshift_next( xorshift ) * range );
-    return min + value; 
-   }
+    if( max < min ) return min;
+    RND_U32 const range = (RND_U32) max - (RND_U32) min + 1U;
+    if( range == 0 ) return (int)( (RND_U32) ( rnd_xorshift_next( xorshift ) >> 32 ) );
+    RND_U64 m = (RND_U64) ( rnd_xorshift_next( xorshift ) >> 32 ) * range;
+    if( (RND_U32) m < range )
+        {
+        RND_U32 const threshold = ( 0U - range ) % range;
+        while( (RND_U32) m < threshold )
+            m = (RND_U64) ( rnd_xorshift_next( xorshift ) >> 32 ) * range;
+        }
+    return (int)( (RND_U32) min + (RND_U32)( m >> 32 ) );
+    }
+
+
+void rnd_xorshift_fill_u64( rnd_xorshift_t* xorshift, RND_U64* out, int count )
+    {
+    RND_U64 s0 = xorshift->state[ 0 ];
+    RND_U64 s1 = xorshift->state[ 1 ];
+    for( int i = 0; i < count; ++i )
+        {
+        RND_U64 x = s0;
+        RND_U64 const y = s1;
+        s0 = y;
+        x ^= x << 23;
+        x ^= x >> 17;
+        x ^= y ^ ( y >> 26 );
+        s1 = x;
+        out[ i ] = x + y;
+        }
+    xorshift->state[ 0 ] = s0;
+    xorshift->state[ 1 ] = s1;
+    }
+
+
+void rnd_xorshift_fill_float( rnd_xorshift_t* xorshift, float* out, int count )
+    {
+    RND_U64 values[ RND_INTERNAL_FILL_CHUNK ];
+    for( int i = 0; i < count; i += RND_INTERNAL_FILL_CHUNK )
+        {
+        int n = count - i < RND_INTERNAL_FILL_CHUNK ? count - i : RND_INTERNAL_FILL_CHUNK;
+        rnd_xorshift_fill_u64( xorshift, values, n );
+        for( int j = 0; j < n; ++j )
+            out[ i + j ] = rnd_internal_float_normalized_from_u32( (RND_U32)( values[ j ] >> 32 ) );
+        }
+    }
+
+
+void rnd_xorshift_fill_range( rnd_xorshift_t* xorshift, int* out, int count, int min, int max )
+    {
+    for( int i = 0; i < count; ++i )
+        out[ i ] = rnd_xorshift_range( xorshift, min, max );
+    }
+
+
+void rnd_xorshift_jump( rnd_xorshift_t* xorshift )
+    {
+    // x^(2^64) modulo the characteristic polynomial of the generator
+    static RND_U64 const jump[ 2 ] = { 0x8c405782bca686adULL, 0xc44f35946fef49c6ULL };
+
+    RND_U64 s0 = 0;
+    RND_U64 s1 = 0;
+    for( int i = 0; i < 2; ++i )
+        {
+        for( int b = 0; b < 64; ++b )
+            {
+            if( jump[ i ] & ( 1ULL << b ) )
+                {
+                s0 ^= xorshift->state[ 0 ];
+                s1 ^= xorshift->state[ 1 ];
+                }
+            rnd_xorshift_next( xorshift );
+            }
+        }
+    xorshift->state[ 0 ] = s0;
+    xorshift->state[ 1 ] = s1;
+    }
+
+
+void rnd_xorshift_split( rnd_xorshift_t* xorshift, rnd_xorshift_t* out )
+    {
+    *out = *xorshift;
+    rnd_xorshift_jump( xorshift );
+    }
 
 
 
@@ -521,6 +1018,8 @@ int rnd_xorshift_range( rnd_xorshift_t* xorshift, int min, int max )
 
 /*
 revision history:
+    1.2     unbiased integer range reduction for all generators
+    1.1     batch fill functions, jump-ahead and split for PCG and XorShift
     1.0     first publicly released version 
 */
 
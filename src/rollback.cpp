@@ -0,0 +1,102 @@
+#include "rollback.h"
+#include "input_log.h"
+#include "lockstep.h"
+
+#pragma warning(push, 0)
+#include <array.h>
+#include <memory.h>
+#pragma warning(pop)
+
+namespace game {
+
+using namespace foundation;
+
+Rollback::Rollback(Allocator &allocator)
+: allocator(allocator)
+, snapshots()
+, rollbacks(0)
+, resimulated(0)
+, deepest(0)
+, last_rollback_ns(0)
+, worst_rollback_ns(0) {
+    for (WorldSnapshot *&snapshot : snapshots) {
+        snapshot = MAKE_NEW(allocator, WorldSnapshot, allocator);
+    }
+}
+
+Rollback::~Rollback() {
+    for (WorldSnapshot *snapshot : snapshots) {
+        MAKE_DELETE(allocator, WorldSnapshot, snapshot);
+    }
+}
+
+namespace rollback {
+
+void init(Rollback &rollback, uint32_t max_bullets) {
+    for (WorldSnapshot *snapshot : rollback.snapshots) {
+        array::reserve(snapshot->bullets, max_bullets);
+        snapshot->tick = UINT32_MAX;
+    }
+
+    rollback.rollbacks = 0;
+    rollback.resimulated = 0;
+    rollback.deepest = 0;
+    rollback.last_rollback_ns = 0;
+    rollback.worst_rollback_ns = 0;
+}
+
+void save(Rollback &rollback, const World &world) {
+    world::save(world, *rollback.snapshots[world.tick % RollbackWindow]);
+}
+
+bool restore(Rollback &rollback, World &world, uint32_t tick) {
+    const WorldSnapshot &snapshot = *rollback.snapshots[tick % RollbackWindow];
+    if (snapshot.tick != tick) {
+        return false;
+    }
+
+    world::restore(world, snapshot);
+    return true;
+}
+
+void advance(Rollback &rollback, World &world, const TickInput *inputs) {
+    save(rollback, world);
+    world::tick(world, inputs);
+}
+
+bool resimulate(Rollback &rollback, World &world, Lockstep &lockstep, uint32_t tick) {
+    const uint64_t start = time_now_ns();
+    const uint32_t end = world.tick;
+
+    if (!restore(rollback, world, tick)) {
+        return false;
+    }
+
+    // Ticks that are still unconfirmed are predicted again, from the latest known input.
+    TickInput inputs[PlayerMax];
+    while (world.tick != end) {
+        if (!lockstep::inputs_for(lockstep, world.tick, inputs)) {
+            break;
+        }
+        advance(rollback, world, inputs);
+    }
+
+    const uint32_t depth = end - tick;
+    const uint64_t elapsed = time_now_ns() - start;
+
+    rollback.rollbacks++;
+    rollback.resimulated += depth;
+    rollback.last_rollback_ns = elapsed;
+    if (depth > rollback.deepest) {
+        rollback.deepest = depth;
+    }
+    if (elapsed > rollback.worst_rollback_ns) {
+        rollback.worst_rollback_ns = elapsed;
+    }
+
+    return true;
+}
+
+} // namespace rollback
+
+} // namespace game
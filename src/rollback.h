@@ -0,0 +1,82 @@
+#pragma once
+
+#include "util.h"
+#include "world.h"
+
+#pragma warning(push, 0)
+#include <memory_types.h>
+#include <stdint.h>
+#pragma warning(pop)
+
+namespace game {
+
+struct Lockstep;
+
+/// The number of snapshots a Rollback keeps. Bounds how many ticks can be predicted.
+constexpr uint32_t RollbackWindow = 32;
+
+/**
+ * @brief Snapshots of a World for every recent tick, to restore when a predicted input was wrong.
+ *
+ * Every tick is saved before it's simulated. When a Lockstep finds out that a
+ * remote input it guessed was wrong, the world is restored to the start of that
+ * tick and the ticks since are simulated again with the inputs known by now.
+ */
+struct Rollback {
+    Rollback(foundation::Allocator &allocator);
+    ~Rollback();
+    DELETE_COPY_AND_MOVE(Rollback)
+
+    foundation::Allocator &allocator;
+
+    // The snapshot of the start of a tick is at tick % RollbackWindow.
+    WorldSnapshot *snapshots[RollbackWindow];
+
+    // Counters
+    uint32_t rollbacks;
+    uint32_t resimulated;
+    uint32_t deepest;
+    uint64_t last_rollback_ns;
+    uint64_t worst_rollback_ns;
+};
+
+namespace rollback {
+
+/**
+ * @brief Reserves the snapshots' storage, so saving never allocates, and resets the counters.
+ *
+ * @param rollback The rollback to initialize.
+ * @param max_bullets The most bullets a snapshot needs to hold.
+ */
+void init(Rollback &rollback, uint32_t max_bullets);
+
+/// Saves the world at the start of its current tick.
+void save(Rollback &rollback, const World &world);
+
+/**
+ * @brief Restores the world to the start of a tick.
+ *
+ * @param rollback The rollback to restore from.
+ * @param world The world to restore.
+ * @param tick The tick to restore, which must be one of the last RollbackWindow saved.
+ * @return true If the tick's snapshot was still kept.
+ */
+bool restore(Rollback &rollback, World &world, uint32_t tick);
+
+/// Saves the world, then advances it by one tick.
+void advance(Rollback &rollback, World &world, const TickInput *inputs);
+
+/**
+ * @brief Rolls the world back to a tick and simulates it forward again to where it was.
+ *
+ * @param rollback The rollback to restore from.
+ * @param world The world to roll back.
+ * @param lockstep The session to take the inputs from.
+ * @param tick The earliest tick that was simulated with a wrong input.
+ * @return true If the tick's snapshot was still kept.
+ */
+bool resimulate(Rollback &rollback, World &world, Lockstep &lockstep, uint32_t tick);
+
+} // namespace rollback
+
+} // namespace game
@@ -0,0 +1,154 @@
+#include "tracking_allocator.h"
+#include "config.h"
+
+#pragma warning(push, 0)
+#include <cstdio>
+
+#include <engine/log.h>
+#pragma warning(pop)
+
+namespace game {
+
+using namespace foundation;
+
+/// The name of each MemoryTag, indexed by MemoryTag. Also the prefix of its budget in the config.
+constexpr const char *memory_tag_names[(int)MemoryTag::COUNT] = {
+    "engine",
+    "game",
+    "world",
+    "canvas",
+    "net",
+    "replay",
+    "capture",
+    "effects",
+};
+
+TrackingAllocator::TrackingAllocator(Allocator &backing, const char *name)
+: backing(backing)
+, name(name)
+, budget(0)
+, over_budget(false)
+, allocations(0)
+, deallocations(0)
+, bytes(0)
+, peak(0)
+, frame_allocations(0) {
+}
+
+TrackingAllocator::~TrackingAllocator() {
+    if (allocations != deallocations) {
+        log_error("%s leaked %u allocations, %llu bytes", name, allocations - deallocations, (unsigned long long)bytes);
+    }
+}
+
+// Returns the size the backing allocator reserved for p, or 0 if it doesn't track sizes.
+static uint64_t tracked_size(Allocator &backing, void *p) {
+    uint32_t size = backing.allocated_size(p);
+    return size == Allocator::SIZE_NOT_TRACKED ? 0 : size;
+}
+
+void *TrackingAllocator::allocate(uint32_t size, uint32_t align) {
+    void *p = backing.allocate(size, align);
+
+    ++allocations;
+    ++frame_allocations;
+    bytes += tracked_size(backing, p);
+
+    if (bytes > peak) {
+        peak = bytes;
+    }
+
+    if (budget > 0 && bytes > budget && !over_budget) {
+        over_budget = true;
+        log_error("%s is over its budget of %llu KB, at %llu KB", name, (unsigned long long)(budget / 1024), (unsigned long long)(bytes / 1024));
+    }
+
+    return p;
+}
+
+void TrackingAllocator::deallocate(void *p) {
+    if (!p) {
+        return;
+    }
+
+    ++deallocations;
+    bytes -= tracked_size(backing, p);
+    backing.deallocate(p);
+}
+
+uint32_t TrackingAllocator::allocated_size(void *p) {
+    return backing.allocated_size(p);
+}
+
+uint32_t TrackingAllocator::total_allocated() {
+    return (uint32_t)bytes;
+}
+
+MemoryTracker::MemoryTracker(Allocator &backing)
+: allocators{
+      {backing, memory_tag_names[(int)MemoryTag::Engine]},
+      {backing, memory_tag_names[(int)MemoryTag::Game]},
+      {backing, memory_tag_names[(int)MemoryTag::World]},
+      {backing, memory_tag_names[(int)MemoryTag::Canvas]},
+      {backing, memory_tag_names[(int)MemoryTag::Net]},
+      {backing, memory_tag_names[(int)MemoryTag::Replay]},
+      {backing, memory_tag_names[(int)MemoryTag::Capture]},
+      {backing, memory_tag_names[(int)MemoryTag::Effects]},
+  }
+, history()
+, frame(0)
+, steady_frames_allocating(0) {
+    static_assert((int)MemoryTag::COUNT == 8, "MemoryTracker must construct an allocator per MemoryTag");
+}
+
+namespace memory_tracker {
+
+Allocator &allocator(MemoryTracker &tracker, MemoryTag tag) {
+    return tracker.allocators[(int)tag];
+}
+
+const TrackingAllocator &tracking(const MemoryTracker &tracker, MemoryTag tag) {
+    return tracker.allocators[(int)tag];
+}
+
+void set_budgets(MemoryTracker &tracker, const ini_t *config) {
+    for (TrackingAllocator &a : tracker.allocators) {
+        char property[32];
+        snprintf(property, sizeof(property), "%s_kb", a.name);
+
+        a.budget = (uint64_t)config_int(config, "memory", property, 0) * 1024;
+        a.over_budget = false;
+    }
+}
+
+uint32_t end_frame(MemoryTracker &tracker, bool steady) {
+    uint32_t allocations = 0;
+    for (const TrackingAllocator &a : tracker.allocators) {
+        allocations += a.frame_allocations;
+    }
+
+    if (steady && allocations > 0) {
+        if (tracker.steady_frames_allocating == 0) {
+            for (const TrackingAllocator &a : tracker.allocators) {
+                if (a.frame_allocations > 0) {
+                    log_error("Frame %llu allocated %u times in %s after reaching a steady state", (unsigned long long)tracker.frame, a.frame_allocations, a.name);
+                }
+            }
+        }
+
+        ++tracker.steady_frames_allocating;
+    }
+
+    for (TrackingAllocator &a : tracker.allocators) {
+        a.frame_allocations = 0;
+    }
+
+    tracker.history[tracker.frame % MemoryHistorySize] = allocations;
+    ++tracker.frame;
+
+    return allocations;
+}
+
+} // namespace memory_tracker
+
+} // namespace game
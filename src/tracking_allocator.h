@@ -0,0 +1,117 @@
+#pragma once
+
+#include "util.h"
+
+#pragma warning(push, 0)
+#include <memory.h>
+#include <stdint.h>
+#pragma warning(pop)
+
+typedef struct ini_t ini_t;
+
+namespace game {
+
+/// The subsystems memory is tracked and budgeted by.
+enum class MemoryTag : uint8_t {
+    Engine,
+    Game,
+    World,
+    Canvas,
+    Net,
+    Replay,
+    Capture,
+    Effects,
+    COUNT,
+};
+
+/// The ticks a game runs before its frames are expected not to allocate.
+constexpr uint32_t SteadyStateTicks = 60;
+
+/// The number of frames of allocation counts a MemoryTracker keeps.
+constexpr uint32_t MemoryHistorySize = 128;
+
+/**
+ * @brief Forwards to a backing allocator and counts what goes through it.
+ *
+ * Live bytes are measured with the backing allocator's allocated_size, so they
+ * need a backing allocator that tracks sizes, like the default one does. Not
+ * thread safe, like the allocators it wraps.
+ */
+struct TrackingAllocator : public foundation::Allocator {
+    TrackingAllocator(foundation::Allocator &backing, const char *name);
+    ~TrackingAllocator();
+    DELETE_COPY_AND_MOVE(TrackingAllocator)
+
+    void *allocate(uint32_t size, uint32_t align = DEFAULT_ALIGN) override;
+    void deallocate(void *p) override;
+    uint32_t allocated_size(void *p) override;
+    uint32_t total_allocated() override;
+
+    foundation::Allocator &backing;
+    const char *name;
+
+    // The most bytes this should hold, 0 for no budget. Going over is logged once.
+    uint64_t budget;
+    bool over_budget;
+
+    // Counters
+    uint32_t allocations;
+    uint32_t deallocations;
+    uint64_t bytes;
+    uint64_t peak;
+
+    // Allocations since the last frame ended.
+    uint32_t frame_allocations;
+};
+
+/**
+ * @brief A TrackingAllocator per subsystem, and the number of allocations of
+ * every recent frame.
+ *
+ * A game that has reached a steady state shouldn't allocate at all, so a frame
+ * that does is counted, and the first one is logged with the subsystems that
+ * allocated.
+ */
+struct MemoryTracker {
+    MemoryTracker(foundation::Allocator &backing);
+    DELETE_COPY_AND_MOVE(MemoryTracker)
+
+    TrackingAllocator allocators[(int)MemoryTag::COUNT];
+
+    // The allocations of a frame are at frame % MemoryHistorySize.
+    uint32_t history[MemoryHistorySize];
+    uint64_t frame;
+
+    // Steady state frames that allocated.
+    uint32_t steady_frames_allocating;
+};
+
+namespace memory_tracker {
+
+/// Returns the allocator of a subsystem.
+foundation::Allocator &allocator(MemoryTracker &tracker, MemoryTag tag);
+
+/// Returns the tracking allocator of a subsystem.
+const TrackingAllocator &tracking(const MemoryTracker &tracker, MemoryTag tag);
+
+/**
+ * @brief Reads each subsystem's budget from the [memory] section of the config,
+ * as <name>_kb properties.
+ *
+ * @param tracker The tracker.
+ * @param config The config to read from.
+ */
+void set_budgets(MemoryTracker &tracker, const ini_t *config);
+
+/**
+ * @brief Records the allocations of the frame that just ended and starts the next.
+ *
+ * @param tracker The tracker.
+ * @param steady Whether the frame should have been free of allocations.
+ * @return uint32_t The number of allocations the frame made.
+ */
+uint32_t end_frame(MemoryTracker &tracker, bool steady);
+
+} // namespace memory_tracker
+
+} // namespace game
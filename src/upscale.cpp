@@ -0,0 +1,407 @@
+#include "upscale.h"
+#include "config.h"
+
+#pragma warning(push, 0)
+#include <cstring>
+
+#include <memory.h>
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define UPSCALE_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#endif
+#pragma warning(pop)
+
+#if defined(UPSCALE_X86) && (defined(__GNUC__) || defined(__clang__))
+#define TARGET_SSSE3 __attribute__((target("ssse3")))
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define TARGET_SSSE3
+#define TARGET_AVX2
+#endif
+
+namespace game {
+
+using namespace foundation;
+
+namespace {
+
+// Replicates a row of expanded pixels horizontally.
+void replicate_row(const uint32_t *pixels, int32_t count, int32_t scale, uint32_t *out) {
+    for (int32_t x = 0; x < count; ++x) {
+        uint32_t color = pixels[x];
+        for (int32_t s = 0; s < scale; ++s) {
+            *out++ = color;
+        }
+    }
+}
+
+// Copies the first row of a scaled block to the scale - 1 rows below it.
+void replicate_rows(uint32_t *row, int32_t width, int32_t scale, int32_t out_stride) {
+    for (int32_t s = 1; s < scale; ++s) {
+        memcpy(row + s * out_stride, row, width * sizeof(uint32_t));
+    }
+}
+
+void expand_scalar(const uint8_t *indices, int32_t width, int32_t height, const uint32_t *palette, int32_t scale, uint32_t *out, int32_t out_stride) {
+    for (int32_t y = 0; y < height; ++y) {
+        const uint8_t *src = indices + y * width;
+        uint32_t *row = out + y * scale * out_stride;
+        uint32_t *dst = row;
+
+        for (int32_t x = 0; x < width; ++x) {
+            uint32_t color = palette[src[x] & 0x0f];
+            for (int32_t s = 0; s < scale; ++s) {
+                *dst++ = color;
+            }
+        }
+
+        replicate_rows(row, width * scale, scale, out_stride);
+    }
+}
+
+#if defined(UPSCALE_X86)
+
+// Splits the palette into one 16 byte table per channel, for use with pshufb.
+void palette_planes(const uint32_t *palette, uint8_t planes[4][16]) {
+    for (uint32_t i = 0; i < PaletteSize; ++i) {
+        const uint8_t *color = (const uint8_t *)&palette[i];
+        for (uint32_t channel = 0; channel < 4; ++channel) {
+            planes[channel][i] = color[channel];
+        }
+    }
+}
+
+TARGET_SSSE3 void expand_ssse3(const uint8_t *indices, int32_t width, int32_t height, const uint32_t *palette, int32_t scale, uint32_t *out, int32_t out_stride) {
+    uint8_t planes[4][16];
+    palette_planes(palette, planes);
+
+    const __m128i r_table = _mm_loadu_si128((const __m128i *)planes[0]);
+    const __m128i g_table = _mm_loadu_si128((const __m128i *)planes[1]);
+    const __m128i b_table = _mm_loadu_si128((const __m128i *)planes[2]);
+    const __m128i a_table = _mm_loadu_si128((const __m128i *)planes[3]);
+    const __m128i low_nibble = _mm_set1_epi8(0x0f);
+
+    alignas(16) uint32_t pixels[16];
+
+    for (int32_t y = 0; y < height; ++y) {
+        const uint8_t *src = indices + y * width;
+        uint32_t *row = out + y * scale * out_stride;
+        uint32_t *dst = row;
+
+        int32_t x = 0;
+        for (; x + 16 <= width; x += 16) {
+            __m128i index = _mm_and_si128(_mm_loadu_si128((const __m128i *)(src + x)), low_nibble);
+            __m128i r = _mm_shuffle_epi8(r_table, index);
+            __m128i g = _mm_shuffle_epi8(g_table, index);
+            __m128i b = _mm_shuffle_epi8(b_table, index);
+            __m128i a = _mm_shuffle_epi8(a_table, index);
+
+            __m128i rg_lo = _mm_unpacklo_epi8(r, g);
+            __m128i rg_hi = _mm_unpackhi_epi8(r, g);
+            __m128i ba_lo = _mm_unpacklo_epi8(b, a);
+            __m128i ba_hi = _mm_unpackhi_epi8(b, a);
+
+            __m128i p[4] = {
+                _mm_unpacklo_epi16(rg_lo, ba_lo),
+                _mm_unpackhi_epi16(rg_lo, ba_lo),
+                _mm_unpacklo_epi16(rg_hi, ba_hi),
+                _mm_unpackhi_epi16(rg_hi, ba_hi),
+            };
+
+            switch (scale) {
+            case 1: {
+                for (int i = 0; i < 4; ++i) {
+                    _mm_storeu_si128((__m128i *)dst + i, p[i]);
+                }
+                break;
+            }
+            case 2: {
+                for (int i = 0; i < 4; ++i) {
+                    _mm_storeu_si128((__m128i *)dst + i * 2 + 0, _mm_unpacklo_epi32(p[i], p[i]));
+                    _mm_storeu_si128((__m128i *)dst + i * 2 + 1, _mm_unpackhi_epi32(p[i], p[i]));
+                }
+                break;
+            }
+            case 4: {
+                for (int i = 0; i < 4; ++i) {
+                    _mm_storeu_si128((__m128i *)dst + i * 4 + 0, _mm_shuffle_epi32(p[i], 0x00));
+                    _mm_storeu_si128((__m128i *)dst + i * 4 + 1, _mm_shuffle_epi32(p[i], 0x55));
+                    _mm_storeu_si128((__m128i *)dst + i * 4 + 2, _mm_shuffle_epi32(p[i], 0xaa));
+                    _mm_storeu_si128((__m128i *)dst + i * 4 + 3, _mm_shuffle_epi32(p[i], 0xff));
+                }
+                break;
+            }
+            default: {
+                for (int i = 0; i < 4; ++i) {
+                    _mm_store_si128((__m128i *)pixels + i, p[i]);
+                }
+                replicate_row(pixels, 16, scale, dst);
+                break;
+            }
+            }
+
+            dst += 16 * scale;
+        }
+
+        for (; x < width; ++x) {
+            uint32_t color = palette[src[x] & 0x0f];
+            for (int32_t s = 0; s < scale; ++s) {
+                *dst++ = color;
+            }
+        }
+
+        replicate_rows(row, width * scale, scale, out_stride);
+    }
+}
+
+TARGET_AVX2 void expand_avx2(const uint8_t *indices, int32_t width, int32_t height, const uint32_t *palette, int32_t scale, uint32_t *out, int32_t out_stride) {
+    uint8_t planes[4][16];
+    palette_planes(palette, planes);
+
+    const __m256i r_table = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *)planes[0]));
+    const __m256i g_table = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *)planes[1]));
+    const __m256i b_table = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *)planes[2]));
+    const __m256i a_table = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *)planes[3]));
+    const __m256i low_nibble = _mm256_set1_epi8(0x0f);
+
+    const __m256i double_lo = _mm256_setr_epi32(0, 0, 1, 1, 2, 2, 3, 3);
+    const __m256i double_hi = _mm256_setr_epi32(4, 4, 5, 5, 6, 6, 7, 7);
+
+    alignas(32) uint32_t pixels[32];
+
+    for (int32_t y = 0; y < height; ++y) {
+        const uint8_t *src = indices + y * width;
+        uint32_t *row = out + y * scale * out_stride;
+        uint32_t *dst = row;
+
+        int32_t x = 0;
+        for (; x + 32 <= width; x += 32) {
+            __m256i index = _mm256_and_si256(_mm256_loadu_si256((const __m256i *)(src + x)), low_nibble);
+            __m256i r = _mm256_shuffle_epi8(r_table, index);
+            __m256i g = _mm256_shuffle_epi8(g_table, index);
+            __m256i b = _mm256_shuffle_epi8(b_table, index);
+            __m256i a = _mm256_shuffle_epi8(a_table, index);
+
+            // The unpacks work within 128 bit lanes, so q0 holds pixels 0-3 and 16-19, q1 4-7 and 20-23 and so on.
+            __m256i rg_lo = _mm256_unpacklo_epi8(r, g);
+            __m256i rg_hi = _mm256_unpackhi_epi8(r, g);
+            __m256i ba_lo = _mm256_unpacklo_epi8(b, a);
+            __m256i ba_hi = _mm256_unpackhi_epi8(b, a);
+
+            __m256i q0 = _mm256_unpacklo_epi16(rg_lo, ba_lo);
+            __m256i q1 = _mm256_unpackhi_epi16(rg_lo, ba_lo);
+            __m256i q2 = _mm256_unpacklo_epi16(rg_hi, ba_hi);
+            __m256i q3 = _mm256_unpackhi_epi16(rg_hi, ba_hi);
+
+            __m256i p[4] = {
+                _mm256_permute2x128_si256(q0, q1, 0x20),
+                _mm256_permute2x128_si256(q2, q3, 0x20),
+                _mm256_permute2x128_si256(q0, q1, 0x31),
+                _mm256_permute2x128_si256(q2, q3, 0x31),
+            };
+
+            switch (scale) {
+            case 1: {
+                for (int i = 0; i < 4; ++i) {
+                    _mm256_storeu_si256((__m256i *)dst + i, p[i]);
+                }
+                break;
+            }
+            case 2: {
+                for (int i = 0; i < 4; ++i) {
+                    _mm256_storeu_si256((__m256i *)dst + i * 2 + 0, _mm256_permutevar8x32_epi32(p[i], double_lo));
+                    _mm256_storeu_si256((__m256i *)dst + i * 2 + 1, _mm256_permutevar8x32_epi32(p[i], double_hi));
+                }
+                break;
+            }
+            default: {
+                for (int i = 0; i < 4; ++i) {
+                    _mm256_store_si256((__m256i *)pixels + i, p[i]);
+                }
+
+                if (scale == 4 || scale == 8) {
+                    // Broadcast each pixel to 8 lanes and store it as one or two halves.
+                    for (int i = 0; i < 32; ++i) {
+                        __m256i color = _mm256_set1_epi32((int)pixels[i]);
+                        if (scale == 4) {
+                            _mm_storeu_si128((__m128i *)(dst + i * 4), _mm256_castsi256_si128(color));
+                        } else {
+                            _mm256_storeu_si256((__m256i *)(dst + i * 8), color);
+                        }
+                    }
+                } else {
+                    replicate_row(pixels, 32, scale, dst);
+                }
+                break;
+            }
+            }
+
+            dst += 32 * scale;
+        }
+
+        for (; x < width; ++x) {
+            uint32_t color = palette[src[x] & 0x0f];
+            for (int32_t s = 0; s < scale; ++s) {
+                *dst++ = color;
+            }
+        }
+
+        replicate_rows(row, width * scale, scale, out_stride);
+    }
+}
+
+#endif
+
+typedef void (*ExpandFunction)(const uint8_t *indices, int32_t width, int32_t height, const uint32_t *palette, int32_t scale, uint32_t *out, int32_t out_stride);
+
+const char *kernel_names[(int)UpscaleKernel::COUNT] = {"scalar", "ssse3", "avx2"};
+
+#if defined(UPSCALE_X86)
+const ExpandFunction kernels[(int)UpscaleKernel::COUNT] = {expand_scalar, expand_ssse3, expand_avx2};
+#else
+const ExpandFunction kernels[(int)UpscaleKernel::COUNT] = {expand_scalar, nullptr, nullptr};
+#endif
+
+// Whether the CPU runs each kernel, indexed by UpscaleKernel.
+struct KernelSupport {
+    bool supported[(int)UpscaleKernel::COUNT];
+};
+
+KernelSupport detect_support() {
+    KernelSupport support = {{true, false, false}};
+
+#if defined(UPSCALE_X86)
+#if defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 0);
+    int max_leaf = info[0];
+
+    __cpuid(info, 1);
+    bool ssse3 = (info[2] & (1 << 9)) != 0;
+    bool avx = (info[2] & (1 << 28)) != 0;
+    bool avx2 = false;
+    if (avx && max_leaf >= 7) {
+        __cpuidex(info, 7, 0);
+        avx2 = (info[1] & (1 << 5)) != 0;
+    }
+#else
+    __builtin_cpu_init();
+    bool ssse3 = __builtin_cpu_supports("ssse3");
+    bool avx2 = __builtin_cpu_supports("avx2");
+#endif
+
+    support.supported[(int)UpscaleKernel::Ssse3] = ssse3;
+    support.supported[(int)UpscaleKernel::Avx2] = avx2;
+#endif
+
+    return support;
+}
+
+const KernelSupport &support() {
+    static const KernelSupport s = detect_support();
+    return s;
+}
+
+UpscaleKernel select_kernel() {
+    for (int i = (int)UpscaleKernel::COUNT - 1; i > 0; --i) {
+        if (support().supported[i]) {
+            return (UpscaleKernel)i;
+        }
+    }
+
+    return UpscaleKernel::Scalar;
+}
+
+UpscaleKernel kernel() {
+    static const UpscaleKernel k = select_kernel();
+    return k;
+}
+
+} // namespace
+
+namespace upscale {
+
+void expand(const uint8_t *indices, int32_t width, int32_t height, const uint32_t *palette, int32_t scale, uint32_t *out, int32_t out_stride) {
+    expand_with(kernel(), indices, width, height, palette, scale, out, out_stride);
+}
+
+const char *kernel_name() {
+    return kernel_names[(int)kernel()];
+}
+
+bool supported(UpscaleKernel kernel) {
+    return support().supported[(int)kernel];
+}
+
+const char *kernel_name(UpscaleKernel kernel) {
+    return kernel_names[(int)kernel];
+}
+
+void expand_with(UpscaleKernel kernel, const uint8_t *indices, int32_t width, int32_t height, const uint32_t *palette, int32_t scale, uint32_t *out, int32_t out_stride) {
+    assert(indices && palette && out);
+    assert(scale >= 1 && scale <= MaxUpscale);
+    assert(out_stride >= width * scale);
+    assert(supported(kernel));
+
+    kernels[(int)kernel](indices, width, height, palette, scale, out, out_stride);
+}
+
+int32_t render_scale(const ini_t *config) {
+    int32_t scale = config_int(config, "engine", "render_scale", 1);
+    return scale < 1 ? 1 : scale > MaxUpscale ? MaxUpscale : scale;
+}
+
+} // namespace upscale
+
+StagingBuffers::StagingBuffers(Allocator &allocator)
+: allocator(allocator)
+, buffers{nullptr, nullptr}
+, width(0)
+, height(0)
+, scale(1)
+, front(0) {
+}
+
+StagingBuffers::~StagingBuffers() {
+    for (uint32_t *buffer : buffers) {
+        if (buffer) {
+            allocator.deallocate(buffer);
+        }
+    }
+}
+
+namespace staging_buffers {
+
+void init(StagingBuffers &staging, int32_t width, int32_t height, int32_t scale) {
+    assert(width > 0 && height > 0);
+    assert(scale >= 1 && scale <= MaxUpscale);
+
+    staging.width = width;
+    staging.height = height;
+    staging.scale = scale;
+    staging.front = 0;
+
+    uint32_t size = (uint32_t)(width * scale * height * scale) * sizeof(uint32_t);
+    for (uint32_t *&buffer : staging.buffers) {
+        if (buffer) {
+            staging.allocator.deallocate(buffer);
+        }
+        buffer = (uint32_t *)staging.allocator.allocate(size, 32);
+        memset(buffer, 0, size);
+    }
+}
+
+const uint32_t *present(StagingBuffers &staging, const uint8_t *indices, const uint32_t *palette) {
+    uint32_t back = staging.front ^ 1;
+    upscale::expand(indices, staging.width, staging.height, palette, staging.scale, staging.buffers[back], staging.width * staging.scale);
+    staging.front = back;
+    return staging.buffers[back];
+}
+
+} // namespace staging_buffers
+
+} // namespace game
@@ -0,0 +1,112 @@
+#pragma once
+
+#include "util.h"
+
+#pragma warning(push, 0)
+#include <memory_types.h>
+#include <stdint.h>
+#pragma warning(pop)
+
+typedef struct ini_t ini_t;
+
+namespace game {
+
+/// The number of colors in a palette.
+constexpr uint32_t PaletteSize = 16;
+
+/// The largest supported integer scale.
+constexpr int32_t MaxUpscale = 8;
+
+/// The implementations of expand, fastest last.
+enum class UpscaleKernel : uint8_t {
+    Scalar,
+    Ssse3,
+    Avx2,
+    COUNT,
+};
+
+namespace upscale {
+
+/**
+ * @brief Expands palette indices to RGBA pixels, replicating each pixel into a scale by scale block.
+ *
+ * Uses AVX2 or SSSE3 when the CPU supports them, and a scalar loop otherwise.
+ *
+ * @param indices The palette indices, width * height bytes. Only the low 4 bits are used.
+ * @param width The width of the source in pixels.
+ * @param height The height of the source in pixels.
+ * @param palette The 16 colors, as RGBA bytes in memory order.
+ * @param scale The integer scale, between 1 and MaxUpscale.
+ * @param out The destination, at least height * scale rows of out_stride pixels.
+ * @param out_stride The distance between destination rows, in pixels.
+ */
+void expand(const uint8_t *indices, int32_t width, int32_t height, const uint32_t *palette, int32_t scale, uint32_t *out, int32_t out_stride);
+
+/// Returns the name of the kernel expand uses on this CPU.
+const char *kernel_name();
+
+/// Returns whether a kernel was built and this CPU can run it.
+bool supported(UpscaleKernel kernel);
+
+/// Returns the name of a kernel.
+const char *kernel_name(UpscaleKernel kernel);
+
+/// Expands with a given kernel, which must be supported, rather than the fastest. For checking the kernels against each other.
+void expand_with(UpscaleKernel kernel, const uint8_t *indices, int32_t width, int32_t height, const uint32_t *palette, int32_t scale, uint32_t *out, int32_t out_stride);
+
+/// Returns the scale the window presents the canvas at, [engine] render_scale clamped to what expand supports.
+int32_t render_scale(const ini_t *config);
+
+} // namespace upscale
+
+/**
+ * @brief A pair of RGBA buffers at presentation resolution. Frames are expanded
+ * into the back buffer, and the front buffer holds the last completed frame.
+ *
+ * Frame captures take the canvas through these at the window's render scale,
+ * so a capture matches what is on screen, and the frame being read stays whole
+ * while the next one is expanded.
+ */
+struct StagingBuffers {
+    StagingBuffers(foundation::Allocator &allocator);
+    ~StagingBuffers();
+    DELETE_COPY_AND_MOVE(StagingBuffers)
+
+    foundation::Allocator &allocator;
+    uint32_t *buffers[2];
+    int32_t width;
+    int32_t height;
+    int32_t scale;
+    uint32_t front;
+};
+
+namespace staging_buffers {
+
+/**
+ * @brief Allocates the buffers for a source of the given size and scale.
+ *
+ * @param staging The staging buffers to initialize.
+ * @param width The width of the source.
+ * @param height The height of the source.
+ * @param scale The integer scale, between 1 and MaxUpscale.
+ */
+void init(StagingBuffers &staging, int32_t width, int32_t height, int32_t scale);
+
+/**
+ * @brief Expands a frame of palette indices into the back buffer, and swaps it to the front.
+ *
+ * @param staging The staging buffers.
+ * @param indices The palette indices, of the size the buffers were initialized with.
+ * @param palette The 16 colors, as RGBA bytes in memory order.
+ * @return const uint32_t* The new front buffer.
+ */
+const uint32_t *present(StagingBuffers &staging, const uint8_t *indices, const uint32_t *palette);
+
+/// Returns the front buffer, holding the last presented frame.
+inline const uint32_t *front(const StagingBuffers &staging) {
+    return staging.buffers[staging.front];
+}
+
+} // namespace staging_buffers
+
+} // namespace game
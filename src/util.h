@@ -2,6 +2,7 @@
 
 #include <cassert>
 #include <collection_types.h>
+#include <stdint.h>
 
 // Deletes the copy constructor, the copy assignment operator, the move constructor, and the move assignment operator.
 #define DELETE_COPY_AND_MOVE(T)       \
@@ -37,4 +38,47 @@ void shift_pop(Array<T> &a, uint32_t index) {
     array::pop_back(a);
 }
 
+// Compile time MurmurHash64A. Produces the same values as murmur_hash_64 on little endian platforms.
+constexpr uint64_t murmur_hash_64_constexpr(const char *key, uint32_t len, uint64_t seed) {
+    const uint64_t m = 0xc6a4a7935bd1e995ULL;
+    const int r = 47;
+
+    uint64_t h = seed ^ (len * m);
+    uint32_t blocks = len / 8;
+
+    for (uint32_t i = 0; i < blocks; ++i) {
+        uint64_t k = 0;
+        for (uint32_t b = 0; b < 8; ++b) {
+            k |= (uint64_t)(uint8_t)key[i * 8 + b] << (8 * b);
+        }
+
+        k *= m;
+        k ^= k >> r;
+        k *= m;
+
+        h ^= k;
+        h *= m;
+    }
+
+    uint32_t tail = len & 7;
+    if (tail) {
+        for (uint32_t b = 0; b < tail; ++b) {
+            h ^= (uint64_t)(uint8_t)key[blocks * 8 + b] << (8 * b);
+        }
+        h *= m;
+    }
+
+    h ^= h >> r;
+    h *= m;
+    h ^= h >> r;
+
+    return h;
+}
+
+// Compile time murmur hash of a string literal, with a seed of 0.
+template <uint32_t N>
+constexpr uint64_t murmur_hash_64_constexpr(const char (&key)[N]) {
+    return murmur_hash_64_constexpr(key, N - 1, 0);
+}
+
 } // namespace foundation
@@ -0,0 +1,265 @@
+#include "waves.h"
+#include "config.h"
+
+#pragma warning(push, 0)
+#include <array.h>
+#include <murmur_hash.h>
+#include <string_stream.h>
+#include <temp_allocator.h>
+
+#include <atomic>
+#include <cassert>
+#include <cstdlib>
+#include <cstring>
+
+#include <engine/file.h>
+#include <engine/ini.h>
+#include <engine/log.h>
+#pragma warning(pop)
+
+namespace game {
+
+using namespace foundation;
+
+static const char *curve_names[(int)PathCurve::COUNT] = {"lemniscate", "circle", "sweep", "lissajous"};
+static const char *pattern_names[(int)FirePattern::COUNT] = {"cross", "ring", "spiral", "aimed"};
+
+// Whether a spawn comes before another, on its tick then its place in the file.
+static bool before(const Spawn &a, const Spawn &b) {
+    return a.tick < b.tick || (a.tick == b.tick && a.order < b.order);
+}
+
+// Returns the index of a name in a list of names, or -1.
+static int find_name(const char *const *names, int count, const char *name) {
+    for (int i = 0; i < count; ++i) {
+        if (strcmp(names[i], name) == 0) {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+// Reads a property of a section by index, unlike config_string which finds the first section of a name.
+static const char *property(const ini_t *ini, int section, const char *name, const char *default_value) {
+    int index = ini_find_property(ini, section, name, 0);
+    return index == INI_NOT_FOUND ? default_value : ini_property_value(ini, section, index);
+}
+
+static float property_float(const ini_t *ini, int section, const char *name, float default_value) {
+    const char *value = property(ini, section, name, nullptr);
+    return value ? strtof(value, nullptr) : default_value;
+}
+
+static uint32_t property_ticks(const ini_t *ini, int section, const char *name) {
+    const char *value = property(ini, section, name, nullptr);
+    long ticks = value ? strtol(value, nullptr, 10) : 0;
+    return ticks > 0 ? (uint32_t)ticks : 0;
+}
+
+namespace waves {
+
+void defaults(WaveTable &table) {
+    table = WaveTable();
+
+    EnemyType &drone = table.types[0];
+    strcpy(drone.name, "drone");
+    drone.sprite = 857;
+    drone.speed = 0.05f;
+    drone.rot_speed = 0.4f;
+    drone.bullet_rate = 0.8f;
+    drone.bullet_speed = 20.0f;
+    table.type_count = 1;
+
+    Spawn &spawn = table.spawns[0];
+    spawn.phase = 20.0f;
+    spawn.curve = PathCurve::Lemniscate;
+    spawn.pattern = FirePattern::Cross;
+    table.spawn_count = 1;
+}
+
+bool load(WaveTable &table, const char *filename) {
+    defaults(table);
+
+    TempAllocator4096 ta;
+    string_stream::Buffer buffer(ta);
+
+    if (!engine::file::read(buffer, filename)) {
+        log_error("Could not open wave file %s", filename);
+        return false;
+    }
+
+    return parse(table, string_stream::c_str(buffer), filename);
+}
+
+bool parse(WaveTable &table, const char *text, const char *filename) {
+    defaults(table);
+
+    ini_t *ini = ini_load(text, nullptr);
+    if (!ini) {
+        log_error("Could not parse wave file %s", filename);
+        return false;
+    }
+
+    table.type_count = 0;
+    table.spawn_count = 0;
+
+    const int sections = ini_section_count(ini);
+
+    // Types first, so spawns can name types from anywhere in the file.
+    for (int s = 0; s < sections; ++s) {
+        const char *name = ini_section_name(ini, s);
+        if (!name || strncmp(name, "type.", 5) != 0) {
+            continue;
+        }
+
+        if (table.type_count == EnemyTypeMax) {
+            log_error("Wave file %s has more than %u enemy types", filename, EnemyTypeMax);
+            break;
+        }
+
+        EnemyType &type = table.types[table.type_count++];
+        strncpy(type.name, name + 5, sizeof(type.name) - 1);
+        type.sprite = (int32_t)strtol(property(ini, s, "sprite", "857"), nullptr, 10);
+        type.speed = property_float(ini, s, "speed", 0.05f);
+        type.rot_speed = property_float(ini, s, "rot_speed", 0.4f);
+        type.bullet_rate = property_float(ini, s, "bullet_rate", 0.8f);
+        type.bullet_speed = property_float(ini, s, "bullet_speed", 20.0f);
+    }
+
+    for (int s = 0; s < sections; ++s) {
+        const char *name = ini_section_name(ini, s);
+        if (!name || strncmp(name, "spawn.", 6) != 0) {
+            continue;
+        }
+
+        if (table.spawn_count == SpawnMax) {
+            log_error("Wave file %s has more than %u spawns", filename, SpawnMax);
+            break;
+        }
+
+        const char *type_name = property(ini, s, "type", "");
+        int type = -1;
+        for (uint32_t i = 0; i < table.type_count; ++i) {
+            if (strcmp(table.types[i].name, type_name) == 0) {
+                type = (int)i;
+                break;
+            }
+        }
+
+        int curve = find_name(curve_names, (int)PathCurve::COUNT, property(ini, s, "path", "lemniscate"));
+        int pattern = find_name(pattern_names, (int)FirePattern::COUNT, property(ini, s, "pattern", "cross"));
+
+        if (type < 0 || curve < 0 || pattern < 0) {
+            log_error("Skipping %s in wave file %s, its type, path or pattern is unknown", name, filename);
+            continue;
+        }
+
+        Spawn &spawn = table.spawns[table.spawn_count];
+        spawn.tick = property_ticks(ini, s, "tick");
+        spawn.order = table.spawn_count;
+        spawn.repeat = property_ticks(ini, s, "repeat");
+        spawn.life = property_ticks(ini, s, "life");
+        spawn.phase = property_float(ini, s, "phase", 0.0f);
+        spawn.type = (uint8_t)type;
+        spawn.curve = (PathCurve)curve;
+        spawn.pattern = (FirePattern)pattern;
+        ++table.spawn_count;
+    }
+
+    ini_destroy(ini);
+
+    if (table.spawn_count == 0) {
+        log_error("Wave file %s has no spawns", filename);
+        defaults(table);
+        return false;
+    }
+
+    return true;
+}
+
+const char *filename(const ini_t *config) {
+    return config_string(config, "waves", "filename", "assets/waves.ini");
+}
+
+uint64_t hash(const ini_t *config, uint64_t config_hash) {
+    TempAllocator4096 ta;
+    string_stream::Buffer buffer(ta);
+
+    if (!engine::file::read(buffer, filename(config))) {
+        return config_hash;
+    }
+
+    return murmur_hash_64(array::begin(buffer), array::size(buffer), config_hash);
+}
+
+void push(SpawnHeap &heap, const Spawn &spawn) {
+    // Once per process, whichever world or thread hits it first.
+    static std::atomic<bool> logged(false);
+
+    if (heap.count == SpawnMax) {
+        if (!logged.exchange(true)) {
+            log_error("The spawn queue is full at %u spawns, dropping spawns", SpawnMax);
+        }
+        return;
+    }
+
+    // Sift up from the new leaf.
+    uint32_t i = heap.count++;
+    while (i > 0) {
+        uint32_t parent = (i - 1) / 2;
+        if (!before(spawn, heap.items[parent])) {
+            break;
+        }
+
+        heap.items[i] = heap.items[parent];
+        i = parent;
+    }
+
+    heap.items[i] = spawn;
+}
+
+Spawn pop(SpawnHeap &heap) {
+    assert(heap.count > 0);
+
+    Spawn next = heap.items[0];
+    Spawn last = heap.items[--heap.count];
+
+    // Sift the last leaf down from the root.
+    uint32_t i = 0;
+    while (true) {
+        uint32_t child = i * 2 + 1;
+        if (child >= heap.count) {
+            break;
+        }
+
+        if (child + 1 < heap.count && before(heap.items[child + 1], heap.items[child])) {
+            ++child;
+        }
+
+        if (!before(heap.items[child], last)) {
+            break;
+        }
+
+        heap.items[i] = heap.items[child];
+        i = child;
+    }
+
+    if (heap.count > 0) {
+        heap.items[i] = last;
+    }
+
+    return next;
+}
+
+const char *curve_name(PathCurve curve) {
+    return curve_names[(int)curve];
+}
+
+const char *pattern_name(FirePattern pattern) {
+    return pattern_names[(int)pattern];
+}
+
+} // namespace waves
+
+} // namespace game
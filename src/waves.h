@@ -0,0 +1,186 @@
+#pragma once
+
+#include "real.h"
+
+#pragma warning(push, 0)
+#include <stdint.h>
+#pragma warning(pop)
+
+typedef struct ini_t ini_t;
+
+namespace game {
+
+/// The most enemies alive at once.
+constexpr uint32_t EnemyMax = 16;
+
+/// The most kinds of enemy a wave file can describe.
+constexpr uint32_t EnemyTypeMax = 16;
+
+/// The most spawns a wave file can hold, and the most pending at once.
+constexpr uint32_t SpawnMax = 128;
+
+/// The points each path curve is sampled at, a power of two so the index wraps with a mask.
+constexpr uint32_t PathLutSize = 256;
+
+/// The curves an enemy can move along, around the center of the playfield.
+enum class PathCurve : uint8_t {
+    // A figure eight.
+    Lemniscate,
+
+    // A circle.
+    Circle,
+
+    // Side to side across the top.
+    Sweep,
+
+    // A 3:2 Lissajous knot.
+    Lissajous,
+
+    COUNT,
+};
+
+/// How an enemy fires.
+enum class FirePattern : uint8_t {
+    // Four bullets at right angles, turning with the enemy.
+    Cross,
+
+    // Eight bullets in a ring, turning with the enemy.
+    Ring,
+
+    // Two bullets back to back, which turn into a spiral.
+    Spiral,
+
+    // Three bullets fanned at the nearest player.
+    Aimed,
+
+    COUNT,
+};
+
+/// A kind of enemy, what a spawn copies into the enemy it starts.
+struct EnemyType {
+    char name[16];
+    int32_t sprite;
+    Real speed;
+    Real rot_speed;
+    Real bullet_rate;
+    Real bullet_speed;
+};
+
+/// An enemy to start on a tick.
+struct Spawn {
+    // The tick to start on, then the spawn's place in the wave file, so spawns on the same tick start in file order.
+    uint32_t tick;
+    uint32_t order;
+
+    // Ticks until it starts again, 0 for once.
+    uint32_t repeat;
+
+    // Ticks the enemy stays for, 0 for good.
+    uint32_t life;
+
+    // How far along its path the enemy starts, in radians.
+    Real phase;
+
+    uint8_t type;
+    PathCurve curve;
+    FirePattern pattern;
+    uint8_t padding;
+};
+
+/**
+ * @brief The spawns still to come, a binary min-heap on their tick.
+ *
+ * The next spawn is always at the front, so a tick only looks at one spawn to
+ * know there is nothing to start, and starting one costs O(log n) however
+ * many are queued behind it. A repeating spawn goes back in with its next tick.
+ */
+struct SpawnHeap {
+    Spawn items[SpawnMax];
+    uint32_t count;
+};
+
+/**
+ * @brief The kinds of enemy and their spawns, as read from a wave file.
+ *
+ * Constant once loaded. The spawns are in file order; the world queues them
+ * into its own SpawnHeap when it starts.
+ */
+struct WaveTable {
+    EnemyType types[EnemyTypeMax];
+    uint32_t type_count;
+    Spawn spawns[SpawnMax];
+    uint32_t spawn_count;
+};
+
+/// Points along each path curve, in pixels from the center of the playfield.
+template <typename T>
+struct BasicPathLut {
+    Vec2<T> points[(int)PathCurve::COUNT][PathLutSize];
+};
+
+typedef BasicPathLut<Real> PathLut;
+
+namespace waves {
+
+/**
+ * @brief Fills a table with the original game, one drone on a figure eight for good.
+ *
+ * @param table The table.
+ */
+void defaults(WaveTable &table);
+
+/**
+ * @brief Reads a wave file.
+ *
+ * Every [type.NAME] section is a kind of enemy and every [spawn.NAME] section a
+ * spawn of one. Spawns that name an unknown type, path or pattern are skipped
+ * and logged.
+ *
+ * @param table The table to fill.
+ * @param filename The wave file.
+ * @return Whether the file was read. The table is left with the defaults if not.
+ */
+bool load(WaveTable &table, const char *filename);
+
+/**
+ * @brief Reads a wave file already in memory, like load.
+ *
+ * Allocates only through ini.h's malloc, so the asset loader's workers can call it.
+ *
+ * @param table The table to fill.
+ * @param text The contents of the wave file.
+ * @param filename The wave file, for the log.
+ * @return Whether the file was read. The table is left with the defaults if not.
+ */
+bool parse(WaveTable &table, const char *text, const char *filename);
+
+/// Returns the wave file a config plays, its [waves] filename.
+const char *filename(const ini_t *config);
+
+/**
+ * @brief Hashes the bytes of a config's wave file onto the hash of the config.
+ *
+ * Replays and lockstep peers compare the config hash, and a different wave
+ * file diverges as surely as a different config.
+ *
+ * @param config The config.
+ * @param config_hash The hash of the config file.
+ * @return The hash of both, or config_hash if the wave file can't be read.
+ */
+uint64_t hash(const ini_t *config, uint64_t config_hash);
+
+/// Queues a spawn. Full heaps drop it, logging the first time.
+void push(SpawnHeap &heap, const Spawn &spawn);
+
+/// Removes the next spawn. The heap can't be empty.
+Spawn pop(SpawnHeap &heap);
+
+/// Returns the name of a path curve.
+const char *curve_name(PathCurve curve);
+
+/// Returns the name of a fire pattern.
+const char *pattern_name(FirePattern pattern);
+
+} // namespace waves
+
+} // namespace game
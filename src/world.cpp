@@ -0,0 +1,439 @@
+#include "world.h"
+#include "config.h"
+#include "motion.h"
+
+#pragma warning(push, 0)
+#include <atomic>
+#include <cassert>
+#include <cstring>
+
+#include <array.h>
+
+#include <engine/log.h>
+#pragma warning(pop)
+
+namespace game {
+
+// A wave file denser than EnemyMax loses spawns, logged the first time in the process.
+static std::atomic<bool> dropped_spawn_logged(false);
+
+World::World(foundation::Allocator &allocator)
+: width(0)
+, height(0)
+, tick(0)
+, player_count(0)
+, random()
+, players()
+, enemies()
+, enemy_count(0)
+, spawns()
+, food()
+, bullets(allocator)
+, waves()
+, paths()
+, sweep(allocator) {
+}
+
+WorldSnapshot::WorldSnapshot(foundation::Allocator &allocator)
+: tick(0)
+, random()
+, players()
+, enemies()
+, enemy_count(0)
+, spawns()
+, food()
+, bullets(allocator)
+, bullet_capacity(0)
+, bullet_grow_pending(false)
+, padding() {
+}
+
+namespace world {
+
+// Spawns a bullet from the middle of an enemy, returning null when the pool is full.
+static Bullet *spawn_bullet(World &world, const Enemy &enemy, Real vel_x, Real vel_y) {
+    Bullet *b = bullet_pool::spawn(world.bullets);
+    if (b) {
+        b->pos.x = enemy.pos.x + enemy.bounds.origin.x + Real(enemy.bounds.size.x) / 2;
+        b->pos.y = enemy.pos.y + enemy.bounds.origin.y + Real(enemy.bounds.size.y) / 2;
+        b->vel.x = vel_x;
+        b->vel.y = vel_y;
+    }
+
+    return b;
+}
+
+// Fires an enemy's pattern.
+static void fire(World &world, const Enemy &enemy) {
+    if (enemy.pattern == FirePattern::Aimed) {
+        // At the nearest player, in eighths of a pixel so the squared distance fits in fixed point.
+        Real dx = 0;
+        Real dy = 0;
+        Real nearest = 0;
+        for (uint32_t i = 0; i < world.player_count; ++i) {
+            Real x = (world.players[i].pos.x - enemy.pos.x) / 8;
+            Real y = (world.players[i].pos.y - enemy.pos.y) / 8;
+            Real d = x * x + y * y;
+            if (i == 0 || d < nearest) {
+                dx = x;
+                dy = y;
+                nearest = d;
+            }
+        }
+
+        Real length = real::sqrt(nearest);
+        if (length < Real(0.125f)) {
+            dx = real::cos(enemy.rot);
+            dy = real::sin(enemy.rot);
+        } else {
+            dx = dx / length;
+            dy = dy / length;
+        }
+
+        // One straight at the player, and one turned either side.
+        const Real c = real::cos(Real(0.2f));
+        const Real s = real::sin(Real(0.2f));
+        const Real speed = enemy.bullet_speed;
+        spawn_bullet(world, enemy, dx * speed, dy * speed);
+        spawn_bullet(world, enemy, (dx * c - dy * s) * speed, (dx * s + dy * c) * speed);
+        spawn_bullet(world, enemy, (dx * c + dy * s) * speed, (dy * c - dx * s) * speed);
+        return;
+    }
+
+    // The rest are bullets spread evenly around the enemy's turning spawner.
+    int32_t count = 4;
+    if (enemy.pattern == FirePattern::Ring) {
+        count = 8;
+    } else if (enemy.pattern == FirePattern::Spiral) {
+        count = 2;
+    }
+
+    for (int32_t i = 0; i < count; ++i) {
+        Real angle = real::pi<Real>() * 2 / count * i + enemy.rot;
+        if (!spawn_bullet(world, enemy, enemy.bullet_speed * real::cos(angle), enemy.bullet_speed * real::sin(angle))) {
+            break;
+        }
+    }
+}
+
+// Resets the world to its first tick, with its wave table already filled.
+static void start(World &world, const ini_t *config, int32_t width, int32_t height, uint32_t seed, uint32_t player_count) {
+    assert(player_count > 0 && player_count <= PlayerMax);
+
+    world.width = width;
+    world.height = height;
+    world.tick = 0;
+    world.player_count = player_count;
+
+    rnd_pcg_seed(&world.random, seed);
+
+    for (uint32_t i = 0; i < PlayerMax; ++i) {
+        world.players[i] = Player();
+    }
+
+    world.players[0].pos = {24, 24};
+    world.players[1].pos = {Real(width - 32), 24};
+
+    // Queue the wave table's spawns, the first of which start on the first tick.
+    {
+        motion::build_paths(world.paths);
+
+        world.enemy_count = 0;
+        world.spawns.count = 0;
+        for (uint32_t i = 0; i < world.waves.spawn_count; ++i) {
+            waves::push(world.spawns, world.waves.spawns[i]);
+        }
+    }
+
+    world.food = Food();
+
+    // Size the bullet pool up front, so spawning never allocates.
+    {
+        int32_t capacity = config_int(config, "bullets", "capacity", 1024);
+        int32_t max_capacity = config_int(config, "bullets", "max_capacity", capacity);
+        const char *overflow_name = config_string(config, "bullets", "overflow", "recycle_oldest");
+
+        BulletOverflow overflow = BulletOverflow::RecycleOldest;
+        if (strcmp(overflow_name, "drop_newest") == 0) {
+            overflow = BulletOverflow::DropNewest;
+        } else if (strcmp(overflow_name, "grow") == 0) {
+            overflow = BulletOverflow::Grow;
+        } else if (strcmp(overflow_name, "recycle_oldest") != 0) {
+            log_error("Unknown bullet overflow policy %s", overflow_name);
+        }
+
+        if (capacity < 1 || capacity > (int32_t)BulletCapacityMax) {
+            log_error("Bullet capacity %d is outside 1 to %u", capacity, BulletCapacityMax);
+            capacity = capacity < 1 ? 1 : (int32_t)BulletCapacityMax;
+        }
+
+        if (max_capacity < capacity || max_capacity > (int32_t)BulletCapacityMax) {
+            log_error("Bullet max capacity %d is outside %d to %u", max_capacity, capacity, BulletCapacityMax);
+            max_capacity = max_capacity < capacity ? capacity : (int32_t)BulletCapacityMax;
+        }
+
+        bullet_pool::init(world.bullets, (uint32_t)capacity, (uint32_t)max_capacity, overflow);
+
+        collision::reserve(world.sweep, world.bullets.max_capacity, width);
+    }
+}
+
+void init(World &world, const ini_t *config, int32_t width, int32_t height, uint32_t seed, uint32_t player_count) {
+    waves::load(world.waves, waves::filename(config));
+    start(world, config, width, height, seed, player_count);
+}
+
+void init(World &world, const ini_t *config, const WaveTable &waves, int32_t width, int32_t height, uint32_t seed, uint32_t player_count) {
+    world.waves = waves;
+    start(world, config, width, height, seed, player_count);
+}
+
+void tick(World &world, const TickInput *inputs) {
+    const Real dt = TickDt;
+
+    bullet_pool::maintain(world.bullets);
+
+    // update players
+    Vector2r previous[PlayerMax];
+    for (uint32_t i = 0; i < world.player_count; ++i) {
+        previous[i] = world.players[i].pos;
+        motion::move_player(world.players[i], inputs[i], world.width, world.height);
+    }
+
+    // start the enemies that are due, and queue again the ones that repeat
+    while (world.spawns.count > 0 && world.spawns.items[0].tick <= world.tick) {
+        Spawn spawn = waves::pop(world.spawns);
+
+        if (world.enemy_count < EnemyMax) {
+            const EnemyType &type = world.waves.types[spawn.type];
+            Enemy &enemy = world.enemies[world.enemy_count++];
+            enemy = Enemy();
+            enemy.speed = type.speed;
+            enemy.path = spawn.phase;
+            enemy.rot_speed = type.rot_speed;
+            enemy.bullet_rate = type.bullet_rate;
+            enemy.bullet_speed = type.bullet_speed;
+            enemy.sprite = type.sprite;
+            enemy.life = spawn.life;
+            enemy.curve = spawn.curve;
+            enemy.pattern = spawn.pattern;
+        } else if (!dropped_spawn_logged.exchange(true)) {
+            log_error("Dropping a spawn on tick %u, %u enemies are already alive", world.tick, EnemyMax);
+        }
+
+        if (spawn.repeat > 0) {
+            spawn.tick += spawn.repeat;
+            waves::push(world.spawns, spawn);
+        }
+    }
+
+    // update enemies
+    for (uint32_t e = 0; e < world.enemy_count;) {
+        Enemy &enemy = world.enemies[e];
+
+        motion::move_enemy(enemy, world.paths, world.width, world.height);
+
+        // fire every few frames
+        if (enemy.bullet_cooldown >= enemy.bullet_rate) {
+            fire(world, enemy);
+            enemy.bullet_cooldown = dt;
+        } else {
+            enemy.bullet_cooldown += dt;
+        }
+
+        // leave once its time is up, the last enemy taking its place
+        if (enemy.life > 0 && --enemy.life == 0) {
+            world.enemies[e] = world.enemies[--world.enemy_count];
+        } else {
+            ++e;
+        }
+    }
+
+    // update bullets
+    {
+        collision::hit_players(world, previous);
+
+        // move bullets and remove the ones out of bounds or that hit a player, retain visits them oldest first
+        const math::Rect game_rect = {{0, 10}, {world.width, world.height - 10}};
+        const uint8_t *hit = world.sweep.hit;
+        uint32_t index = 0;
+        bullet_pool::retain(world.bullets, [&game_rect, hit, &index](Bullet &bullet) {
+            bool hit_player = hit[index++] != 0;
+            return motion::move_bullet(bullet, game_rect) && !hit_player;
+        });
+    }
+
+    // update food
+    {
+        Food &food = world.food;
+
+        if (food.spawned) {
+            math::Rect food_rect = food.bounds;
+            food_rect.origin.x += (int32_t)food.pos.x;
+            food_rect.origin.y += (int32_t)food.pos.y;
+
+            for (uint32_t i = 0; i < world.player_count; ++i) {
+                Player &player = world.players[i];
+
+                math::Rect player_rect = player.bounds;
+                player_rect.origin.x += (int32_t)player.pos.x;
+                player_rect.origin.y += (int32_t)player.pos.y;
+
+                if (math::is_inside(player_rect, food_rect)) {
+                    player.score += 1;
+                    // Fire faster once the game is under way, unless a faster rate was set.
+                    if (score(world) >= 10) {
+                        for (uint32_t e = 0; e < world.enemy_count; ++e) {
+                            if (world.enemies[e].bullet_rate > Real(0.75f)) {
+                                world.enemies[e].bullet_rate = 0.75f;
+                            }
+                        }
+                    }
+                    food.grace_timer = 0.0f;
+                    food.spawned = false;
+                    break;
+                }
+            }
+        } else {
+            if (food.grace_timer >= food.grace) {
+                // retry until we find a position outside of enemies and players
+                while (true) {
+                    math::Vector2 pos = {
+                        rnd_pcg_range(&world.random, 2, world.width - food.bounds.size.x - 2),
+                        rnd_pcg_range(&world.random, 11, world.height - food.bounds.size.y - 2)};
+
+                    bool blocked = false;
+                    for (uint32_t i = 0; i < world.enemy_count && !blocked; ++i) {
+                        math::Rect enemy_rect = world.enemies[i].bounds;
+                        enemy_rect.origin.x += (int32_t)world.enemies[i].pos.x;
+                        enemy_rect.origin.y += (int32_t)world.enemies[i].pos.y;
+                        blocked = math::is_inside(enemy_rect, pos);
+                    }
+                    for (uint32_t i = 0; i < world.player_count && !blocked; ++i) {
+                        math::Rect player_rect = world.players[i].bounds;
+                        player_rect.origin.x += (int32_t)world.players[i].pos.x;
+                        player_rect.origin.y += (int32_t)world.players[i].pos.y;
+                        blocked = math::is_inside(player_rect, pos);
+                    }
+
+                    if (!blocked) {
+                        food.spawned = true;
+                        food.pos.x = pos.x;
+                        food.pos.y = pos.y;
+                        food.sprite = rnd_pcg_range(&world.random, 859, 862);
+                        break;
+                    }
+                }
+            } else {
+                food.grace_timer += dt;
+            }
+        }
+    }
+
+    ++world.tick;
+}
+
+void save(const World &world, WorldSnapshot &snapshot) {
+    snapshot.tick = world.tick;
+    snapshot.random = world.random;
+    memcpy(snapshot.players, world.players, sizeof(world.players));
+    memcpy(snapshot.enemies, world.enemies, world.enemy_count * sizeof(Enemy));
+    snapshot.enemy_count = world.enemy_count;
+    memcpy(snapshot.spawns.items, world.spawns.items, world.spawns.count * sizeof(Spawn));
+    snapshot.spawns.count = world.spawns.count;
+    snapshot.food = world.food;
+
+    foundation::array::resize(snapshot.bullets, world.bullets.count);
+    bullet_pool::copy(world.bullets, foundation::array::begin(snapshot.bullets));
+    snapshot.bullet_capacity = world.bullets.capacity;
+    snapshot.bullet_grow_pending = world.bullets.grow_pending;
+}
+
+void restore(World &world, const WorldSnapshot &snapshot) {
+    world.tick = snapshot.tick;
+    world.random = snapshot.random;
+    memcpy(world.players, snapshot.players, sizeof(world.players));
+    memcpy(world.enemies, snapshot.enemies, snapshot.enemy_count * sizeof(Enemy));
+    world.enemy_count = snapshot.enemy_count;
+    memcpy(world.spawns.items, snapshot.spawns.items, snapshot.spawns.count * sizeof(Spawn));
+    world.spawns.count = snapshot.spawns.count;
+    world.food = snapshot.food;
+
+    bullet_pool::restore(world.bullets, foundation::array::begin(snapshot.bullets), foundation::array::size(snapshot.bullets), snapshot.bullet_capacity, snapshot.bullet_grow_pending);
+}
+
+// FNV-1a, fed field by field so padding never reaches the hash.
+struct Checksum {
+    uint64_t hash = 0xcbf29ce484222325ULL;
+
+    void add(const void *data, size_t size) {
+        const uint8_t *bytes = (const uint8_t *)data;
+        for (size_t i = 0; i < size; ++i) {
+            hash = (hash ^ bytes[i]) * 0x100000001b3ULL;
+        }
+    }
+
+    template <typename T>
+    void add(const T &value) {
+        add(&value, sizeof(value));
+    }
+};
+
+uint64_t checksum(const World &world) {
+    Checksum sum;
+
+    sum.add(world.tick);
+    sum.add(world.random.state);
+
+    for (uint32_t i = 0; i < world.player_count; ++i) {
+        const Player &player = world.players[i];
+        sum.add(player.score);
+        sum.add(player.hits);
+        sum.add(player.pos);
+        sum.add(player.vel);
+    }
+
+    sum.add(world.enemy_count);
+    for (uint32_t i = 0; i < world.enemy_count; ++i) {
+        const Enemy &enemy = world.enemies[i];
+        sum.add(enemy.pos);
+        sum.add(enemy.path);
+        sum.add(enemy.rot);
+        sum.add(enemy.bullet_rate);
+        sum.add(enemy.bullet_cooldown);
+        sum.add(enemy.life);
+    }
+
+    sum.add(world.spawns.count);
+    for (uint32_t i = 0; i < world.spawns.count; ++i) {
+        sum.add(world.spawns.items[i].tick);
+        sum.add(world.spawns.items[i].order);
+    }
+
+    sum.add(world.food.spawned);
+    sum.add(world.food.grace_timer);
+    sum.add(world.food.pos);
+    sum.add(world.food.sprite);
+
+    sum.add(world.bullets.count);
+    for (uint32_t i = 0; i < world.bullets.count; ++i) {
+        const Bullet &bullet = bullet_pool::at(world.bullets, i);
+        sum.add(bullet.pos);
+        sum.add(bullet.vel);
+    }
+
+    return sum.hash;
+}
+
+int32_t score(const World &world) {
+    int32_t total = 0;
+    for (uint32_t i = 0; i < world.player_count; ++i) {
+        total += world.players[i].score;
+    }
+
+    return total;
+}
+
+} // namespace world
+
+} // namespace game
@@ -0,0 +1,204 @@
+#pragma once
+
+#include "bullet_pool.h"
+#include "collision.h"
+#include "real.h"
+#include "util.h"
+#include "waves.h"
+
+#pragma warning(push, 0)
+#include "rnd.h"
+
+#include <collection_types.h>
+#include <engine/math.inl>
+#include <memory_types.h>
+#include <stdint.h>
+#pragma warning(pop)
+
+typedef struct ini_t ini_t;
+
+namespace game {
+
+/// The most players in a world.
+constexpr uint32_t PlayerMax = 2;
+
+/// The rate the simulation ticks at, independent of the frame rate.
+constexpr uint32_t TickRate = 60;
+
+/// The time step of a tick.
+constexpr float TickDt = 1.0f / (float)TickRate;
+
+/// The buttons of a player, as bits of a TickInput.
+enum class Button : uint8_t {
+    Up = 1 << 0,
+    Down = 1 << 1,
+    Left = 1 << 2,
+    Right = 1 << 3,
+    Action = 1 << 4,
+};
+
+/// The buttons a player holds during a tick. All a tick needs from outside the world.
+typedef uint8_t TickInput;
+
+/// Returns whether a button is held in a tick's input.
+inline bool held(TickInput input, Button button) {
+    return (input & (uint8_t)button) != 0;
+}
+
+/// Sets or clears a button in a tick's input.
+inline void set_button(TickInput &input, Button button, bool down) {
+    input = down ? (TickInput)(input | (uint8_t)button) : (TickInput)(input & ~(uint8_t)button);
+}
+
+// The entities of a world are templates over their scalar, so the motion in
+// motion.h can be benchmarked on float and Fixed in the same build. The world
+// itself only ever uses Real.
+
+template <typename T>
+struct BasicPlayer {
+    int32_t score = 0;
+
+    // Bullets that have hit the player.
+    int32_t hits = 0;
+
+    Vec2<T> pos = {0, 0};
+    Vec2<T> vel = {0, 0};
+    T speed_incr = 2.0f;
+    T max_speed = 0.8f;
+    T drag = 0.025f;
+    math::Rect bounds = {{0, 2}, {8, 5}};
+};
+
+template <typename T>
+struct BasicEnemy {
+    Vec2<T> pos = {0, 0};
+    T speed = 0.05f;
+
+    // How far along its path the enemy is, in radians.
+    T path = 20.0f;
+
+    T rot = 0.0f;
+    T rot_speed = 0.4f;
+    T bullet_rate = 0.8f;
+    T bullet_cooldown = 0.0f;
+    T bullet_speed = 20.0f;
+    math::Rect bounds = {{0, 0}, {8, 8}};
+    int32_t sprite = 857;
+
+    // Ticks until the enemy leaves, 0 to stay for good.
+    uint32_t life = 0;
+
+    PathCurve curve = PathCurve::Lemniscate;
+    FirePattern pattern = FirePattern::Cross;
+};
+
+template <typename T>
+struct BasicFood {
+    bool spawned = false;
+    T grace_timer = 0.0f;
+    T grace = 1.5f;
+    Vec2<T> pos = {0, 0};
+    int32_t sprite = 0;
+    math::Rect bounds = {{0, 0}, {8, 8}};
+};
+
+typedef BasicPlayer<Real> Player;
+typedef BasicEnemy<Real> Enemy;
+typedef BasicFood<Real> Food;
+
+/**
+ * @brief The simulation of a game, advanced a fixed tick at a time.
+ *
+ * A tick only depends on the world and the players' inputs, so two worlds
+ * initialized with the same seed and fed the same inputs stay identical.
+ * That is what lockstep multiplayer relies on.
+ */
+struct World {
+    World(foundation::Allocator &allocator);
+    DELETE_COPY_AND_MOVE(World)
+
+    int32_t width;
+    int32_t height;
+    uint32_t tick;
+    uint32_t player_count;
+    rnd_pcg_t random;
+    Player players[PlayerMax];
+    Enemy enemies[EnemyMax];
+    uint32_t enemy_count;
+    SpawnHeap spawns;
+    Food food;
+    BulletPool bullets;
+
+    // What the spawns start and the curves the enemies move along, constant after init.
+    WaveTable waves;
+    PathLut paths;
+
+    // Scratch for testing the bullets against the players, not part of the world's state.
+    BulletSweep sweep;
+};
+
+/**
+ * @brief The state of a World at the start of a tick, compact enough to save every tick.
+ *
+ * The playfield, player count and wave table don't change during a game and
+ * aren't saved, and neither are the bullet pool's counters.
+ */
+struct WorldSnapshot {
+    WorldSnapshot(foundation::Allocator &allocator);
+    DELETE_COPY_AND_MOVE(WorldSnapshot)
+
+    uint32_t tick;
+    rnd_pcg_t random;
+    Player players[PlayerMax];
+    Enemy enemies[EnemyMax];
+    uint32_t enemy_count;
+    SpawnHeap spawns;
+    Food food;
+
+    // The live bullets oldest first, and the pool's capacity.
+    foundation::Array<Bullet> bullets;
+    uint32_t bullet_capacity;
+    bool bullet_grow_pending;
+    char padding[3];
+};
+
+namespace world {
+
+/**
+ * @brief Resets the world to its first tick.
+ *
+ * @param world The world to initialize.
+ * @param config The config to read the [bullets] and [waves] sections from.
+ * @param width The width of the playfield.
+ * @param height The height of the playfield.
+ * @param seed The seed of the world's random numbers.
+ * @param player_count The number of players, up to PlayerMax.
+ */
+void init(World &world, const ini_t *config, int32_t width, int32_t height, uint32_t seed, uint32_t player_count);
+
+/// Resets the world to its first tick like init, with a wave table already read rather than the config's wave file.
+void init(World &world, const ini_t *config, const WaveTable &waves, int32_t width, int32_t height, uint32_t seed, uint32_t player_count);
+
+/**
+ * @brief Advances the world by one tick.
+ *
+ * @param world The world to advance.
+ * @param inputs The input of each player for this tick, player_count of them.
+ */
+void tick(World &world, const TickInput *inputs);
+
+/// Saves the world into a snapshot. Doesn't allocate once the snapshot has held as many bullets.
+void save(const World &world, WorldSnapshot &snapshot);
+
+/// Restores the world from a snapshot.
+void restore(World &world, const WorldSnapshot &snapshot);
+
+/// Returns a hash of the world's state, to compare worlds that should be identical.
+uint64_t checksum(const World &world);
+
+/// Returns the score of all players together.
+int32_t score(const World &world);
+
+} // namespace world
+
+} // namespace game
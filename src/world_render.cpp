@@ -0,0 +1,81 @@
+#include "world_render.h"
+#include "indexed_canvas.h"
+
+#pragma warning(push, 0)
+#include <cstdio>
+#pragma warning(pop)
+
+namespace game {
+
+namespace world_render {
+
+// Returns whether a point is further than FarFieldDistance from every player.
+static bool far_field(const World &world, int32_t x, int32_t y) {
+    for (uint32_t i = 0; i < world.player_count; ++i) {
+        int32_t dx = x - (int32_t)world.players[i].pos.x;
+        int32_t dy = y - (int32_t)world.players[i].pos.y;
+        if (dx > -FarFieldDistance && dx < FarFieldDistance && dy > -FarFieldDistance && dy < FarFieldDistance) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void draw(IndexedCanvas &c, const World &world, Hud &hud, bool thin_far_field, uint64_t frame) {
+    using namespace indexed_canvas;
+    namespace color = pico8;
+
+    clear(c, color::black);
+
+    // waiting for the peer to connect
+    if (world.player_count == 0) {
+        const TextRun &run = text_run(c, "waiting");
+        blit_text(c, run, (c.width - run.width) / 2, (c.height - run.height) / 2, color::light_gray);
+        return;
+    }
+
+    // draw food
+    if (world.food.spawned) {
+        sprite(c, world.food.sprite, (int32_t)world.food.pos.x, (int32_t)world.food.pos.y);
+    }
+
+    // draw bullets, thinned far from the players on alternate frames
+    for (uint32_t i = 0; i < world.bullets.count; ++i) {
+        const Bullet &bullet = bullet_pool::at(world.bullets, i);
+        const int32_t x = (int32_t)bullet.pos.x;
+        const int32_t y = (int32_t)bullet.pos.y;
+
+        if (thin_far_field && ((i + frame) & 1) != 0 && far_field(world, x, y)) {
+            continue;
+        }
+
+        pset(c, x, y, color::red);
+    }
+
+    // draw players
+    for (uint32_t i = 0; i < world.player_count; ++i) {
+        sprite(c, 856, (int32_t)world.players[i].pos.x, (int32_t)world.players[i].pos.y);
+    }
+
+    // draw enemies
+    for (uint32_t i = 0; i < world.enemy_count; ++i) {
+        sprite(c, world.enemies[i].sprite, (int32_t)world.enemies[i].pos.x, (int32_t)world.enemies[i].pos.y);
+    }
+
+    // draw ui
+    rectangle(c, 0, 0, c.width - 1, c.height - 1, color::dark_blue);
+    int32_t score = world::score(world);
+    if (hud.score != score || !hud.score_run || hud.score_run->key != hud.score_key) {
+        hud.score = score;
+        snprintf(hud.score_text, sizeof(hud.score_text), "score:%d", score);
+        hud.score_run = &text_run(c, hud.score_text);
+        hud.score_key = hud.score_run->key;
+    }
+    blit_text(c, *hud.score_run, 1, 1, color::white);
+    line(c, 0, 9, c.width - 1, 9, color::dark_blue);
+}
+
+} // namespace world_render
+
+} // namespace game
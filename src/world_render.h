@@ -0,0 +1,44 @@
+#pragma once
+
+#include "world.h"
+
+#pragma warning(push, 0)
+#include <stdint.h>
+#pragma warning(pop)
+
+namespace game {
+
+struct IndexedCanvas;
+struct TextRun;
+
+/// Bullets further than this from every player, in pixels along either axis, are far field.
+constexpr int32_t FarFieldDistance = 32;
+
+/// Cached state of the heads up display, updated when what it shows changes.
+struct Hud {
+    int32_t score = -1;
+    char score_text[16] = {};
+
+    // The rasterized score in the canvas's text cache, and its key there. A run whose key changed was evicted.
+    const TextRun *score_run = nullptr;
+    uint64_t score_key = 0;
+};
+
+namespace world_render {
+
+/**
+ * @brief Draws a world and its heads up display to an indexed canvas.
+ *
+ * Touches nothing but the canvas, so the headless tool can render without a window.
+ *
+ * @param canvas The canvas to draw to, with its sprites loaded.
+ * @param world The world to draw.
+ * @param hud The heads up display, updated when the score changes. Used with one canvas only.
+ * @param thin_far_field Whether to draw far field bullets only every other frame, half of them each frame.
+ * @param frame The number of the frame, which half of the far field to draw.
+ */
+void draw(IndexedCanvas &canvas, const World &world, Hud &hud, bool thin_far_field, uint64_t frame);
+
+} // namespace world_render
+
+} // namespace game